@@ -0,0 +1,2 @@
+# Building the PHLib stand-in library with gcc on Linux
+gcc -O2 -shared -fPIC phlibsim.c -lm -o libphlib.so
@@ -0,0 +1,909 @@
+/************************************************************************
+
+  PicoHarp 300    PHLib stand-in library for benchmarking without hardware
+
+  Exports the complete function set of phlib.h so that the demos (and any
+  other program written against PHLib) can be linked against it instead
+  of the vendor library. Nothing is talked to; instead the library either
+  synthesizes data or replays a recorded TTTR file:
+
+  - MODE_T2   Poisson photon arrivals on channels 0 and 1 (1..4 when
+              routing is enabled), with periodic markers and overflow
+              records exactly where the hardware would put them
+  - MODE_T3   Poisson photon arrivals with an exponential decay relative
+              to the sync, proper nsync/dtime fields and sync overflows
+  - MODE_HIST An exponential decay histogram with background and Poisson
+              noise, scaled to the elapsed measurement time
+  - replay    The records of a raw tttrmode.out, in T2 or T3 mode
+
+  Data is delivered at the pace of the wall clock by default, so a program
+  that reads too slowly sees FLAG_FIFOFULL just like with the real device.
+  Alternatively PH_ReadFiFo can always return full blocks to measure the
+  maximum throughput of the host side.
+
+  The behaviour is configured through environment variables, read once
+  when the first device is opened:
+
+  PHSIM_DEVICES     number of devices that can be opened (default 1)
+  PHSIM_SOURCE      "poisson" (default) or the path of a raw TTTR file to
+                    replay; a "%d" in the path is replaced by the device index
+  PHSIM_RATE        photon count rate in counts/s, or records/s for replay
+                    (default 1000000)
+  PHSIM_SYNCRATE    sync rate in Hz for T3 and histogramming (default 10000000)
+  PHSIM_LIFETIME    decay time constant in ps (default 2500)
+  PHSIM_MARKERRATE  marker 0 rate in Hz, 0 for none (default 0)
+  PHSIM_PACE        1 to deliver data in real time (default), 0 to deliver
+                    as fast as PH_ReadFiFo is called
+  PHSIM_LOOP        1 to restart the replay file at its end (default 0)
+  PHSIM_FIFO        FiFo depth in records for overrun detection (default 4194304)
+  PHSIM_SEED        random seed (default 1)
+
+  Build with gccbuild.sh, then link the demos against libphlib.so.
+
+************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "phdefin.h"
+#include "phlib.h"
+#include "errorcodes.h"
+
+
+#define SIM_T2WRAPAROUND 210698240   //T2 overflow period in units of 4 ps
+#define SIM_T3WRAPAROUND 65536       //T3 overflow period in syncs
+#define SIM_BASERES      4.0         //ps
+#define SIM_PEAKPOS      3000.0      //position of the decay onset in ps
+#define SIM_BACKGROUND   0.02        //fraction of flat background in histograms
+#define SIM_OVERFLOWREC  0xF0000000u //special record with no marker bits, T2 and T3 alike
+#define SIM_NEVER        0xFFFFFFFFFFFFFFFFull
+
+typedef unsigned long long u64;
+
+typedef struct
+{
+ int open;
+ int initialized;
+ int mode;
+ int syncdiv;
+ int binning;
+ int offset;
+ int stopovfl;
+ int stopcount;
+ int routing;
+ int markeren[4];
+ int flags;
+
+ int running;
+ int tacq;                //ms
+ double tstart;           //us
+ double elapsed;          //us, frozen by PH_StopMeas
+
+ u64 rng;
+
+ //TTTR generator state, all times in ps
+ u64 nextphoton;
+ u64 nextmarker;
+ u64 ofl;                 //overflow records emitted so far
+ double period;           //T3 sync period in ps (after divider)
+ double delivered;        //records delivered in this measurement
+
+ //replay
+ FILE* replay;
+
+ //histogram blocks
+ unsigned int* hist[4];
+} simdev;
+
+
+static simdev Dev[MAXDEVNUM];
+
+static int ConfigRead = 0;
+static int CfgDevices = 1;
+static char CfgSource[1024] = "poisson";
+static double CfgRate = 1e6;
+static double CfgSyncRate = 1e7;
+static double CfgLifetime = 2500.0;
+static double CfgMarkerRate = 0.0;
+static int CfgPace = 1;
+static int CfgLoop = 0;
+static double CfgFiFo = 4194304.0;
+static u64 CfgSeed = 1;
+
+
+static void readconfig(void)
+{
+ char* s;
+
+ if(ConfigRead)
+        return;
+ ConfigRead = 1;
+ if((s=getenv("PHSIM_DEVICES"))!=NULL)    CfgDevices = atoi(s);
+ if((s=getenv("PHSIM_SOURCE"))!=NULL)     strncpy(CfgSource, s, sizeof(CfgSource)-1);
+ if((s=getenv("PHSIM_RATE"))!=NULL)       CfgRate = atof(s);
+ if((s=getenv("PHSIM_SYNCRATE"))!=NULL)   CfgSyncRate = atof(s);
+ if((s=getenv("PHSIM_LIFETIME"))!=NULL)   CfgLifetime = atof(s);
+ if((s=getenv("PHSIM_MARKERRATE"))!=NULL) CfgMarkerRate = atof(s);
+ if((s=getenv("PHSIM_PACE"))!=NULL)       CfgPace = atoi(s);
+ if((s=getenv("PHSIM_LOOP"))!=NULL)       CfgLoop = atoi(s);
+ if((s=getenv("PHSIM_FIFO"))!=NULL)       CfgFiFo = atof(s);
+ if((s=getenv("PHSIM_SEED"))!=NULL)       CfgSeed = strtoull(s, NULL, 10);
+
+ if(CfgDevices<0) CfgDevices = 0;
+ if(CfgDevices>MAXDEVNUM) CfgDevices = MAXDEVNUM;
+ if(CfgRate<1.0) CfgRate = 1.0;
+ if(CfgSyncRate<1.0) CfgSyncRate = 1.0;
+ if(CfgLifetime<1.0) CfgLifetime = 1.0;
+}
+
+
+static double now_us(void)
+{
+#ifdef _WIN32
+ LARGE_INTEGER f, c;
+ QueryPerformanceFrequency(&f);
+ QueryPerformanceCounter(&c);
+ return (double)c.QuadPart * 1e6 / (double)f.QuadPart;
+#else
+ struct timespec ts;
+ clock_gettime(CLOCK_MONOTONIC, &ts);
+ return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec * 1e-3;
+#endif
+}
+
+
+//xorshift64*, one generator per device so that devices are independent
+static u64 rnd(simdev* d)
+{
+ d->rng ^= d->rng >> 12;
+ d->rng ^= d->rng << 25;
+ d->rng ^= d->rng >> 27;
+ return d->rng * 2685821657736338717ull;
+}
+
+//uniform in (0,1]
+static double rnduni(simdev* d)
+{
+ return ((double)(rnd(d) >> 11) + 1.0) * (1.0/9007199254740992.0);
+}
+
+static double rndexp(simdev* d, double mean)
+{
+ return -mean * log(rnduni(d));
+}
+
+static unsigned int rndpoisson(simdev* d, double lambda)
+{
+ double l, p, u, v;
+ unsigned int k;
+
+ if(lambda<=0.0)
+        return 0;
+ if(lambda<30.0)
+ {
+        l = exp(-lambda);
+        k = 0;
+        p = rnduni(d);
+        while(p>l)
+        {
+                k++;
+                p *= rnduni(d);
+        }
+        return k;
+ }
+ //normal approximation is good enough for a load generator
+ u = rnduni(d);
+ v = rnduni(d);
+ p = lambda + sqrt(lambda) * sqrt(-2.0*log(u)) * cos(6.283185307179586*v) + 0.5;
+ return p<0.0 ? 0 : (unsigned int)p;
+}
+
+
+static int checkdev(int devidx, int needinit)
+{
+ if(devidx<0 || devidx>=MAXDEVNUM)
+        return ERROR_INVALID_ARGUMENT;
+ if(!Dev[devidx].open)
+        return ERROR_DEVICE_NOT_OPEN;
+ if(needinit && !Dev[devidx].initialized)
+        return ERROR_NOT_INITIALIZED;
+ return ERROR_NONE;
+}
+
+#define CHECKDEV(idx,init) { int rc = checkdev(idx,init); if(rc<0) return rc; }
+
+
+//elapsed measurement time in us, limited to Tacq
+static double elapsed(simdev* d)
+{
+ double e = d->running ? now_us() - d->tstart : d->elapsed;
+
+ if(e > d->tacq*1000.0)
+        e = d->tacq*1000.0;
+ return e;
+}
+
+static int ctcdone(simdev* d)
+{
+ return !d->running || now_us() - d->tstart >= d->tacq*1000.0;
+}
+
+
+/************************* TTTR generation *****************************/
+
+static void resetgenerator(simdev* d)
+{
+ d->ofl = 0;
+ d->delivered = 0;
+ d->period = 1e12 * d->syncdiv / CfgSyncRate;
+ d->nextphoton = (u64)rndexp(d, 1e12/CfgRate);
+ d->nextmarker = (CfgMarkerRate>0 && d->markeren[0]) ? (u64)(1e12/CfgMarkerRate) : SIM_NEVER;
+}
+
+static unsigned int t2channel(simdev* d)
+{
+ if(d->routing)
+        return (unsigned int)(rnd(d) % 5);  //sync channel 0 and routed channels 1..4
+ return (unsigned int)(rnd(d) & 1);
+}
+
+//T2: 4 bit channel, 28 bit time tag in units of 4 ps
+static int generate_t2(simdev* d, unsigned int* buf, int count, u64 limit)
+{
+ int n = 0;
+ u64 tev, tof, tag;
+
+ while(n<count)
+ {
+        tev = d->nextphoton < d->nextmarker ? d->nextphoton : d->nextmarker;
+        tof = (d->ofl+1) * SIM_T2WRAPAROUND * 4;
+        if(tof<=tev && tof<=limit)
+        {
+                buf[n++] = SIM_OVERFLOWREC;
+                d->ofl++;
+                continue;
+        }
+        if(tev>limit)
+                break;
+        tag = tev/4 - d->ofl*SIM_T2WRAPAROUND;
+        if(tev==d->nextmarker)
+        {
+                buf[n++] = 0xF0000000u | ((unsigned int)tag & 0x0FFFFFF0u) | 1u;
+                d->nextmarker += (u64)(1e12/CfgMarkerRate);
+        }
+        else
+        {
+                buf[n++] = (t2channel(d)<<28) | (unsigned int)tag;
+                d->nextphoton += 4 + (u64)rndexp(d, 1e12/CfgRate);
+        }
+ }
+ return n;
+}
+
+//T3: 4 bit channel, 12 bit dtime, 16 bit nsync
+static int generate_t3(simdev* d, unsigned int* buf, int count, u64 limit)
+{
+ int n = 0;
+ u64 tev, tof, nsync;
+ double binres = SIM_BASERES * (1<<d->binning);
+ double dt;
+ unsigned int chan;
+
+ while(n<count)
+ {
+        tev = d->nextphoton < d->nextmarker ? d->nextphoton : d->nextmarker;
+        tof = (u64)((double)(d->ofl+1) * SIM_T3WRAPAROUND * d->period);
+        if(tof<=tev && tof<=limit)
+        {
+                buf[n++] = SIM_OVERFLOWREC;
+                d->ofl++;
+                continue;
+        }
+        if(tev>limit)
+                break;
+        nsync = (u64)((double)tev / d->period);
+        if(nsync < d->ofl*SIM_T3WRAPAROUND) //rounding at the wrap boundary
+                nsync = d->ofl*SIM_T3WRAPAROUND;
+        nsync -= d->ofl*SIM_T3WRAPAROUND;
+        if(nsync>0xFFFF)
+                nsync = 0xFFFF;
+        if(tev==d->nextmarker)
+        {
+                buf[n++] = 0xF0000000u | (1u<<16) | (unsigned int)nsync;
+                d->nextmarker += (u64)(1e12/CfgMarkerRate);
+        }
+        else
+        {
+                d->nextphoton += 1 + (u64)rndexp(d, 1e12/CfgRate);
+                dt = fmod(SIM_PEAKPOS - d->offset + rndexp(d, CfgLifetime), d->period);
+                if(dt<0.0 || dt/binres>=4096.0)
+                        continue;   //outside the dtime range, lost like in the hardware
+                chan = d->routing ? 1 + (unsigned int)(rnd(d) & 3) : 1;
+                buf[n++] = (chan<<28) | ((unsigned int)(dt/binres)<<16) | (unsigned int)nsync;
+        }
+ }
+ return n;
+}
+
+//replace a "%d" in the configured replay path by the device index
+static void replaypath(char* path, int devidx)
+{
+ char* p = strstr(CfgSource, "%d");
+
+ if(p==NULL)
+ {
+        strcpy(path, CfgSource);
+        return;
+ }
+ memcpy(path, CfgSource, p-CfgSource);
+ sprintf(path + (p-CfgSource), "%d%s", devidx, p+2);
+}
+
+static int replay(simdev* d, unsigned int* buf, int count)
+{
+ int n = 0;
+ size_t got;
+
+ if(d->replay==NULL)
+        return 0;
+ while(n<count)
+ {
+        got = fread(buf+n, sizeof(unsigned int), count-n, d->replay);
+        n += (int)got;
+        if(n<count)
+        {
+                if(!CfgLoop)
+                        break;
+                rewind(d->replay);
+                //an extra overflow keeps the decoded time monotonic across the restart
+                buf[n++] = SIM_OVERFLOWREC;
+        }
+ }
+ return n;
+}
+
+
+/************************* histogram generation ************************/
+
+static void addhistogram(simdev* d, unsigned int* h, double ncounts)
+{
+ double binres = SIM_BASERES * (1<<d->binning);
+ double t0 = SIM_PEAKPOS - d->offset;
+ double tau = CfgLifetime;
+ double wrap = 1.0 / (1.0 - exp(-d->period/tau));  //decay tails from earlier sync periods
+ int nbins = (int)(d->period / binres);
+ double a, b, f, bg;
+ int i;
+
+ if(nbins<1) nbins = 1;
+ if(nbins>HISTCHAN) nbins = HISTCHAN;
+ bg = ncounts * SIM_BACKGROUND / nbins;
+ ncounts *= 1.0 - SIM_BACKGROUND;
+
+ for(i=0;i<nbins;i++)
+ {
+        a = i*binres - t0;
+        b = a + binres;
+        if(b<=0.0)
+                f = (exp(-(a+d->period)/tau) - exp(-(b+d->period)/tau)) * wrap;
+        else if(a<0.0)
+                f = (exp(-(a+d->period)/tau) - exp(-d->period/tau)) * wrap + (1.0 - exp(-b/tau)) * wrap;
+        else
+                f = (exp(-a/tau) - exp(-b/tau)) * wrap;
+        h[i] += rndpoisson(d, ncounts*f + bg);
+        if(d->stopovfl && h[i]>=(unsigned int)d->stopcount)
+        {
+                h[i] = d->stopcount;
+                d->flags |= FLAG_OVERFLOW;
+        }
+ }
+}
+
+//add the counts of a finished measurement to the histogram memory
+static void finishhistogram(simdev* d)
+{
+ double ncounts = CfgRate * d->elapsed * 1e-6;
+ int i;
+
+ if(d->mode!=MODE_HIST)
+        return;
+ if(d->routing)
+ {
+        for(i=0;i<4;i++)
+                addhistogram(d, d->hist[i], ncounts/4);
+ }
+ else
+        addhistogram(d, d->hist[0], ncounts);
+}
+
+
+/************************* library interface ***************************/
+
+struct errtext { int code; const char* text; };
+
+static const struct errtext ErrTexts[] =
+{
+ {ERROR_NONE,                    "ERROR_NONE"},
+ {ERROR_DEVICE_OPEN_FAIL,        "ERROR_DEVICE_OPEN_FAIL"},
+ {ERROR_DEVICE_BUSY,             "ERROR_DEVICE_BUSY"},
+ {ERROR_DEVICE_NOT_OPEN,         "ERROR_DEVICE_NOT_OPEN"},
+ {ERROR_DEVICE_LOCKED,           "ERROR_DEVICE_LOCKED"},
+ {ERROR_INSTANCE_RUNNING,        "ERROR_INSTANCE_RUNNING"},
+ {ERROR_INVALID_ARGUMENT,        "ERROR_INVALID_ARGUMENT"},
+ {ERROR_INVALID_MODE,            "ERROR_INVALID_MODE"},
+ {ERROR_INVALID_OPTION,          "ERROR_INVALID_OPTION"},
+ {ERROR_INVALID_MEMORY,          "ERROR_INVALID_MEMORY"},
+ {ERROR_INVALID_RDATA,           "ERROR_INVALID_RDATA"},
+ {ERROR_NOT_INITIALIZED,         "ERROR_NOT_INITIALIZED"},
+ {ERROR_NOT_CALIBRATED,          "ERROR_NOT_CALIBRATED"},
+ {ERROR_DMA_FAIL,                "ERROR_DMA_FAIL"},
+ {ERROR_STATUS_FAIL,             "ERROR_STATUS_FAIL"},
+ {ERROR_USB_BULKRD_FAIL,         "ERROR_USB_BULKRD_FAIL"},
+};
+
+
+int _stdcall PH_GetLibraryVersion(char* version)
+{
+ strcpy(version, LIB_VERSION);
+ return ERROR_NONE;
+}
+
+int _stdcall PH_GetErrorString(char* errstring, int errcode)
+{
+ int i;
+
+ for(i=0;i<(int)(sizeof(ErrTexts)/sizeof(ErrTexts[0]));i++)
+ {
+        if(ErrTexts[i].code==errcode)
+        {
+                strcpy(errstring, ErrTexts[i].text);
+                return ERROR_NONE;
+        }
+ }
+ sprintf(errstring, "ERROR %d", errcode);
+ return ERROR_NONE;
+}
+
+int _stdcall PH_OpenDevice(int devidx, char* serial)
+{
+ simdev* d;
+
+ readconfig();
+ if(devidx<0 || devidx>=MAXDEVNUM)
+        return ERROR_INVALID_ARGUMENT;
+ if(devidx>=CfgDevices)
+        return ERROR_DEVICE_OPEN_FAIL;
+ d = &Dev[devidx];
+ if(!d->open)
+ {
+        memset(d, 0, sizeof(simdev));
+        d->open = 1;
+        d->rng = CfgSeed * 0x9E3779B97F4A7C15ull + devidx + 1;
+ }
+ sprintf(serial, "%07d", 9000000+devidx);
+ return ERROR_NONE;
+}
+
+int _stdcall PH_CloseDevice(int devidx)
+{
+ simdev* d;
+ int i;
+
+ if(devidx<0 || devidx>=MAXDEVNUM)
+        return ERROR_INVALID_ARGUMENT;
+ d = &Dev[devidx];
+ if(d->replay)
+        fclose(d->replay);
+ for(i=0;i<4;i++)
+        free(d->hist[i]);
+ memset(d, 0, sizeof(simdev));
+ return ERROR_NONE;
+}
+
+int _stdcall PH_Initialize(int devidx, int mode)
+{
+ simdev* d;
+ char path[1100];
+ int i;
+
+ CHECKDEV(devidx,0);
+ if(mode!=MODE_HIST && mode!=MODE_T2 && mode!=MODE_T3)
+        return ERROR_INVALID_MODE;
+ d = &Dev[devidx];
+ d->mode = mode;
+ d->syncdiv = 1;
+ d->binning = 0;
+ d->offset = 0;
+ d->stopovfl = 0;
+ d->stopcount = 65535;
+ d->routing = 0;
+ d->flags = 0;
+ d->running = 0;
+ for(i=0;i<4;i++)
+        d->markeren[i] = 1;
+
+ if(mode==MODE_HIST)
+ {
+        for(i=0;i<4;i++)
+        {
+                if(d->hist[i]==NULL)
+                        d->hist[i] = (unsigned int*)calloc(HISTCHAN, sizeof(unsigned int));
+                if(d->hist[i]==NULL)
+                        return ERROR_INVALID_MEMORY;
+        }
+ }
+ else if(strcmp(CfgSource, "poisson")!=0 && d->replay==NULL)
+ {
+        replaypath(path, devidx);
+        if((d->replay=fopen(path, "rb"))==NULL)
+                return ERROR_INVALID_RDATA;
+ }
+ d->initialized = 1;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_GetHardwareInfo(int devidx, char* model, char* partno, char* version)
+{
+ CHECKDEV(devidx,1);
+ strcpy(model, "PicoHarp 300");
+ strcpy(partno, "SIM");
+ strcpy(version, "2.0");
+ return ERROR_NONE;
+}
+
+int _stdcall PH_GetSerialNumber(int devidx, char* serial)
+{
+ CHECKDEV(devidx,1);
+ sprintf(serial, "%07d", 9000000+devidx);
+ return ERROR_NONE;
+}
+
+int _stdcall PH_GetFeatures(int devidx, int* features)
+{
+ CHECKDEV(devidx,1);
+ *features = FEATURE_DLL | FEATURE_TTTR | FEATURE_MARKERS | FEATURE_LOWRES | FEATURE_TRIGOUT;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_GetBaseResolution(int devidx, double* resolution, int* binsteps)
+{
+ CHECKDEV(devidx,1);
+ *resolution = SIM_BASERES;
+ *binsteps = BINSTEPSMAX;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_GetHardwareDebugInfo(int devidx, char *debuginfo)
+{
+ CHECKDEV(devidx,1);
+ strcpy(debuginfo, "simulated device, no debug info");
+ return ERROR_NONE;
+}
+
+int _stdcall PH_Calibrate(int devidx)
+{
+ CHECKDEV(devidx,1);
+ return ERROR_NONE;
+}
+
+int _stdcall PH_SetInputCFD(int devidx, int channel, int level, int zc)
+{
+ CHECKDEV(devidx,1);
+ if(channel<0 || channel>1 || level<DISCRMIN || level>DISCRMAX || zc<ZCMIN || zc>ZCMAX)
+        return ERROR_INVALID_ARGUMENT;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_SetSyncDiv(int devidx, int div)
+{
+ CHECKDEV(devidx,1);
+ if(div<SYNCDIVMIN || div>SYNCDIVMAX)
+        return ERROR_INVALID_ARGUMENT;
+ Dev[devidx].syncdiv = div;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_SetSyncOffset(int devidx, int syncoffset)
+{
+ CHECKDEV(devidx,1);
+ if(syncoffset<SYNCOFFSMIN || syncoffset>SYNCOFFSMAX)
+        return ERROR_INVALID_ARGUMENT;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_SetStopOverflow(int devidx, int stop_ovfl, int stopcount)
+{
+ CHECKDEV(devidx,1);
+ if(stopcount<1 || stopcount>65535)
+        return ERROR_INVALID_ARGUMENT;
+ Dev[devidx].stopovfl = stop_ovfl;
+ Dev[devidx].stopcount = stopcount;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_SetBinning(int devidx, int binning)
+{
+ CHECKDEV(devidx,1);
+ if(binning<0 || binning>=BINSTEPSMAX)
+        return ERROR_INVALID_ARGUMENT;
+ Dev[devidx].binning = binning;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_SetOffset(int devidx, int offset)
+{
+ CHECKDEV(devidx,1);
+ if(offset<OFFSETMIN || offset>OFFSETMAX)
+        return ERROR_INVALID_ARGUMENT;
+ Dev[devidx].offset = offset;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_SetMultistopEnable(int devidx, int enable)
+{
+ CHECKDEV(devidx,1);
+ return ERROR_NONE;
+}
+
+int _stdcall PH_ClearHistMem(int devidx, int block)
+{
+ CHECKDEV(devidx,1);
+ if(block<0 || block>3)
+        return ERROR_INVALID_ARGUMENT;
+ if(Dev[devidx].hist[block])
+        memset(Dev[devidx].hist[block], 0, HISTCHAN*sizeof(unsigned int));
+ return ERROR_NONE;
+}
+
+int _stdcall PH_StartMeas(int devidx, int tacq)
+{
+ simdev* d;
+
+ CHECKDEV(devidx,1);
+ if(tacq<ACQTMIN || tacq>ACQTMAX)
+        return ERROR_INVALID_ARGUMENT;
+ d = &Dev[devidx];
+ d->tacq = tacq;
+ d->flags = 0;
+ d->elapsed = 0;
+ resetgenerator(d);
+ if(d->replay)
+        rewind(d->replay);
+ d->tstart = now_us();
+ d->running = 1;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_StopMeas(int devidx)
+{
+ simdev* d;
+
+ CHECKDEV(devidx,1);
+ d = &Dev[devidx];
+ if(d->running)
+ {
+        d->elapsed = elapsed(d);
+        d->running = 0;
+        finishhistogram(d);
+ }
+ return ERROR_NONE;
+}
+
+int _stdcall PH_CTCStatus(int devidx, int* ctcstatus)
+{
+ CHECKDEV(devidx,1);
+ *ctcstatus = ctcdone(&Dev[devidx]);
+ return ERROR_NONE;
+}
+
+int _stdcall PH_GetHistogram(int devidx, unsigned int* chcount, int block)
+{
+ simdev* d;
+
+ CHECKDEV(devidx,1);
+ d = &Dev[devidx];
+ if(d->mode!=MODE_HIST)
+        return ERROR_INVALID_MODE;
+ if(block<0 || block>3)
+        return ERROR_INVALID_ARGUMENT;
+ if(d->running && ctcdone(d)) //measurement ran out but was not stopped yet
+        PH_StopMeas(devidx);
+ memcpy(chcount, d->hist[block], HISTCHAN*sizeof(unsigned int));
+ return ERROR_NONE;
+}
+
+int _stdcall PH_GetResolution(int devidx, double* resolution)
+{
+ CHECKDEV(devidx,1);
+ *resolution = Dev[devidx].mode==MODE_T2 ? SIM_BASERES : SIM_BASERES * (1<<Dev[devidx].binning);
+ return ERROR_NONE;
+}
+
+int _stdcall PH_GetCountRate(int devidx, int channel, int* rate)
+{
+ simdev* d;
+
+ CHECKDEV(devidx,1);
+ if(channel<0 || channel>1)
+        return ERROR_INVALID_ARGUMENT;
+ d = &Dev[devidx];
+ if(d->mode==MODE_T2)
+        *rate = (int)(d->routing ? CfgRate/5 * (channel ? 4 : 1) : CfgRate/2);
+ else
+        *rate = (int)(channel==0 ? CfgSyncRate : CfgRate);
+ return ERROR_NONE;
+}
+
+//simulated FiFo fill: what the hardware would have produced so far minus what was read
+static void checkfifo(simdev* d)
+{
+ double produced;
+
+ if(d->mode==MODE_HIST || !CfgPace || !d->running)
+        return;
+ produced = CfgRate * elapsed(d) * 1e-6;
+ if(produced - d->delivered > CfgFiFo)
+        d->flags |= FLAG_FIFOFULL;
+}
+
+int _stdcall PH_GetFlags(int devidx, int* flags)
+{
+ simdev* d;
+
+ CHECKDEV(devidx,1);
+ d = &Dev[devidx];
+ checkfifo(d);
+ *flags = d->flags;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_GetElapsedMeasTime(int devidx, double* elapsedtime)
+{
+ CHECKDEV(devidx,1);
+ *elapsedtime = elapsed(&Dev[devidx]) / 1000.0;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_GetWarnings(int devidx, int* warnings)
+{
+ CHECKDEV(devidx,1);
+ *warnings = 0;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_GetWarningsText(int devidx, char* text, int warnings)
+{
+ CHECKDEV(devidx,1);
+ text[0] = 0;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_SetMarkerEnable(int devidx, int en0, int en1, int en2, int en3)
+{
+ simdev* d;
+
+ CHECKDEV(devidx,1);
+ d = &Dev[devidx];
+ d->markeren[0] = en0;
+ d->markeren[1] = en1;
+ d->markeren[2] = en2;
+ d->markeren[3] = en3;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_SetMarkerEdges(int devidx, int me0, int me1, int me2, int me3)
+{
+ CHECKDEV(devidx,1);
+ return ERROR_NONE;
+}
+
+int _stdcall PH_SetMarkerHoldoffTime(int devidx, int holdofftime)
+{
+ CHECKDEV(devidx,1);
+ if(holdofftime<0 || holdofftime>HOLDOFFMAX)
+        return ERROR_INVALID_ARGUMENT;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_ReadFiFo(int devidx, unsigned int* buffer, int count, int* nactual)
+{
+ simdev* d;
+ u64 limit;
+ double allowed;
+ int n;
+
+ CHECKDEV(devidx,1);
+ d = &Dev[devidx];
+ *nactual = 0;
+ if(d->mode==MODE_HIST)
+        return ERROR_INVALID_MODE;
+ if(count<=0 || count>TTREADMAX)
+        return ERROR_INVALID_ARGUMENT;
+
+ if(CfgPace)
+ {
+        checkfifo(d);
+        limit = (u64)(elapsed(d) * 1e6);
+ }
+ else
+ {
+        //as fast as possible, but nothing after the measurement time is over
+        if(ctcdone(d))
+                return ERROR_NONE;
+        limit = SIM_NEVER;
+ }
+
+ if(d->replay)
+ {
+        if(CfgPace)
+        {
+                allowed = CfgRate * elapsed(d) * 1e-6 - d->delivered;
+                if(allowed<count)
+                        count = allowed<0 ? 0 : (int)allowed;
+        }
+        n = replay(d, buffer, count);
+ }
+ else if(d->mode==MODE_T2)
+        n = generate_t2(d, buffer, count, limit);
+ else
+        n = generate_t3(d, buffer, count, limit);
+
+ d->delivered += n;
+ *nactual = n;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_GetRouterVersion(int devidx, char* model, char* version)
+{
+ CHECKDEV(devidx,1);
+ strcpy(model, "PHR 800");
+ strcpy(version, "1.0");
+ return ERROR_NONE;
+}
+
+int _stdcall PH_GetRoutingChannels(int devidx, int* rtchannels)
+{
+ CHECKDEV(devidx,1);
+ *rtchannels = 4;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_EnableRouting(int devidx, int enable)
+{
+ CHECKDEV(devidx,1);
+ Dev[devidx].routing = enable ? 1 : 0;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_SetRoutingChannelOffset(int devidx, int channel, int offset)
+{
+ CHECKDEV(devidx,1);
+ if(channel<0 || channel>3 || offset<CHANOFFSMIN || offset>CHANOFFSMAX)
+        return ERROR_INVALID_ARGUMENT;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_SetPHR800Input(int devidx, int channel, int level, int edge)
+{
+ CHECKDEV(devidx,1);
+ if(channel<0 || channel>3 || level<PHR800LVMIN || level>PHR800LVMAX)
+        return ERROR_INVALID_ARGUMENT;
+ return ERROR_NONE;
+}
+
+int _stdcall PH_SetPHR800CFD(int devidx, int channel, int level, int zc)
+{
+ CHECKDEV(devidx,1);
+ if(channel<0 || channel>3 || level<DISCRMIN || level>DISCRMAX || zc<ZCMIN || zc>ZCMAX)
+        return ERROR_INVALID_ARGUMENT;
+ return ERROR_NONE;
+}
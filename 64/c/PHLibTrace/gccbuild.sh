@@ -0,0 +1,3 @@
+# Building the PHLib call tracer with gcc on Linux, run a program under it with
+# LD_PRELOAD=../PHLibTrace/libphtrace.so
+gcc -O2 -shared -fPIC phtrace.c ttlat.c -ldl -lpthread -o libphtrace.so
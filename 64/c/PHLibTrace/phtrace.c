@@ -0,0 +1,368 @@
+/************************************************************************
+
+  PicoHarp 300    PHLib call tracer
+
+  Sits between a program and PHLib and forwards every call of phlib.h,
+  timing it on the way. For each function it counts the calls and the
+  calls that returned an error and keeps a latency histogram (see
+  ttlat.h); for PH_ReadFiFo it also counts the records delivered and
+  how many calls brought how many records. The program itself is not
+  changed and does not know.
+
+  The figures are written as JSON when the program exits, and also
+  whenever it gets SIGUSR1 (the program goes on) or is ended by SIGINT /
+  SIGTERM or Ctrl-C. On Linux the signal handler only wakes a thread of
+  the tracer, which writes the report outside the handler; a signal
+  that ends the program is raised again once the report is written.
+
+  Linux:    LD_PRELOAD=../PHLibTrace/libphtrace.so ./tttrmode
+            The calls go on to the next PHLib in line, i.e. the one the
+            program is linked against (the vendor's or libphlib.so).
+  Windows:  Build phtrace.vcxproj, which makes PHLib64.dll with the
+            exports of phtrace.def, and put it next to the program, with
+            the vendor DLL renamed to PHLib64_real.dll.
+
+  The behaviour is configured through environment variables:
+
+  PHTRACE_OUT   path of the report (default phtrace.json)
+  PHTRACE_LIB   Windows only, the DLL the calls go on to
+                (default PHLib64_real.dll)
+
+  The overhead is two clock reads and a mutex per call, well below a
+  microsecond; it is included in the times reported.
+
+  Note: The report lists the functions in the order of phlib.h, each
+        with calls, errors, total and mean time, percentiles and the
+        non-empty histogram buckets as [upper edge in us, calls].
+
+************************************************************************/
+
+#ifndef _WIN32
+#define _GNU_SOURCE //RTLD_NEXT
+#include <dlfcn.h>
+#include <errno.h>
+#include <semaphore.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+
+#include "phlib.h"
+#include "errorcodes.h"
+#include "ttport.h"
+#include "ttlat.h"
+
+
+//every function but PH_ReadFiFo, which is traced by hand below
+#define PH_FUNCTIONS \
+ F(PH_GetLibraryVersion, (char* version), (version)) \
+ F(PH_GetErrorString, (char* errstring, int errcode), (errstring, errcode)) \
+ F(PH_OpenDevice, (int devidx, char* serial), (devidx, serial)) \
+ F(PH_CloseDevice, (int devidx), (devidx)) \
+ F(PH_Initialize, (int devidx, int mode), (devidx, mode)) \
+ F(PH_GetHardwareInfo, (int devidx, char* model, char* partno, char* version), (devidx, model, partno, version)) \
+ F(PH_GetSerialNumber, (int devidx, char* serial), (devidx, serial)) \
+ F(PH_GetFeatures, (int devidx, int* features), (devidx, features)) \
+ F(PH_GetBaseResolution, (int devidx, double* resolution, int* binsteps), (devidx, resolution, binsteps)) \
+ F(PH_GetHardwareDebugInfo, (int devidx, char* debuginfo), (devidx, debuginfo)) \
+ F(PH_Calibrate, (int devidx), (devidx)) \
+ F(PH_SetInputCFD, (int devidx, int channel, int level, int zc), (devidx, channel, level, zc)) \
+ F(PH_SetSyncDiv, (int devidx, int div), (devidx, div)) \
+ F(PH_SetSyncOffset, (int devidx, int syncoffset), (devidx, syncoffset)) \
+ F(PH_SetStopOverflow, (int devidx, int stop_ovfl, int stopcount), (devidx, stop_ovfl, stopcount)) \
+ F(PH_SetBinning, (int devidx, int binning), (devidx, binning)) \
+ F(PH_SetOffset, (int devidx, int offset), (devidx, offset)) \
+ F(PH_SetMultistopEnable, (int devidx, int enable), (devidx, enable)) \
+ F(PH_ClearHistMem, (int devidx, int block), (devidx, block)) \
+ F(PH_StartMeas, (int devidx, int tacq), (devidx, tacq)) \
+ F(PH_StopMeas, (int devidx), (devidx)) \
+ F(PH_CTCStatus, (int devidx, int* ctcstatus), (devidx, ctcstatus)) \
+ F(PH_GetHistogram, (int devidx, unsigned int* chcount, int block), (devidx, chcount, block)) \
+ F(PH_GetResolution, (int devidx, double* resolution), (devidx, resolution)) \
+ F(PH_GetCountRate, (int devidx, int channel, int* rate), (devidx, channel, rate)) \
+ F(PH_GetFlags, (int devidx, int* flags), (devidx, flags)) \
+ F(PH_GetElapsedMeasTime, (int devidx, double* elapsed), (devidx, elapsed)) \
+ F(PH_GetWarnings, (int devidx, int* warnings), (devidx, warnings)) \
+ F(PH_GetWarningsText, (int devidx, char* text, int warnings), (devidx, text, warnings)) \
+ F(PH_SetMarkerEnable, (int devidx, int en0, int en1, int en2, int en3), (devidx, en0, en1, en2, en3)) \
+ F(PH_SetMarkerEdges, (int devidx, int me0, int me1, int me2, int me3), (devidx, me0, me1, me2, me3)) \
+ F(PH_SetMarkerHoldoffTime, (int devidx, int holdofftime), (devidx, holdofftime)) \
+ F(PH_GetRouterVersion, (int devidx, char* model, char* version), (devidx, model, version)) \
+ F(PH_GetRoutingChannels, (int devidx, int* rtchannels), (devidx, rtchannels)) \
+ F(PH_EnableRouting, (int devidx, int enable), (devidx, enable)) \
+ F(PH_SetRoutingChannelOffset, (int devidx, int channel, int offset), (devidx, channel, offset)) \
+ F(PH_SetPHR800Input, (int devidx, int channel, int level, int edge), (devidx, channel, level, edge)) \
+ F(PH_SetPHR800CFD, (int devidx, int channel, int level, int zc), (devidx, channel, level, zc))
+
+#define F(name, params, args) I_##name,
+enum { PH_FUNCTIONS I_PH_ReadFiFo, NFUNCTIONS };
+#undef F
+
+#define F(name, params, args) #name,
+static const char* Names[NFUNCTIONS] = { PH_FUNCTIONS "PH_ReadFiFo" };
+#undef F
+
+#define SIZECLASSES 33 //PH_ReadFiFo calls by records delivered: 0, 1, 2..3, 4..7, ...
+
+typedef struct
+{
+ void* real;
+ tt_mutex lock;
+ ttlat latency;
+ unsigned long long errors;
+} tracedfunc;
+
+static tracedfunc Funcs[NFUNCTIONS];
+static unsigned long long FiFoRecords, FiFoFull, FiFoSizes[SIZECLASSES];
+static double Started;
+static int Ready;
+
+#ifdef _WIN32
+static HMODULE RealLib;
+#else
+static sem_t Wake;                   //posted by the signal handler
+static volatile sig_atomic_t ReportWanted, EndSignal;
+static tt_thread Watcher;
+#endif
+
+
+static void* resolve(int i)
+{
+#ifdef _WIN32
+ const char* s;
+
+ if(RealLib==NULL)
+ {
+        s = getenv("PHTRACE_LIB");
+        RealLib = LoadLibraryA(s ? s : "PHLib64_real.dll");
+        if(RealLib==NULL)
+                return NULL;
+ }
+ Funcs[i].real = (void*)GetProcAddress(RealLib, Names[i]);
+#else
+ Funcs[i].real = dlsym(RTLD_NEXT, Names[i]);
+#endif
+ if(Funcs[i].real==NULL)
+        fprintf(stderr, "\nphtrace: %s not found in the traced library\n", Names[i]);
+ return Funcs[i].real;
+}
+
+
+static void record(int i, double us, int ret)
+{
+ tt_mutex_lock(&Funcs[i].lock);
+ ttlat_add(&Funcs[i].latency, us);
+ if(ret<0)
+        Funcs[i].errors++;
+ tt_mutex_unlock(&Funcs[i].lock);
+}
+
+
+#define F(name, params, args) \
+int _stdcall name params \
+{ \
+ double t; \
+ int ret; \
+ if(Funcs[I_##name].real==NULL && resolve(I_##name)==NULL) \
+        return ERROR_DEVICE_OPEN_FAIL; \
+ t = tt_now_us(); \
+ ret = ((int (_stdcall*) params)Funcs[I_##name].real) args; \
+ record(I_##name, tt_now_us()-t, ret); \
+ return ret; \
+}
+PH_FUNCTIONS
+#undef F
+
+
+int _stdcall PH_ReadFiFo(int devidx, unsigned int* buffer, int count, int* nactual)
+{
+ double t;
+ int ret, n, c = 0;
+
+ if(Funcs[I_PH_ReadFiFo].real==NULL && resolve(I_PH_ReadFiFo)==NULL)
+        return ERROR_DEVICE_OPEN_FAIL;
+ t = tt_now_us();
+ ret = ((int (_stdcall*)(int, unsigned int*, int, int*))Funcs[I_PH_ReadFiFo].real)(devidx, buffer, count, nactual);
+ t = tt_now_us()-t;
+ n = (ret>=0 && nactual) ? *nactual : 0;
+ while(c<SIZECLASSES-1 && (n>>c)>0)
+        c++;
+ tt_mutex_lock(&Funcs[I_PH_ReadFiFo].lock);
+ FiFoRecords += (unsigned)n;
+ FiFoSizes[c]++;
+ if(n==count)
+        FiFoFull++;
+ tt_mutex_unlock(&Funcs[I_PH_ReadFiFo].lock);
+ record(I_PH_ReadFiFo, t, ret);
+ return ret;
+}
+
+
+static void report(void)
+{
+ FILE* fp;
+ const char* path = getenv("PHTRACE_OUT");
+ ttlat* h;
+ int i, b, first, c;
+
+ if(!Ready)
+        return;
+ if(path==NULL)
+        path = "phtrace.json";
+ if((fp = fopen(path, "w"))==NULL)
+ {
+        fprintf(stderr, "\nphtrace: cannot write %s\n", path);
+        return;
+ }
+ fprintf(fp, "{\n \"elapsed_s\": %.6f,\n \"functions\": {", (tt_now_us()-Started)/1e6);
+ first = 1;
+ for(i=0;i<NFUNCTIONS;i++)
+ {
+        h = &Funcs[i].latency;
+        if(h->n==0)
+                continue;
+        tt_mutex_lock(&Funcs[i].lock);
+        fprintf(fp, "%s\n  \"%s\": {\"calls\": %llu, \"errors\": %llu, \"total_us\": %.1f, \"mean_us\": %.3f,",
+                first ? "" : ",", Names[i], h->n, Funcs[i].errors, h->sum_us, ttlat_mean(h));
+        fprintf(fp, " \"p50_us\": %.3f, \"p90_us\": %.3f, \"p99_us\": %.3f, \"p999_us\": %.3f, \"max_us\": %.3f,\n   \"histogram\": [",
+                ttlat_percentile(h, 50), ttlat_percentile(h, 90), ttlat_percentile(h, 99), ttlat_percentile(h, 99.9), h->max_us);
+        c = 0;
+        for(b=0;b<TTLAT_BUCKETS;b++)
+                if(h->counts[b])
+                        fprintf(fp, "%s[%.3f, %llu]", c++ ? ", " : "", ttlat_edge(b), h->counts[b]);
+        fprintf(fp, "]}");
+        tt_mutex_unlock(&Funcs[i].lock);
+        first = 0;
+ }
+ fprintf(fp, "\n },\n");
+
+ tt_mutex_lock(&Funcs[I_PH_ReadFiFo].lock);
+ fprintf(fp, " \"readfifo\": {\"records\": %llu, \"bytes\": %llu, \"full_calls\": %llu,\n  \"records_per_call\": [",
+        FiFoRecords, FiFoRecords*4, FiFoFull);
+ c = 0;
+ for(b=0;b<SIZECLASSES;b++) //as [smallest, largest, calls]
+        if(FiFoSizes[b])
+                fprintf(fp, "%s[%llu, %llu, %llu]", c++ ? ", " : "",
+                        b ? 1ULL<<(b-1) : 0ULL, b ? (1ULL<<b)-1 : 0ULL, FiFoSizes[b]);
+ tt_mutex_unlock(&Funcs[I_PH_ReadFiFo].lock);
+ fprintf(fp, "]}\n}\n");
+ fclose(fp);
+ fprintf(stderr, "\nphtrace: report written to %s\n", path);
+}
+
+
+static void init(void)
+{
+ int i;
+
+ for(i=0;i<NFUNCTIONS;i++)
+ {
+        tt_mutex_init(&Funcs[i].lock);
+        ttlat_init(&Funcs[i].latency);
+ }
+ Started = tt_now_us();
+ Ready = 1;
+}
+
+
+static void finish(void)
+{
+ report();
+ Ready = 0;
+}
+
+
+#ifdef _WIN32
+
+static BOOL WINAPI onctrl(DWORD type)
+{
+ report();
+ return FALSE; //on to the default handler, which ends the program
+}
+
+BOOL WINAPI DllMain(HINSTANCE inst, DWORD reason, LPVOID reserved)
+{
+ if(reason==DLL_PROCESS_ATTACH)
+ {
+        init();
+        SetConsoleCtrlHandler(onctrl, TRUE);
+ }
+ if(reason==DLL_PROCESS_DETACH)
+        finish();
+ return TRUE;
+}
+
+#else
+
+//only async-signal-safe calls here: the report takes stdio and the locks,
+//which the interrupted thread may hold
+static void onsignal(int sig)
+{
+ int err = errno;
+
+ if(sig==SIGUSR1)
+        ReportWanted = 1;
+ else
+        EndSignal = sig;
+ sem_post(&Wake);
+ errno = err;
+}
+
+//writes the reports the handler asks for, in a thread of its own
+static TT_THREADFUNC(watcher)
+{
+ sigset_t all, one;
+ int sig;
+
+ sigfillset(&all); //no handler runs on this thread
+ pthread_sigmask(SIG_BLOCK, &all, NULL);
+ for(;;)
+ {
+        if(sem_wait(&Wake)!=0)
+                continue; //EINTR
+        if(EndSignal)
+        {
+                sig = EndSignal;
+                finish();
+                signal(sig, SIG_DFL); //ends the program as the signal would have
+                sigemptyset(&one);
+                sigaddset(&one, sig);
+                pthread_sigmask(SIG_UNBLOCK, &one, NULL);
+                raise(sig);
+        }
+        if(ReportWanted)
+        {
+                ReportWanted = 0;
+                report();
+        }
+ }
+ TT_THREADRETURN;
+}
+
+__attribute__((constructor)) static void load(void)
+{
+ struct sigaction sa, old;
+ int sigs[3] = { SIGUSR1, SIGINT, SIGTERM };
+ int i;
+
+ init();
+ if(sem_init(&Wake, 0, 0)!=0 || tt_thread_create(&Watcher, watcher, NULL)<0)
+ {
+        fprintf(stderr, "\nphtrace: no reports on signals\n");
+        return;
+ }
+ memset(&sa, 0, sizeof(sa));
+ sa.sa_handler = onsignal;
+ for(i=0;i<3;i++) //leaves the program's own handlers alone
+        if(sigaction(sigs[i], NULL, &old)==0 && old.sa_handler==SIG_DFL)
+                sigaction(sigs[i], &sa, NULL);
+}
+
+__attribute__((destructor)) static void unload(void)
+{
+ finish();
+}
+
+#endif
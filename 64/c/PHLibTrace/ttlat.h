@@ -0,0 +1,41 @@
+/************************************************************************
+
+  Latency histograms
+
+  Counts durations in log-spaced buckets, 8 per power of two, so any
+  percentile is known to within 12.5% from 1 ns to hours with a few
+  kB of counts, in the manner of HDR histograms. Adding is a handful of
+  integer operations and never allocates, so it can be done for every
+  call of a hot loop.
+
+  A histogram has one writer; others may read it at any time and then
+  see counts that are at most a few calls behind.
+
+************************************************************************/
+
+#ifndef TTLAT_H
+#define TTLAT_H
+
+#define TTLAT_SUB      8             //buckets per power of two
+#define TTLAT_BUCKETS  (TTLAT_SUB*44) //up to 2^44 ns, about 4.9 hours
+
+typedef struct
+{
+ volatile unsigned long long counts[TTLAT_BUCKETS];
+ volatile unsigned long long n;
+ volatile double sum_us, max_us;
+} ttlat;
+
+void   ttlat_init(ttlat* h);
+void   ttlat_add(ttlat* h, double us);
+//adds the counts of src to h
+void   ttlat_merge(ttlat* h, const ttlat* src);
+
+//the duration p percent of the calls did not exceed, in microsec (the upper
+//edge of its bucket); 0 if there were none
+double ttlat_percentile(const ttlat* h, double p);
+double ttlat_mean(const ttlat* h);
+//the upper edge of bucket b in microsec, for listing the counts
+double ttlat_edge(int b);
+
+#endif
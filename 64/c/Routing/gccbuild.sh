@@ -0,0 +1,3 @@
+# Building this demo with gcc on Linux, against the PHLib stand-in in ../PHLibSim
+# (run its gccbuild.sh first)
+gcc -O2 routing.c histacc.c histout.c histrle.c -L../PHLibSim -Wl,-rpath,'$ORIGIN/../PHLibSim' -lphlib -o routing
@@ -0,0 +1,119 @@
+/************************************************************************
+
+  64 bit accumulation of histograms
+
+  See histacc.h. The AVX2 kernel is chosen at run time, see histcpu.h.
+
+************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "histcpu.h"
+#include "histacc.h"
+
+
+int histacc_init(histacc* a, int nbins)
+{
+ memset(a, 0, sizeof(histacc));
+ if(nbins<1)
+        return -1;
+ if((a->sum = (unsigned long long*)calloc(nbins, sizeof(unsigned long long)))==NULL)
+        return -1;
+ a->nbins = nbins;
+ return 0;
+}
+
+
+void histacc_free(histacc* a)
+{
+ free(a->sum);
+ a->sum = NULL;
+}
+
+
+void histacc_clear(histacc* a)
+{
+ memset(a->sum, 0, a->nbins*sizeof(unsigned long long));
+ a->runs = 0;
+ a->discarded = 0;
+ a->livetime_ms = 0;
+}
+
+
+#ifdef HIST_HAVE_AVX2
+//bins 0 to n-1 rounded down to 4, returns how many were done
+HIST_AVX2 static int widen_avx2(unsigned long long* sum, const unsigned int* counts, int n)
+{
+ int i;
+ __m256i c;
+
+ for(i=0;i+4<=n;i+=4)
+ {
+        c = _mm256_cvtepu32_epi64(_mm_loadu_si128((const __m128i*)(counts+i)));
+        _mm256_storeu_si256((__m256i*)(sum+i), _mm256_add_epi64(_mm256_loadu_si256((const __m256i*)(sum+i)), c));
+ }
+ return i;
+}
+#endif
+
+
+//the same with SSE2, or none
+static int widen_sse2(unsigned long long* sum, const unsigned int* counts, int n)
+{
+ int i = 0;
+#if defined(HIST_HAVE_SSE2)
+ const __m128i zero = _mm_setzero_si128();
+ __m128i c;
+
+ for(;i+4<=n;i+=4)
+ {
+        c = _mm_loadu_si128((const __m128i*)(counts+i));
+        _mm_storeu_si128((__m128i*)(sum+i),
+                _mm_add_epi64(_mm_loadu_si128((const __m128i*)(sum+i)), _mm_unpacklo_epi32(c, zero)));
+        _mm_storeu_si128((__m128i*)(sum+i+2),
+                _mm_add_epi64(_mm_loadu_si128((const __m128i*)(sum+i+2)), _mm_unpackhi_epi32(c, zero)));
+ }
+#endif
+ return i;
+}
+
+
+void histacc_widen(unsigned long long* sum, const unsigned int* counts, int n)
+{
+ int i;
+
+#ifdef HIST_HAVE_AVX2
+ if(histcpu_avx2())
+        i = widen_avx2(sum, counts, n);
+ else
+#endif
+        i = widen_sse2(sum, counts, n);
+ for(;i<n;i++)
+        sum[i] += counts[i];
+}
+
+
+void histacc_add(histacc* a, const unsigned int* counts, double elapsed_ms, int overflow)
+{
+ if(overflow)
+ {
+        a->discarded++;
+        return;
+ }
+ histacc_widen(a->sum, counts, a->nbins);
+ a->runs++;
+ a->livetime_ms += elapsed_ms;
+}
+
+
+unsigned long long histacc_peak(const histacc* a)
+{
+ unsigned long long peak = 0;
+ int i;
+
+ for(i=0;i<a->nbins;i++)
+        if(a->sum[i] > peak)
+                peak = a->sum[i];
+ return peak;
+}
@@ -0,0 +1,42 @@
+/************************************************************************
+
+  64 bit accumulation of histograms
+
+  A PicoHarp histogram bin holds at most 65535 counts, and with
+  PH_SetStopOverflow the measurement ends when any bin gets there. For
+  deeper histograms many short measurements are added up here in 64 bit
+  bins, together with their live time from PH_GetElapsedMeasTime.
+
+  Adding is a widening add of 32 bit counts to 64 bit sums, done with
+  AVX2 where the CPU has it (see histcpu.h), SSE2 on any other x64
+  CPU and a scalar loop elsewhere.
+
+************************************************************************/
+
+#ifndef HISTACC_H
+#define HISTACC_H
+
+typedef struct
+{
+ unsigned long long* sum;            //nbins
+ int nbins;
+ long long runs;                     //histograms added
+ long long discarded;                //not added because a bin was clipped
+ double livetime_ms;                 //of the runs added
+} histacc;
+
+//returns 0 or -1
+int  histacc_init(histacc* a, int nbins);
+void histacc_free(histacc* a);
+void histacc_clear(histacc* a);
+
+//adds a histogram of nbins counts measured for elapsed_ms; a histogram with
+//a clipped bin (FLAG_OVERFLOW) is counted as discarded instead if overflow is 1
+void histacc_add(histacc* a, const unsigned int* counts, double elapsed_ms, int overflow);
+//the highest sum
+unsigned long long histacc_peak(const histacc* a);
+
+//sum[i] += counts[i] for n bins
+void histacc_widen(unsigned long long* sum, const unsigned int* counts, int n);
+
+#endif
@@ -0,0 +1,74 @@
+/************************************************************************
+
+  CPU features for the histogram kernels
+
+  The AVX2 kernels of histsum.c, histacc.c and histrle.c are compiled
+  with a per-function target attribute (gcc/clang) or directly (MSVC
+  2013 and later), so no special compiler flags are needed; whether
+  they are used is decided at run time from the CPU, as in ttdecode.c.
+  The SSE2 kernels need nothing, every x64 CPU has SSE2.
+
+************************************************************************/
+
+#ifndef HISTCPU_H
+#define HISTCPU_H
+
+#if (defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))) || \
+    (defined(_MSC_VER) && _MSC_VER>=1800 && (defined(_M_X64) || defined(_M_IX86)))
+#define HIST_HAVE_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define HIST_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef __GNUC__
+#define HIST_AVX2 __attribute__((target("avx2")))
+#else
+#define HIST_AVX2
+#endif
+
+
+#ifdef HIST_HAVE_AVX2
+
+static int HistAvx2 = -1;  //-1 means not yet checked, one per file that includes this
+
+
+static int histcpu_check(void)
+{
+#if defined(_MSC_VER)
+ int info[4];
+
+ __cpuid(info, 0);
+ if(info[0]<7)
+        return 0;
+ __cpuid(info, 1);
+ if(!(info[2] & (1<<27)) || !(info[2] & (1<<28)))  //OSXSAVE and AVX
+        return 0;
+ if((_xgetbv(0) & 6) != 6)                          //OS saves the YMM registers
+        return 0;
+ __cpuidex(info, 7, 0);
+ return (info[1] & (1<<5)) != 0;
+#else
+ __builtin_cpu_init();
+ return __builtin_cpu_supports("avx2");
+#endif
+}
+
+
+//1 if the AVX2 kernels can run on this CPU
+static int histcpu_avx2(void)
+{
+ if(HistAvx2<0)
+        HistAvx2 = histcpu_check();
+ return HistAvx2;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,45 @@
+/************************************************************************
+
+  Sparse histograms
+
+  Outside the region of interest most bins of a PicoHarp histogram are
+  zero. The run-length code here stores a histogram as runs: the number
+  of zero bins to skip, the number of counts that follow, and those
+  counts, 16 bit wide when no count needs more (always so for a single
+  PicoHarp measurement) and 32 bit otherwise. Zero runs too short to be
+  worth a new run stay in the counts.
+
+  The code is a plain block of memory starting with a histrle_header,
+  so it can go into a file (see histout.h) or any other buffer, e.g. a
+  shared memory slot. Encoding finds the zero runs 32 (AVX2, where the
+  CPU has it) or 16 (SSE2) bins at a time; decoding does a memset and a
+  copy per run, with no test per bin.
+
+************************************************************************/
+
+#ifndef HISTRLE_H
+#define HISTRLE_H
+
+#include <stddef.h>
+
+#define HISTRLE_MAGIC 0x454C5248   //"HRLE"
+
+typedef struct
+{
+ unsigned int magic;                 //HISTRLE_MAGIC
+ unsigned int nbins;
+ unsigned int width;                 //bytes per count, 2 or 4
+ unsigned int size;                  //bytes of runs that follow
+} histrle_header;
+//each run: unsigned int zeros, unsigned int n, n counts of width bytes;
+//bins after the last run are zero
+
+//the most bytes histrle_encode can need for nbins
+size_t histrle_bound(int nbins);
+//codes nbins counts into out (histrle_bound(nbins) bytes), returns the bytes used
+size_t histrle_encode(const unsigned int* counts, int nbins, void* out);
+//decodes size bytes into counts (room for maxbins), returns the number of
+//bins, or -1 if the code is corrupt or does not fit
+int histrle_decode(const void* in, size_t size, unsigned int* counts, int maxbins);
+
+#endif
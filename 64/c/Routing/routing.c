@@ -22,26 +22,39 @@
 
 ************************************************************************/
 
+#ifdef _WIN32
 #include <windows.h>
 #include <dos.h>
-#include <stdio.h>
 #include <conio.h>
+#else
+#include <unistd.h>
+#define Sleep(msec) usleep((msec)*1000)
+#define __int64 long long
+#endif
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "phdefin.h"
 #include "phlib.h"
 #include "errorcodes.h"
+#include "histacc.h"
+#include "histout.h"
+#include "histrle.h"
 
 //keep large histogram buffer outside main to prevent stack overflow
 unsigned int counts[4][HISTCHAN]; //histograms of 4 channels
 
+//sums of the 4 histograms over the runs, see Accumulate in main
+histacc Acc;
+
 
 int main(int argc, char* argv[])
 {
  int dev[MAXDEVNUM]; 
  int found=0;
  FILE *fpout;   
+ FILE *fpruns=NULL;
  int retcode;
  char LIB_Version[8];
  char HW_Model[16];
@@ -54,6 +67,7 @@ int main(int argc, char* argv[])
  int Binning=0; //you can change this
  int Offset=0; 
  int Tacq=500; //Measurement time in millisec, you can change this
+ int PollMargin=20; //you can change this, millisec before the end of Tacq from which on the status is polled
  int SyncDivider = 8; //you can change this, read manual!
  int CFDZeroCross0=10; //you can change this
  int CFDLevel0=100; //you can change this
@@ -63,8 +77,19 @@ int main(int argc, char* argv[])
  int PHR800Edge = 0;     //you can change this but watch for deadlock
  int PHR800CFDLevel = 100; //you can change this
  int PHR800CFDZeroCross = 10; //you can change this
+ int Accumulate = 0; //you can change this, 1 repeats the measurement without asking and adds the histograms up in 64 bit bins (see histacc.h)
+ double AccumulatePeak = 1e6; //you can change this, stops when the peak bin of the sums has so many counts
+ int AccumulateRuns = 1000; //you can change this, stops after so many runs in any case
+ int SaveBinary = 0; //you can change this, 1 saves the histograms to routing.hst in the binary format of histout.h instead of as a table to routing.out
+ int SaveRuns = 0; //you can change this, 1 also appends the 4 histograms of each run to routing_runs.hst (see histout.h)
+ int SaveSparse = 0; //you can change this, 1 run-length codes the histograms in routing_runs.hst and routing.hst (not the 64 bit sums), mostly zero bins take no room (see histrle.h)
+ histout_header Header;
+ void* Sparse=NULL;
+ long long run=0;
  int rtchannels;
  double Resolution; 
+ double Elapsed;
+ unsigned long long Peak;
  int Countrate0;
  int Countrate1;
  __int64 Integralcount;
@@ -269,6 +294,28 @@ int main(int argc, char* argv[])
 
  PH_SetStopOverflow(dev[0],1,65535);
 
+ if(Accumulate && histacc_init(&Acc,4*HISTCHAN)<0)
+ {
+        printf("\ncannot allocate the accumulator\n");
+        goto ex;
+ }
+
+ histout_init(&Header,HISTCHAN,4,sizeof(unsigned int));
+ Header.binning = Binning;
+ Header.offset = Offset;
+ Header.syncdivider = SyncDivider;
+ Header.resolution = Resolution;
+ if(SaveSparse && (Sparse=malloc(histrle_bound(4*HISTCHAN)))==NULL)
+ {
+        printf("\ncannot allocate the coding buffer\n");
+        goto ex;
+ }
+ if(SaveRuns && (fpruns=fopen("routing_runs.hst","wb"))==NULL)
+ {
+        printf("\ncannot open routing_runs.hst\n");
+        goto ex;
+ }
+
  while(cmd!='q')
  { 
 
@@ -281,8 +328,11 @@ int main(int argc, char* argv[])
                 goto ex;
         }
 
-        printf("\npress RETURN to start measurement");
-        getchar();
+        if(!Accumulate)
+        {
+                printf("\npress RETURN to start measurement");
+                getchar();
+        }
 
         retcode = PH_GetCountRate(dev[0],0,&Countrate0);
         if(retcode<0)
@@ -298,7 +348,8 @@ int main(int argc, char* argv[])
                 goto ex;
         }
 
-        printf("\nCountrate0=%1d/s Countrate1=%1d/s",Countrate0,Countrate1);
+        if(!Accumulate)
+                printf("\nCountrate0=%1d/s Countrate1=%1d/s",Countrate0,Countrate1);
         
         retcode = PH_StartMeas(dev[0],Tacq); 
         if(retcode<0)
@@ -307,8 +358,14 @@ int main(int argc, char* argv[])
                 goto ex;
         }
          
-        printf("\nMeasuring for %1d milliseconds...",Tacq);
+        if(!Accumulate)
+                printf("\nMeasuring for %1d milliseconds...",Tacq);
         
+        //nothing can happen before the end of Tacq, so sleep until shortly
+        //before it instead of keeping the CPU and the USB busy with status calls
+        if(Tacq>PollMargin)
+                Sleep(Tacq-PollMargin);
+
         waitloop=0;
         ctcstatus=0;
         while(ctcstatus==0) 
@@ -320,6 +377,8 @@ int main(int argc, char* argv[])
                         goto ex;
                 }
                 waitloop++; 
+                if(ctcstatus==0)
+                        Sleep(1);
         }
          
         retcode = PH_StopMeas(dev[0]);
@@ -340,7 +399,8 @@ int main(int argc, char* argv[])
                 Integralcount = 0;
                 for(j=0;j<HISTCHAN;j++)
                         Integralcount+=counts[i][j];
-                printf("\nTotal count in channel %1d = %9I64d",i+1,Integralcount);
+                if(!Accumulate)
+                        printf("\nTotal count in channel %1d = %9.0lf",i+1,(double)Integralcount);
         }
 
         retcode = PH_GetFlags(dev[0],&flags);
@@ -350,18 +410,67 @@ int main(int argc, char* argv[])
                 goto ex;
         }
 
+        retcode = PH_GetElapsedMeasTime(dev[0],&Elapsed);
+        if(retcode<0)
+        {
+                printf("\nError %1d in GetElapsedMeasTime. Aborted.\n",retcode);
+                goto ex;
+        }
+
+        Header.cycle = run++;
+        Header.flags = flags;
+        Header.elapsed_ms = Elapsed;
+        if(fpruns && (Sparse ? histout_writesparse(fpruns,&Header,counts[0],Sparse)
+                : histout_write(fpruns,&Header,counts[0]))<0) //all 4 blocks, they follow each other
+        {
+                printf("\ncannot write routing_runs.hst\n");
+                goto ex;
+        }
+
+        if(Accumulate)
+        {
+                histacc_add(&Acc,counts[0],Elapsed,flags&FLAG_OVERFLOW); //all 4 blocks, they follow each other
+                if((flags&FLAG_OVERFLOW) && Tacq>ACQTMIN)
+                {
+                        Tacq = Tacq/2>ACQTMIN ? Tacq/2 : ACQTMIN;
+                        printf("\nA bin reached the stop count, measuring %d milliseconds per run from now on\n",Tacq);
+                }
+                Peak = histacc_peak(&Acc);
+                printf("\rRun %lld, peak %llu counts  ",Acc.runs+Acc.discarded,Peak);
+                if(Peak>=AccumulatePeak || Acc.runs+Acc.discarded>=AccumulateRuns)
+                        break;
+                continue;
+        }
+
         if(flags&FLAG_OVERFLOW) printf("\nOverflow.");
 
         printf("\nEnter c to continue or q to quit and save the count data.");
         cmd=getchar();
  }
  
- //output histograms of the 4 channels as a 4 column table
- for(i=0;i<HISTCHAN;i++)
-        fprintf(fpout,"\n%9d %9d %9d %9d",counts[0][i],counts[1][i],counts[2][i],counts[3][i]);
+ //output histograms of the 4 channels as a 4 column table, or binary (see histout.h)
+ if(Accumulate)
+ {
+        printf("\nAccumulated %lld runs (%lld discarded with a clipped bin), %1.3lf s live time",
+                Acc.runs, Acc.discarded, Acc.livetime_ms/1000.0);
+        Header.countbytes = sizeof(unsigned long long);
+        Header.cycle = 0;
+        Header.flags = 0;
+        Header.elapsed_ms = Acc.livetime_ms;
+        retcode = SaveBinary ? histout_save("routing.hst",&Header,Acc.sum,NULL)
+                : histout_text64(fpout,Acc.sum,4,HISTCHAN,HISTCHAN,9);
+ }
+ else
+        retcode = SaveBinary ? histout_save("routing.hst",&Header,counts[0],Sparse)
+                : histout_text(fpout,counts[0],4,HISTCHAN,HISTCHAN,9);
+ if(retcode<0)
+        printf("\ncannot write the histograms\n");
 
 ex:
  if(fpout) fclose(fpout);
+ if(fpruns) fclose(fpruns);
+ free(Sparse);
+ histacc_free(&Acc);
 
  for(i=0;i<MAXDEVNUM;i++) //no harm to close all
  {
@@ -17,16 +17,212 @@
 
 ************************************************************************/
 
+#ifdef _WIN32
 #include <windows.h>
 #include <dos.h>
-#include <stdio.h>
 #include <conio.h>
+#else
+#include <unistd.h>
+#define Sleep(msec) usleep((msec)*1000)
+#endif
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "phdefin.h"
 #include "phlib.h"
 #include "errorcodes.h"
+#include "ttport.h"
+#include "histpipe.h"
+#include "histacc.h"
+#include "histsum.h"
+#include "histout.h"
+#include "histrle.h"
+
+
+//continuous mode, see Continuous in main: the processing thread adds up each
+//histogram and keeps the last one for saving
+unsigned int Last[HISTCHAN];
+double TotalCount=0, LiveTime=0;
+int Overflows=0;
+FILE *fpcycles=NULL;
+histout_header Header; //the settings, for the records in dlldemo_cycles.bin and dlldemo.hst
+void* Sparse=NULL; //room for a run-length coded histogram, see SaveSparse in main
+
+//accumulation, see Accumulate in main: the processing thread adds the histograms up
+histacc Acc;
+int Accumulating=0;
+double AccPeak=0;
+volatile unsigned int Enough=0; //the peak has been reached, no more cycles
+
+
+//on the processing thread, for each histogram in turn
+void process(histpipe_slot* slot, void* arg)
+{
+ histsum_result r;
+
+ histsum(slot->counts,HISTCHAN,NULL,0,&r);
+ TotalCount += (double)r.total;
+ LiveTime += slot->elapsed_ms;
+ if(slot->flags&FLAG_OVERFLOW)
+        Overflows++;
+ Header.cycle = slot->cycle;
+ Header.flags = slot->flags;
+ Header.elapsed_ms = slot->elapsed_ms;
+ if(fpcycles && Sparse)
+        histout_writesparse(fpcycles,&Header,slot->counts,Sparse);
+ else if(fpcycles)
+        histout_write(fpcycles,&Header,slot->counts);
+ memcpy(Last,slot->counts,sizeof(Last));
+ if(Accumulating)
+ {
+        histacc_add(&Acc,slot->counts,slot->elapsed_ms,slot->flags&FLAG_OVERFLOW);
+        if(AccPeak>0 && histacc_peak(&Acc)>=AccPeak)
+                tt_store_release(&Enough,1);
+ }
+}
+
+
+//measures cycles histograms of tacq back to back; while one is processed the
+//device already measures the next, so it only waits for the readout. When
+//accumulating, stops early at the peak and shortens tacq if a bin is clipped
+int runcontinuous(int devidx, int tacq, long long cycles, int pollmargin, int slots)
+{
+ histpipe pipe;
+ histpipe_slot* slot;
+ long long c;
+ double tstart, started, now, due, dead, deadsum=0, deadmax=0, t;
+ int ctcstatus, runtacq, more;
+ int retcode;
+ int ret=-1;
+
+ if(histpipe_init(&pipe,slots,HISTCHAN,process,NULL)<0)
+ {
+        printf("\ncannot start the histogram pipeline\n");
+        return -1;
+ }
+ tt_timer_begin(); //1 ms sleeps while waiting for the end of each cycle, see ttport.h
+ printf("\nMeasuring %lld histograms of %d milliseconds...",cycles,tacq);
+
+ retcode = PH_ClearHistMem(devidx,0);
+ if(retcode<0)
+ {
+        printf("\nPH_ClearHistMem Error %1d. Aborted.\n",retcode);
+        goto ex;
+ }
+ retcode = PH_StartMeas(devidx,tacq); 
+ if(retcode<0)
+ {
+        printf("\nError %1d in StartMeas. Aborted.\n",retcode);
+        goto ex;
+ }
+ tstart = started = tt_now_us();
+ runtacq = tacq;
+
+ for(c=0;c<cycles;c++)
+ {
+        //nothing can happen before the end of tacq
+        due = started + (tacq-pollmargin)*1000.0;
+        now = tt_now_us();
+        if(due>now)
+                tt_sleep_us((int)(due-now));
+        do
+        {
+                retcode = PH_CTCStatus(devidx,&ctcstatus);
+                if(retcode<0)
+                {
+                        printf("\nError %1d in CTCStatus. Aborted.\n",retcode);
+                        goto ex;
+                }
+                if(ctcstatus==0)
+                        tt_sleep_us(100);
+        }
+        while(ctcstatus==0);
+
+        retcode = PH_StopMeas(devidx);
+        if(retcode<0)
+        {
+                printf("\nError %1d in StopMeas. Aborted.\n",retcode);
+                goto ex;
+        }
+
+        slot = histpipe_acquire(&pipe); //waits only if the processing falls behind by all slots
+        retcode = PH_GetHistogram(devidx,slot->counts,0);
+        if(retcode<0)
+        {
+                printf("\nError %1d in GetHistogram. Aborted.\n",retcode);
+                goto ex;
+        }
+        retcode = PH_GetFlags(devidx,&slot->flags);
+        if(retcode<0)
+        {
+                printf("\nError %1d in GetFlags. Aborted.\n",retcode);
+                goto ex;
+        }
+        retcode = PH_GetElapsedMeasTime(devidx,&slot->elapsed_ms);
+        if(retcode<0)
+        {
+                printf("\nError %1d in GetElapsedMeasTime. Aborted.\n",retcode);
+                goto ex;
+        }
+        slot->cycle = c;
+        slot->started_us = started;
+        if(Accumulating && (slot->flags&FLAG_OVERFLOW) && tacq>ACQTMIN)
+        {
+                tacq = tacq/2>ACQTMIN ? tacq/2 : ACQTMIN;
+                printf("\nA bin reached the stop count, measuring %d milliseconds per cycle from now on",tacq);
+        }
+
+        retcode = PH_ClearHistMem(devidx,0);
+        if(retcode<0)
+        {
+                printf("\nPH_ClearHistMem Error %1d. Aborted.\n",retcode);
+                goto ex;
+        }
+        more = c+1<cycles && !tt_load_acquire(&Enough);
+        if(more)
+        {
+                retcode = PH_StartMeas(devidx,tacq); 
+                if(retcode<0)
+                {
+                        printf("\nError %1d in StartMeas. Aborted.\n",retcode);
+                        goto ex;
+                }
+                now = tt_now_us();
+                dead = now - started - runtacq*1000.0;
+                deadsum += dead;
+                if(dead>deadmax)
+                        deadmax = dead;
+                started = now;
+                runtacq = tacq;
+        }
+        histpipe_commit(&pipe); //processed while the next one is measured
+        if(!more)
+        {
+                c++;
+                break;
+        }
+ }
+ ret = 0;
+
+ex:
+ t = tt_now_us();
+ tt_timer_end();
+ histpipe_close(&pipe);
+ if(ret==0)
+ {
+        t = (t-tstart)/1e6;
+        printf("\n%lld histograms in %1.3lf s, %1.1lf histograms/s",c,t,c/t);
+        if(c>1)
+                printf("\nDead time per cycle: mean %1.3lf ms, max %1.3lf ms (%1.1lf%% of the time)",
+                        deadsum/(c-1)/1000.0, deadmax/1000.0, 100.0*deadsum/1e6/t);
+        printf("\nProcessing: %1.3lf ms per histogram, the device waited %u times for it (%1.3lf ms)",
+                pipe.processed ? pipe.processtime_us/pipe.processed/1000.0 : 0.0, pipe.stalls, pipe.stalltime_us/1000.0);
+        printf("\nTotalCount=%1.0lf in %1.3lf s live time, %d histograms with overflow",
+                TotalCount, LiveTime/1000.0, Overflows);
+ }
+ return ret;
+}
 
 
 int main(int argc, char* argv[])
@@ -45,15 +241,26 @@ int main(int argc, char* argv[])
  int Binning=0; //you can change this
  int Offset=0; 
  int Tacq=1000; //Measurement time in millisec, you can change this
+ int PollMargin=20; //you can change this, millisec before the end of Tacq from which on the status is polled
  int SyncDivider = 8; //you can change this 
  int CFDZeroCross0=10; //you can change this
  int CFDLevel0=100; //you can change this
  int CFDZeroCross1=10; //you can change this
  int CFDLevel1=100; //you can change this
+ int Continuous=0; //you can change this, 1 runs Cycles measurements of CycleTacq back to back without asking (see histpipe.h)
+ int Cycles=1000; //you can change this
+ int CycleTacq=ACQTMIN; //you can change this, measurement time of each cycle in millisec
+ int PipeSlots=4; //you can change this, number of histograms the processing may fall behind
+ int SaveCycles=0; //you can change this, 1 also appends each histogram of the cycles to dlldemo_cycles.bin (see histout.h)
+ int SaveBinary=0; //you can change this, 1 saves the histogram to dlldemo.hst in the binary format of histout.h instead of as text to dlldemo.out
+ int SaveSparse=0; //you can change this, 1 run-length codes the histograms in dlldemo_cycles.bin and dlldemo.hst (not the 64 bit sums), mostly zero bins take no room (see histrle.h)
+ int Accumulate=0; //you can change this, 1 runs the cycles as Continuous does but adds them up in 64 bit bins and saves the sum (see histacc.h)
+ double AccumulatePeak=1e6; //you can change this, ends the cycles when the peak bin of the sum has so many counts, 0 to run all Cycles
  double Resolution; 
  int Countrate0;
  int Countrate1;
  double Integralcount; 
+ histsum_result Sums;
  unsigned int counts[HISTCHAN];
  int i;
  int flags;
@@ -214,6 +421,55 @@ int main(int argc, char* argv[])
         goto ex;
  }
 
+ histout_init(&Header,HISTCHAN,1,sizeof(unsigned int));
+ Header.binning = Binning;
+ Header.offset = Offset;
+ Header.syncdivider = SyncDivider;
+ Header.resolution = Resolution;
+ if(SaveSparse && (Sparse=malloc(histrle_bound(HISTCHAN)))==NULL)
+ {
+        printf("\ncannot allocate the coding buffer\n"); 
+        goto ex;
+ }
+
+ if(Continuous || Accumulate)
+ {
+        if(SaveCycles && (fpcycles=fopen("dlldemo_cycles.bin","wb"))==NULL)
+        {
+                printf("\ncannot open dlldemo_cycles.bin\n"); 
+                goto ex;
+        }
+        if(Accumulate)
+        {
+                if(histacc_init(&Acc,HISTCHAN)<0)
+                {
+                        printf("\ncannot allocate the accumulator\n"); 
+                        goto ex;
+                }
+                AccPeak = AccumulatePeak;
+                Accumulating = 1;
+        }
+        if(runcontinuous(dev[0],CycleTacq,Cycles,PollMargin,PipeSlots)<0)
+                goto ex;
+        if(Accumulating)
+        {
+                printf("\nAccumulated %lld histograms (%lld discarded with a clipped bin), %1.3lf s live time, peak %llu counts",
+                        Acc.runs, Acc.discarded, Acc.livetime_ms/1000.0, histacc_peak(&Acc));
+                Header.countbytes = sizeof(unsigned long long);
+                Header.cycle = 0;
+                Header.flags = 0;
+                Header.elapsed_ms = Acc.livetime_ms;
+                retcode = SaveBinary ? histout_save("dlldemo.hst",&Header,Acc.sum,NULL)
+                        : histout_text64(fpout,Acc.sum,1,HISTCHAN,HISTCHAN,5);
+        }
+        else //the last one, Header still describes it
+                retcode = SaveBinary ? histout_save("dlldemo.hst",&Header,Last,Sparse)
+                        : histout_text(fpout,Last,1,HISTCHAN,HISTCHAN,5);
+        if(retcode<0)
+                printf("\ncannot write the histogram\n");
+        goto ex;
+ }
+
  while(cmd!='q')
  { 
         retcode = PH_ClearHistMem(dev[0],0);             // always use Block 0 if not Routing
@@ -251,6 +507,11 @@ int main(int argc, char* argv[])
          
         printf("\nMeasuring for %1d milliseconds...",Tacq);
         
+        //nothing can happen before the end of Tacq, so sleep until shortly
+        //before it instead of keeping the CPU and the USB busy with status calls
+        if(Tacq>PollMargin)
+                Sleep(Tacq-PollMargin);
+
         waitloop=0;
         ctcstatus=0;
         while(ctcstatus==0) 
@@ -262,6 +523,8 @@ int main(int argc, char* argv[])
                         goto ex;
                 }
                 waitloop++; 
+                if(ctcstatus==0)
+                        Sleep(1);
         }
          
         retcode = PH_StopMeas(dev[0]);
@@ -285,11 +548,12 @@ int main(int argc, char* argv[])
                 goto ex;
         }
 
-        Integralcount = 0;
-        for(i=0;i<HISTCHAN;i++)
-                Integralcount+=counts[i];
+        histsum(counts,HISTCHAN,NULL,0,&Sums);
+        Integralcount = (double)Sums.total;
         
         printf("\nWaitloop=%1d  TotalCount=%1.0lf",waitloop,Integralcount);
+        if(Sums.total>0)
+                printf("  Peak=%u at %1.0lfps  FWHM=%1.0lfps",Sums.peak,Sums.peakbin*Resolution,Sums.fwhm*Resolution);
         
         if(flags&FLAG_OVERFLOW) printf("  Overflow.");
 
@@ -298,8 +562,17 @@ int main(int argc, char* argv[])
         getchar();
  }
  
- for(i=0;i<HISTCHAN;i++)
-         fprintf(fpout,"\n%5d",counts[i]);
+ Header.flags = flags;
+ retcode = PH_GetElapsedMeasTime(dev[0],&Header.elapsed_ms);
+ if(retcode<0)
+ {
+        printf("\nError %1d in GetElapsedMeasTime. Aborted.\n",retcode);
+        goto ex;
+ }
+ retcode = SaveBinary ? histout_save("dlldemo.hst",&Header,counts,Sparse)
+        : histout_text(fpout,counts,1,HISTCHAN,HISTCHAN,5);
+ if(retcode<0)
+        printf("\ncannot write the histogram\n");
 
 ex:
  for(i=0;i<MAXDEVNUM;i++) //no harm to close all
@@ -307,6 +580,9 @@ ex:
          PH_CloseDevice(i);
  }
  if(fpout) fclose(fpout);
+ if(fpcycles) fclose(fpcycles);
+ free(Sparse);
+ if(Accumulating) histacc_free(&Acc);
 
  printf("\npress RETURN to exit");
  getchar();
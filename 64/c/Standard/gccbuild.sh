@@ -0,0 +1,4 @@
+# Building this demo with gcc on Linux, against the PHLib stand-in in ../PHLibSim
+# (run its gccbuild.sh first)
+gcc -O2 dlldemo.c histacc.c histout.c histpipe.c histrle.c histsum.c -L../PHLibSim -Wl,-rpath,'$ORIGIN/../PHLibSim' -lphlib -lpthread -o dlldemo
+gcc -O2 histbench.c histout.c histrle.c histsum.c -lm -o histbench
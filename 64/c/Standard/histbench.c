@@ -0,0 +1,331 @@
+/************************************************************************
+
+  PicoHarp 300    Histogram Processing Benchmark in C
+
+  Times the loops the demos used to sum up and to save their histograms
+  against histsum.h and histout.h, on a synthetic decay curve of
+  HISTCHAN bins:
+
+        histbench [repeats]
+
+  "dlldemo" is the double sum dlldemo had, "routing" the 64 bit sum over
+  the 4 routing blocks, "scalar" the total, peak, centroid and FWHM in
+  plain loops; histsum gets the same in one pass, and for the routing
+  blocks the 4 block totals as windows. All results are checked against
+  the scalar ones. The AVX2 kernel is used where the CPU has it, the
+  SSE2 one otherwise (see histcpu.h).
+
+  Saving writes histbench.tmp, once per line with fprintf as dlldemo
+  and routing did, then with histout_text, which must give the same
+  file, and as a binary record; the file is removed afterwards.
+
+  Finally the run-length code of histrle.h, on a curve that is zero
+  outside its region of interest, as a measurement without background
+  gives: coding, decoding and the size against the raw counts.
+
+  Note: This is a console application
+
+************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "phdefin.h"
+#include "ttport.h"
+#include "histsum.h"
+#include "histout.h"
+#include "histrle.h"
+
+
+int Repeats = 2000; //you can change this, or give it on the command line
+double Sink = 0; //results go here so that no loop is optimized away
+
+
+//one exponential decay plus background, with some noise
+void synth(unsigned int* counts, int n, unsigned int seed)
+{
+ int i;
+
+ for(i=0;i<n;i++)
+ {
+        seed = seed*1664525u + 1013904223u;
+        counts[i] = (unsigned int)(20 + (i>1000 ? 40000*exp(-(i-1000)/3000.0) : 0) + (seed>>24));
+ }
+}
+
+
+//a decay over a region of interest with single counts here and there, zero elsewhere
+void sparse(unsigned int* counts, int n, unsigned int seed)
+{
+ int i;
+
+ for(i=0;i<n;i++)
+ {
+        seed = seed*1664525u + 1013904223u;
+        counts[i] = i>=1000 && i<13000 ? (unsigned int)(2000*exp(-(i-1000)/1500.0)) : (seed>>20)==0;
+ }
+}
+
+
+void scalar(const unsigned int* c, int n, histsum_result* r)
+{
+ double wsum = 0, half;
+ double left, right;
+ int i;
+
+ r->total = 0;
+ r->peak = 0;
+ r->peakbin = 0;
+ for(i=0;i<n;i++)
+        r->total += c[i];
+ for(i=0;i<n;i++)
+        if(c[i] > r->peak)
+        {
+                r->peak = c[i];
+                r->peakbin = i;
+        }
+ for(i=0;i<n;i++)
+        wsum += (double)i*c[i];
+ r->centroid = r->total ? wsum/r->total : 0;
+ half = r->peak/2.0;
+ for(i=r->peakbin;i>0 && c[i-1]>=half;i--)
+        ;
+ left = i>0 ? i-1 + (half-c[i-1])/((double)c[i]-c[i-1]) : i;
+ for(i=r->peakbin;i<n-1 && c[i+1]>=half;i++)
+        ;
+ right = i<n-1 ? i + (c[i]-half)/((double)c[i]-c[i+1]) : i;
+ r->fwhm = r->peak ? right-left : 0;
+}
+
+
+//the time to write and close histbench.tmp with a way of saving, -1 if it failed;
+//ncols 1 saves as dlldemo did, 4 as routing did
+double save(const unsigned int* counts, int ncols, int how)
+{
+ FILE* fp;
+ histout_header h;
+ double t = tt_now_us();
+ int i, err = 0;
+
+ if((fp = fopen("histbench.tmp","wb"))==NULL)
+        return -1;
+ if(how==0 && ncols==1)
+        for(i=0;i<HISTCHAN;i++)
+                fprintf(fp,"\n%5d",counts[i]);
+ else if(how==0)
+        for(i=0;i<HISTCHAN;i++)
+                fprintf(fp,"\n%9d %9d %9d %9d",counts[i],counts[HISTCHAN+i],counts[2*HISTCHAN+i],counts[3*HISTCHAN+i]);
+ else if(how==1)
+        err = histout_text(fp,counts,ncols,HISTCHAN,HISTCHAN,ncols==1 ? 5 : 9);
+ else
+ {
+        histout_init(&h,HISTCHAN,ncols,sizeof(unsigned int));
+        err = histout_write(fp,&h,counts);
+ }
+ if(fclose(fp)!=0 || err<0)
+        return -1;
+ return tt_now_us()-t;
+}
+
+
+//the contents of histbench.tmp, malloced
+char* slurp(long* size)
+{
+ FILE* fp;
+ char* buf = NULL;
+
+ if((fp = fopen("histbench.tmp","rb"))==NULL)
+        return NULL;
+ fseek(fp,0,SEEK_END);
+ *size = ftell(fp);
+ fseek(fp,0,SEEK_SET);
+ if((buf = (char*)malloc(*size+1))!=NULL && fread(buf,1,*size,fp)!=(size_t)*size)
+ {
+        free(buf);
+        buf = NULL;
+ }
+ fclose(fp);
+ return buf;
+}
+
+
+int zeros(const unsigned int* counts, int n)
+{
+ int i, z = 0;
+
+ for(i=0;i<n;i++)
+        z += counts[i]==0;
+ return z;
+}
+
+
+void report(const char* how, double us, int repeats, int n)
+{
+ printf("\n%-18s %9.2lf us per histogram  %6.2lf GB/s", how, us/repeats,
+        (double)n*sizeof(unsigned int)*repeats/us/1000.0);
+}
+
+
+int main(int argc, char* argv[])
+{
+ unsigned int* counts;
+ histsum_result r, ref, block[4];
+ histsum_window windows[4];
+ double t, Integralcount = 0;
+ long long Integral64;
+ int i, j, k, bad = 0;
+
+ printf("\nPicoHarp 300 Histogram Reduction Benchmark");
+ printf("\n~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+
+ if(argc>1)
+        Repeats = atoi(argv[1]);
+ if(Repeats<1 || (counts = (unsigned int*)malloc(4*HISTCHAN*sizeof(unsigned int)))==NULL)
+ {
+        printf("\nusage: histbench [repeats]\n");
+        return -1;
+ }
+ for(i=0;i<4;i++)
+ {
+        synth(counts+i*HISTCHAN,HISTCHAN,i+1);
+        windows[i].first = i*HISTCHAN;
+        windows[i].last = (i+1)*HISTCHAN-1;
+ }
+ printf("\n%d bins, %d repeats, histsum kernel %s\n",HISTCHAN,Repeats,histsum_kernel());
+
+ t = tt_now_us();
+ for(k=0;k<Repeats;k++)
+ {
+        Integralcount = 0;
+        for(i=0;i<HISTCHAN;i++)
+                Integralcount+=counts[i];
+        Sink += Integralcount;
+ }
+ report("dlldemo loop",tt_now_us()-t,Repeats,HISTCHAN);
+
+ t = tt_now_us();
+ for(k=0;k<Repeats;k++)
+ {
+        scalar(counts,HISTCHAN,&ref);
+        Sink += ref.centroid;
+ }
+ report("scalar all",tt_now_us()-t,Repeats,HISTCHAN);
+
+ t = tt_now_us();
+ for(k=0;k<Repeats;k++)
+ {
+        histsum(counts,HISTCHAN,NULL,0,&r);
+        Sink += r.centroid;
+ }
+ report("histsum",tt_now_us()-t,Repeats,HISTCHAN);
+ if(Integralcount!=(double)r.total || ref.total!=r.total || ref.peak!=r.peak || ref.peakbin!=r.peakbin
+        || fabs(ref.centroid-r.centroid)>1e-6 || ref.fwhm!=r.fwhm)
+        bad++;
+
+ printf("\n");
+ t = tt_now_us();
+ for(k=0;k<Repeats;k++)
+        for(i=0;i<4;i++)
+        {
+                Integral64 = 0;
+                for(j=0;j<HISTCHAN;j++)
+                        Integral64+=counts[i*HISTCHAN+j];
+                Sink += (double)Integral64;
+        }
+ report("routing loop",tt_now_us()-t,Repeats,4*HISTCHAN);
+
+ t = tt_now_us();
+ for(k=0;k<Repeats;k++)
+        for(i=0;i<4;i++)
+        {
+                histsum(counts+i*HISTCHAN,HISTCHAN,NULL,0,&block[i]);
+                Sink += (double)block[i].total;
+        }
+ report("histsum per block",tt_now_us()-t,Repeats,4*HISTCHAN);
+
+ t = tt_now_us();
+ for(k=0;k<Repeats;k++)
+ {
+        histsum(counts,4*HISTCHAN,windows,4,&r);
+        Sink += (double)r.window[3];
+ }
+ report("histsum windows",tt_now_us()-t,Repeats,4*HISTCHAN);
+ for(i=0;i<4;i++)
+ {
+        scalar(counts+i*HISTCHAN,HISTCHAN,&ref);
+        if(ref.total!=block[i].total || ref.total!=r.window[i] || ref.fwhm!=block[i].fwhm)
+                bad++;
+ }
+
+ printf("\n");
+ for(i=1;i<=4;i+=3)
+ {
+        long size0 = 0, size1 = 0;
+        char *text0, *text1;
+        double us[3];
+
+        for(j=0;j<3;j++)
+        {
+                us[j] = 1e30;
+                for(k=0;k<(Repeats+99)/100;k++) //files are slower, fewer repeats; the best one counts
+                {
+                        t = save(counts,i,j);
+                        if(t<0)
+                        {
+                                printf("\ncannot write histbench.tmp\n");
+                                return -1;
+                        }
+                        if(t<us[j])
+                                us[j] = t;
+                }
+                if(j==0)
+                        text0 = slurp(&size0);
+                if(j==1)
+                        text1 = slurp(&size1);
+        }
+        printf("\nsaving %dx%d bins: fprintf %9.0lf us, histout_text %7.0lf us, binary %6.0lf us",
+                i,HISTCHAN,us[0],us[1],us[2]);
+        if(text0==NULL || text1==NULL || size0!=size1 || memcmp(text0,text1,size0)!=0)
+                bad++;
+        free(text0);
+        free(text1);
+ }
+ remove("histbench.tmp");
+
+ printf("\n");
+ {
+        unsigned int* back;
+        unsigned char* code;
+        size_t size = 0;
+
+        back = (unsigned int*)malloc(HISTCHAN*sizeof(unsigned int));
+        code = (unsigned char*)malloc(histrle_bound(HISTCHAN));
+        if(back==NULL || code==NULL)
+        {
+                printf("\nout of memory\n");
+                return -1;
+        }
+        sparse(counts,HISTCHAN,7);
+        t = tt_now_us();
+        for(k=0;k<Repeats;k++)
+                size = histrle_encode(counts,HISTCHAN,code);
+        report("histrle_encode",tt_now_us()-t,Repeats,HISTCHAN);
+        t = tt_now_us();
+        for(k=0;k<Repeats;k++)
+                if(histrle_decode(code,size,back,HISTCHAN)!=HISTCHAN)
+                        bad++;
+        report("histrle_decode",tt_now_us()-t,Repeats,HISTCHAN);
+        printf("\n%d bins, %d of them zero: %lu bytes coded, %1.1lf%% of the raw counts",
+                HISTCHAN,zeros(counts,HISTCHAN),(unsigned long)size,100.0*size/(HISTCHAN*sizeof(unsigned int)));
+        if(memcmp(counts,back,HISTCHAN*sizeof(unsigned int))!=0)
+                bad++;
+        free(back);
+        free(code);
+ }
+
+ printf("\n\n%s\n", bad ? "RESULTS DIFFER" : "results agree");
+ free(counts);
+ return bad ? -1 : 0;
+}
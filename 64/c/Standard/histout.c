@@ -0,0 +1,242 @@
+/************************************************************************
+
+  Histogram output
+
+  See histout.h. The integer formatting takes two digits at a time from
+  a table, so a count needs a division by 100 per digit pair and no
+  parsing of a format string; counts below 2^32 use 32 bit divisions.
+
+************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "histout.h"
+#include "histrle.h"
+
+#define TEXTBUF 32768 //bytes formatted per fwrite
+
+static const char Digits[201] =
+        "00010203040506070809"
+        "10111213141516171819"
+        "20212223242526272829"
+        "30313233343536373839"
+        "40414243444546474849"
+        "50515253545556575859"
+        "60616263646566676869"
+        "70717273747576777879"
+        "80818283848586878889"
+        "90919293949596979899";
+
+
+void histout_init(histout_header* h, int nbins, int ncurves, int countbytes)
+{
+ memset(h, 0, sizeof(histout_header));
+ h->magic = HISTOUT_MAGIC;
+ h->version = HISTOUT_VERSION;
+ h->nbins = nbins;
+ h->ncurves = ncurves;
+ h->countbytes = countbytes;
+}
+
+
+long long histout_countbytes(const histout_header* h)
+{
+ if(h->sparsebytes)
+        return h->sparsebytes;
+ return (long long)h->nbins * h->ncurves * h->countbytes;
+}
+
+
+
+
+int histout_write(FILE* fp, const histout_header* h, const void* counts)
+{
+ size_t size = (size_t)histout_countbytes(h);
+
+ if(fwrite(h, sizeof(histout_header), 1, fp)!=1)
+        return -1;
+ if(fwrite(counts, 1, size, fp)!=size)
+        return -1;
+ return 0;
+}
+
+
+int histout_writesparse(FILE* fp, histout_header* h, const unsigned int* counts, void* code)
+{
+ int ret;
+
+ h->sparsebytes = (unsigned int)histrle_encode(counts, h->nbins*h->ncurves, code);
+ ret = histout_write(fp, h, code);
+ h->sparsebytes = 0;
+ return ret;
+}
+
+
+int histout_save(const char* path, histout_header* h, const void* counts, void* code)
+{
+ FILE* fp;
+ int ret;
+
+ if((fp = fopen(path, "wb"))==NULL)
+        return -1;
+ ret = code ? histout_writesparse(fp, h, (const unsigned int*)counts, code) : histout_write(fp, h, counts);
+ if(fclose(fp)!=0)
+        ret = -1;
+ return ret;
+}
+
+
+int histout_read(FILE* fp, histout_header* h, void* counts, long long maxbytes)
+{
+ long long size;
+ void* code;
+ int n;
+
+ if(fread(h, sizeof(histout_header), 1, fp)!=1)
+        return feof(fp) ? 0 : -1;
+ if(h->magic!=HISTOUT_MAGIC || h->version!=HISTOUT_VERSION || h->nbins<0 || h->ncurves<0
+        || (h->countbytes!=4 && h->countbytes!=8) || (h->sparsebytes && h->countbytes!=4))
+        return -1;
+ if(h->sparsebytes==0)
+ {
+        size = histout_countbytes(h);
+        if(size>maxbytes)
+                return -1;
+        if(fread(counts, 1, (size_t)size, fp)!=(size_t)size)
+                return -1;
+        return 1;
+ }
+ if((code = malloc(h->sparsebytes))==NULL)
+        return -1;
+ n = -1;
+ if(fread(code, 1, h->sparsebytes, fp)==h->sparsebytes)
+        n = histrle_decode(code, h->sparsebytes, (unsigned int*)counts, (int)(maxbytes/sizeof(unsigned int)));
+ free(code);
+ if(n<0 || n!=h->nbins*h->ncurves)
+        return -1;
+ h->sparsebytes = 0;
+ return 1;
+}
+
+
+static int digits32(unsigned int v)
+{
+ return v<10 ? 1 : v<100 ? 2 : v<1000 ? 3 : v<10000 ? 4 : v<100000 ? 5 : v<1000000 ? 6
+        : v<10000000 ? 7 : v<100000000 ? 8 : v<1000000000 ? 9 : 10;
+}
+
+
+//writes v right aligned to width (wider if it has more digits) at p,
+//returns the end; the digits go straight to their place from the right
+static char* put32(char* p, unsigned int v, int width)
+{
+ int len = digits32(v);
+ char* e = p + (width>len ? width : len);
+ char* t = e;
+
+ while(v>=100)
+ {
+        t -= 2;
+        memcpy(t, Digits+2*(v%100), 2);
+        v /= 100;
+ }
+ if(v>=10)
+ {
+        t -= 2;
+        memcpy(t, Digits+2*v, 2);
+ }
+ else
+        *--t = (char)('0'+v);
+ while(p<t)
+        *p++ = ' ';
+ return e;
+}
+
+
+static char* put64(char* p, unsigned long long v, int width)
+{
+ char low[20];
+ char* t = low+20;
+ int len;
+
+ if(v<=0xFFFFFFFFu)
+        return put32(p, (unsigned int)v, width);
+ while(v>0xFFFFFFFFu) //the low digits, then the rest in 32 bit
+ {
+        t -= 2;
+        memcpy(t, Digits+2*(v%100), 2);
+        v /= 100;
+ }
+ len = (int)(low+20-t);
+ p = put32(p, (unsigned int)v, width-len);
+ memcpy(p, t, len);
+ return p+len;
+}
+
+
+//most of a line: the newline, ncols fields of at most 20 digits and separators
+static int linemax(int ncols, int width)
+{
+ return 1 + ncols*((width>20 ? width : 20)+1);
+}
+
+
+int histout_text(FILE* fp, const unsigned int* counts, int ncols, int stride, int n, int width)
+{
+ char buf[TEXTBUF];
+ char* p = buf;
+ int i, c, max = linemax(ncols, width);
+
+ if(max>TEXTBUF)
+        return -1;
+ for(i=0;i<n;i++)
+ {
+        if(p+max > buf+TEXTBUF)
+        {
+                if(fwrite(buf, 1, p-buf, fp)!=(size_t)(p-buf))
+                        return -1;
+                p = buf;
+        }
+        *p++ = '\n';
+        for(c=0;c<ncols;c++)
+        {
+                if(c>0)
+                        *p++ = ' ';
+                p = put32(p, counts[c*stride+i], width);
+        }
+ }
+ if(fwrite(buf, 1, p-buf, fp)!=(size_t)(p-buf))
+        return -1;
+ return 0;
+}
+
+
+int histout_text64(FILE* fp, const unsigned long long* counts, int ncols, int stride, int n, int width)
+{
+ char buf[TEXTBUF];
+ char* p = buf;
+ int i, c, max = linemax(ncols, width);
+
+ if(max>TEXTBUF)
+        return -1;
+ for(i=0;i<n;i++)
+ {
+        if(p+max > buf+TEXTBUF)
+        {
+                if(fwrite(buf, 1, p-buf, fp)!=(size_t)(p-buf))
+                        return -1;
+                p = buf;
+        }
+        *p++ = '\n';
+        for(c=0;c<ncols;c++)
+        {
+                if(c>0)
+                        *p++ = ' ';
+                p = put64(p, counts[c*stride+i], width);
+        }
+ }
+ if(fwrite(buf, 1, p-buf, fp)!=(size_t)(p-buf))
+        return -1;
+ return 0;
+}
@@ -0,0 +1,69 @@
+/************************************************************************
+
+  Histogram output
+
+  Binary: each histogram is a histout_header followed by its counts,
+  ncurves curves of nbins each (the 4 routing channels one after the
+  other), as 32 bit counts or, for accumulated sums, 64 bit ones. A
+  file is any number of such records, e.g. one per measurement cycle.
+  All values are in the byte order of the PC, i.e. little endian.
+  Instead of 32 bit counts a record may hold them run-length coded as
+  in histrle.h, which histout_read decodes.
+
+  Text: the counts as a table, one bin per line, formatted by hand into
+  a buffer which is written with one fwrite per 32 kB instead of an
+  fprintf per line. The layout is that of "\n%5d" and "\n%9d %9d ..."
+  the demos used before.
+
+************************************************************************/
+
+#ifndef HISTOUT_H
+#define HISTOUT_H
+
+#include <stdio.h>
+
+#define HISTOUT_MAGIC   0x54534948   //"HIST"
+#define HISTOUT_VERSION 1
+
+typedef struct
+{
+ unsigned int magic;                 //HISTOUT_MAGIC
+ unsigned int version;               //HISTOUT_VERSION
+ int nbins;                          //per curve
+ int ncurves;                        //1, or 4 for the routing channels
+ int countbytes;                     //4, or 8 for accumulated sums
+ int binning;                        //as PH_SetBinning
+ int offset;                         //ns, as PH_SetOffset
+ int syncdivider;
+ double resolution;                  //ps per bin, PH_GetResolution
+ double elapsed_ms;                  //PH_GetElapsedMeasTime, or the live time of a sum
+ long long cycle;                    //number of the histogram in a series, from 0
+ int flags;                          //PH_GetFlags
+ unsigned int sparsebytes;            //of histrle code instead of the counts, 0 if not coded
+} histout_header;                    //64 bytes
+
+//clears h and sets magic, version and the sizes
+void histout_init(histout_header* h, int nbins, int ncurves, int countbytes);
+//bytes of counts (or code) following the header
+long long histout_countbytes(const histout_header* h);
+
+//writes h and its counts, returns 0 or -1
+int histout_write(FILE* fp, const histout_header* h, const void* counts);
+//the same for 32 bit counts, run-length coded in code (room for histrle_bound
+//of all bins of h) on the way; returns 0 or -1
+int histout_writesparse(FILE* fp, histout_header* h, const unsigned int* counts, void* code);
+//writes a file holding just this record, coded with histout_writesparse if
+//code is not NULL; returns 0 or -1
+int histout_save(const char* path, histout_header* h, const void* counts, void* code);
+//reads the next record into h and counts (room for maxbytes), decoded if it
+//is coded (then h->sparsebytes is cleared); returns 1, 0 at the end of the
+//file, or -1 if the file is not one of these or too big
+int histout_read(FILE* fp, histout_header* h, void* counts, long long maxbytes);
+
+//n lines of ncols counts each right aligned to width, separated by a space
+//and each line starting with a newline; column c is counts+c*stride.
+//Returns 0 or -1
+int histout_text(FILE* fp, const unsigned int* counts, int ncols, int stride, int n, int width);
+int histout_text64(FILE* fp, const unsigned long long* counts, int ncols, int stride, int n, int width);
+
+#endif
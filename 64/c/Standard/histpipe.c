@@ -0,0 +1,129 @@
+/************************************************************************
+
+  Pipeline for back-to-back histogram measurements
+
+  See histpipe.h. Head and tail are free-running counters; the slot is
+  the counter masked by nslots-1.
+
+************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "histpipe.h"
+
+
+static TT_THREADFUNC(processor)
+{
+ histpipe* p = (histpipe*)arg;
+ unsigned int tail;
+ double t;
+
+ for(;;)
+ {
+        tail = p->tail;
+        if(tt_load_acquire(&p->head) == tail)
+        {
+                //closed is read before head is read again, so the last slot is not missed
+                if(tt_load_acquire(&p->closed) && tt_load_acquire(&p->head) == tail)
+                        break;
+                tt_wakeup_wait(&p->committed, 100);
+                continue;
+        }
+        t = tt_now_us();
+        p->process(&p->slots[tail & (p->nslots-1)], p->arg);
+        p->processtime_us += tt_now_us() - t;
+        p->processed++;
+        tt_store_release(&p->tail, tail+1);
+        tt_wakeup_set(&p->released);
+ }
+ TT_THREADRETURN;
+}
+
+
+int histpipe_init(histpipe* p, int nslots, int nbins, histpipe_func process, void* arg)
+{
+ unsigned int n = 1, i;
+
+ memset(p, 0, sizeof(histpipe));
+ if(nslots<1 || nbins<1 || process==NULL)
+        return -1;
+ while(n<(unsigned)nslots)
+        n <<= 1;
+ p->nslots = n;
+ p->nbins = nbins;
+ p->process = process;
+ p->arg = arg;
+ if((p->slots = (histpipe_slot*)calloc(n, sizeof(histpipe_slot)))==NULL)
+        return -1;
+ for(i=0;i<n;i++)
+        if((p->slots[i].counts = (unsigned int*)calloc(nbins, sizeof(unsigned int)))==NULL)
+                goto fail;
+ if(tt_wakeup_init(&p->committed)<0)
+        goto fail;
+ if(tt_wakeup_init(&p->released)<0)
+ {
+        tt_wakeup_destroy(&p->committed);
+        goto fail;
+ }
+ if(tt_thread_create(&p->thread, processor, p)<0)
+ {
+        tt_wakeup_destroy(&p->committed);
+        tt_wakeup_destroy(&p->released);
+        goto fail;
+ }
+ p->running = 1;
+ return 0;
+
+fail:
+ for(i=0;i<n;i++)
+        free(p->slots[i].counts);
+ free(p->slots);
+ p->slots = NULL;
+ return -1;
+}
+
+
+histpipe_slot* histpipe_acquire(histpipe* p)
+{
+ unsigned int head = p->head;
+ double t0;
+
+ if(head - tt_load_acquire(&p->tail) == p->nslots)
+ {
+        p->stalls++;
+        t0 = tt_now_us();
+        while(head - tt_load_acquire(&p->tail) == p->nslots)
+                tt_wakeup_wait(&p->released, 100);
+        p->stalltime_us += tt_now_us() - t0;
+ }
+ return &p->slots[head & (p->nslots-1)];
+}
+
+
+void histpipe_commit(histpipe* p)
+{
+ tt_store_release(&p->head, p->head+1);
+ tt_wakeup_set(&p->committed);
+}
+
+
+void histpipe_close(histpipe* p)
+{
+ unsigned int i;
+
+ if(p->running)
+ {
+        tt_store_release(&p->closed, 1);
+        tt_wakeup_set(&p->committed);
+        tt_thread_join(p->thread);
+        tt_wakeup_destroy(&p->committed);
+        tt_wakeup_destroy(&p->released);
+        p->running = 0;
+ }
+ if(p->slots)
+        for(i=0;i<p->nslots;i++)
+                free(p->slots[i].counts);
+ free(p->slots);
+ p->slots = NULL;
+}
@@ -0,0 +1,69 @@
+/************************************************************************
+
+  Pipeline for back-to-back histogram measurements
+
+  Reading out a histogram, adding it up and saving it takes time in
+  which the device could already be measuring the next one. The loop
+  talking to the device therefore only fetches each histogram into a
+  free slot of a small ring and restarts the measurement; a processing
+  thread takes the slots in order, calls the given function on each and
+  gives the slot back. The device waits for the host only when all
+  slots are still being processed.
+
+  One thread acquires and commits slots, the processing thread is the
+  only one to release them, so head and tail need no lock.
+
+************************************************************************/
+
+#ifndef HISTPIPE_H
+#define HISTPIPE_H
+
+#include "ttport.h"
+
+typedef struct
+{
+ unsigned int* counts;               //nbins
+ long long cycle;                    //number of the measurement, from 0
+ int flags;                          //PH_GetFlags after the measurement
+ double elapsed_ms;                  //PH_GetElapsedMeasTime
+ double started_us;                  //tt_now_us at PH_StartMeas
+} histpipe_slot;
+
+typedef void (*histpipe_func)(histpipe_slot* slot, void* arg);
+
+typedef struct
+{
+ histpipe_slot* slots;
+ unsigned int nslots;                //power of two
+ int nbins;
+ histpipe_func process;
+ void* arg;
+
+ volatile unsigned int head;         //acquiring thread
+ char pad0[TT_CACHELINE-sizeof(unsigned int)];
+ volatile unsigned int tail;         //processing thread
+ char pad1[TT_CACHELINE-sizeof(unsigned int)];
+ volatile unsigned int closed;
+ tt_wakeup committed;                //a slot was committed, or closed was set
+ tt_wakeup released;                 //a processed slot is free again
+ tt_thread thread;
+ int running;
+
+ //statistics
+ unsigned int stalls;                //the acquiring thread found all slots busy
+ double stalltime_us;
+ double processtime_us;              //spent in process, on the processing thread
+ long long processed;
+} histpipe;
+
+//nslots (rounded up to a power of two) histograms of nbins; starts the
+//processing thread, which calls process(slot,arg) for each; returns 0 or -1
+int  histpipe_init(histpipe* p, int nslots, int nbins, histpipe_func process, void* arg);
+//the next free slot, waits while all are being processed
+histpipe_slot* histpipe_acquire(histpipe* p);
+//hands the slot from histpipe_acquire to the processing thread
+void histpipe_commit(histpipe* p);
+//waits until all committed slots are processed, stops the thread and frees the slots
+void histpipe_close(histpipe* p);
+
+#endif
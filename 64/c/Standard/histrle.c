@@ -0,0 +1,277 @@
+/************************************************************************
+
+  Sparse histograms
+
+  See histrle.h. The encoder alternates between looking for the next
+  nonzero bin and the next zero bin; both compare vectors of counts
+  with zero and take the first set bit of the mask, so long runs cost
+  one test per 32 (AVX2) or 16 (SSE2) bins; the AVX2 loops are chosen
+  at run time, see histcpu.h. The counts are first tried as 16 bit;
+  only if one does not fit is the code redone with 32 bit.
+
+************************************************************************/
+
+#include <string.h>
+
+#include "histcpu.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "histrle.h"
+
+#define RUNBYTES (2*sizeof(unsigned int)) //zeros and n of a run
+
+
+#if defined(HIST_HAVE_AVX2) || defined(HIST_HAVE_SSE2)
+//the lowest set bit of m, which is not 0
+static int lowbit(unsigned int m)
+{
+#ifdef _MSC_VER
+ unsigned long i;
+
+ _BitScanForward(&i, m);
+ return (int)i;
+#else
+ return __builtin_ctz(m);
+#endif
+}
+#endif
+
+
+//the vector searches below stop at the bin they look for, or where too few
+//bins are left for a vector; zeros gives a mask with a bit for each zero bin
+
+#ifdef HIST_HAVE_AVX2
+#define load8(p)      _mm256_loadu_si256((const __m256i*)(p))
+#define zeros8(a)     (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(a, _mm256_setzero_si256())))
+
+HIST_AVX2 static int findzero_avx2(const unsigned int* c, int i, int n)
+{
+ unsigned int m;
+
+ for(;i+32<=n;i+=32) //4 vectors at a time until one has a zero
+        if(zeros8(load8(c+i)) | zeros8(load8(c+i+8)) | zeros8(load8(c+i+16)) | zeros8(load8(c+i+24)))
+                break;
+ for(;i+8<=n;i+=8)
+        if((m = zeros8(load8(c+i)))!=0)
+                return i + lowbit(m);
+ return i;
+}
+
+HIST_AVX2 static int findnonzero_avx2(const unsigned int* c, int i, int n)
+{
+ unsigned int m;
+
+ for(;i+32<=n;i+=32) //4 vectors ORed at a time until one is not all zero
+        if(zeros8(_mm256_or_si256(_mm256_or_si256(load8(c+i), load8(c+i+8)),
+                                  _mm256_or_si256(load8(c+i+16), load8(c+i+24))))!=0xFF)
+                break;
+ for(;i+8<=n;i+=8)
+        if((m = 0xFF ^ zeros8(load8(c+i)))!=0)
+                return i + lowbit(m);
+ return i;
+}
+#endif
+
+
+#ifdef HIST_HAVE_SSE2
+#define load4(p)      _mm_loadu_si128((const __m128i*)(p))
+#define zeros4(a)     (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(a, _mm_setzero_si128())))
+#endif
+
+static int findzero_sse2(const unsigned int* c, int i, int n)
+{
+#ifdef HIST_HAVE_SSE2
+ unsigned int m;
+
+ for(;i+16<=n;i+=16)
+        if(zeros4(load4(c+i)) | zeros4(load4(c+i+4)) | zeros4(load4(c+i+8)) | zeros4(load4(c+i+12)))
+                break;
+ for(;i+4<=n;i+=4)
+        if((m = zeros4(load4(c+i)))!=0)
+                return i + lowbit(m);
+#endif
+ return i;
+}
+
+static int findnonzero_sse2(const unsigned int* c, int i, int n)
+{
+#ifdef HIST_HAVE_SSE2
+ unsigned int m;
+
+ for(;i+16<=n;i+=16)
+        if(zeros4(_mm_or_si128(_mm_or_si128(load4(c+i), load4(c+i+4)),
+                               _mm_or_si128(load4(c+i+8), load4(c+i+12))))!=0xF)
+                break;
+ for(;i+4<=n;i+=4)
+        if((m = 0xF ^ zeros4(load4(c+i)))!=0)
+                return i + lowbit(m);
+#endif
+ return i;
+}
+
+
+//the first zero bin from i on, n if none
+static int findzero(const unsigned int* c, int i, int n)
+{
+#ifdef HIST_HAVE_AVX2
+ if(histcpu_avx2())
+        i = findzero_avx2(c, i, n);
+ else
+#endif
+        i = findzero_sse2(c, i, n);
+ for(;i<n;i++)
+        if(c[i]==0)
+                return i;
+ return n;
+}
+
+
+//the first nonzero bin from i on, n if none
+static int findnonzero(const unsigned int* c, int i, int n)
+{
+#ifdef HIST_HAVE_AVX2
+ if(histcpu_avx2())
+        i = findnonzero_avx2(c, i, n);
+ else
+#endif
+        i = findnonzero_sse2(c, i, n);
+ for(;i<n;i++)
+        if(c[i]!=0)
+                return i;
+ return n;
+}
+
+
+//stores n counts as 16 bit at p, returns all counts ORed together, which
+//tells whether they fit
+static unsigned int narrow(unsigned short* p, const unsigned int* c, int n)
+{
+ unsigned int all = 0;
+ int i = 0;
+#ifdef HIST_HAVE_SSE2
+ //packs saturates to signed 16 bit, so the counts are moved down by 0x8000 and back up after
+ const __m128i bias = _mm_set1_epi32(0x8000), flip = _mm_set1_epi16((short)0x8000);
+ __m128i x, y, o = _mm_setzero_si128();
+ unsigned int m[4];
+
+ for(;i+8<=n;i+=8)
+ {
+        x = _mm_loadu_si128((const __m128i*)(c+i));
+        y = _mm_loadu_si128((const __m128i*)(c+i+4));
+        o = _mm_or_si128(o, _mm_or_si128(x, y));
+        _mm_storeu_si128((__m128i*)(p+i), _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(x, bias), _mm_sub_epi32(y, bias)), flip));
+ }
+ _mm_storeu_si128((__m128i*)m, o);
+ all = m[0] | m[1] | m[2] | m[3];
+#endif
+ for(;i<n;i++)
+ {
+        all |= c[i];
+        p[i] = (unsigned short)c[i];
+ }
+ return all;
+}
+
+
+size_t histrle_bound(int nbins)
+{
+ //at worst a run for every other bin, each with one 32 bit count
+ return sizeof(histrle_header) + (size_t)(nbins/2+1)*RUNBYTES + (size_t)nbins*sizeof(unsigned int);
+}
+
+
+//the code with counts of width bytes, or 0 if a count does not fit
+static size_t encode(const unsigned int* counts, int nbins, void* out, unsigned int width)
+{
+ histrle_header* h = (histrle_header*)out;
+ unsigned char* p = (unsigned char*)out + sizeof(histrle_header);
+ unsigned int run[2];
+ int i, j, k, e, start;
+ //a zero run is cut out when a new run costs less than keeping its zeros
+ int minzeros = (int)(RUNBYTES/width) + 1;
+
+ h->magic = HISTRLE_MAGIC;
+ h->nbins = nbins;
+ h->width = width;
+ //zeros from i, counts from start to j, the next nonzero bin at e; zeros
+ //after the last run need no run of their own
+ for(i=0,start=findnonzero(counts, 0, nbins);start<nbins;i=j,start=e)
+ {
+        //extend the counts until a zero run long enough, or the end
+        for(j=start;;j=e)
+        {
+                k = findzero(counts, j, nbins);
+                e = k<nbins ? findnonzero(counts, k, nbins) : nbins;
+                if(e==nbins || e-k>=minzeros)
+                {
+                        j = k;
+                        break;
+                }
+        }
+        run[0] = start-i;
+        run[1] = j-start;
+        memcpy(p, run, RUNBYTES);
+        p += RUNBYTES;
+        if(width==4)
+                memcpy(p, counts+start, (j-start)*sizeof(unsigned int));
+        else if(narrow((unsigned short*)p, counts+start, j-start)>0xFFFF) //at an even offset, aligned for 16 bit
+                return 0;
+        p += (j-start)*width;
+ }
+ h->size = (unsigned int)(p - ((unsigned char*)out + sizeof(histrle_header)));
+ return p - (unsigned char*)out;
+}
+
+
+size_t histrle_encode(const unsigned int* counts, int nbins, void* out)
+{
+ size_t size = encode(counts, nbins, out, 2);
+
+ if(size==0) //rarely, a sum of several measurements
+        size = encode(counts, nbins, out, 4);
+ return size;
+}
+
+
+int histrle_decode(const void* in, size_t size, unsigned int* counts, int maxbins)
+{
+ histrle_header h;
+ const unsigned char* p = (const unsigned char*)in + sizeof(histrle_header);
+ const unsigned char* end;
+ const unsigned short* p16;
+ unsigned int run[2];
+ unsigned int pos = 0, k;
+
+ if(size<sizeof(histrle_header))
+        return -1;
+ memcpy(&h, in, sizeof(histrle_header));
+ if(h.magic!=HISTRLE_MAGIC || (h.width!=2 && h.width!=4) || h.nbins>(unsigned int)maxbins
+        || h.size>size-sizeof(histrle_header))
+        return -1;
+ end = p + h.size;
+ while(p<end)
+ {
+        if((size_t)(end-p)<RUNBYTES)
+                return -1;
+        memcpy(run, p, RUNBYTES);
+        p += RUNBYTES;
+        if(run[0]>h.nbins-pos || run[1]>h.nbins-pos-run[0] || (size_t)(end-p)<(size_t)run[1]*h.width)
+                return -1;
+        memset(counts+pos, 0, run[0]*sizeof(unsigned int));
+        pos += run[0];
+        if(h.width==4)
+                memcpy(counts+pos, p, run[1]*sizeof(unsigned int));
+        else
+        {
+                p16 = (const unsigned short*)p;
+                for(k=0;k<run[1];k++)
+                        counts[pos+k] = p16[k];
+        }
+        pos += run[1];
+        p += (size_t)run[1]*h.width;
+ }
+ memset(counts+pos, 0, (h.nbins-pos)*sizeof(unsigned int));
+ return (int)h.nbins;
+}
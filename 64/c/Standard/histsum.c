@@ -0,0 +1,270 @@
+/************************************************************************
+
+  Histogram reductions
+
+  See histsum.h. The bins are cut at the window edges into segments;
+  each segment is reduced once and its sum is added to every window
+  that covers it. The vector loops only add and take maxima, see
+  segment() for how the centroid and the peak bin come out of that.
+  The AVX2 loop is chosen at run time, see histcpu.h.
+
+************************************************************************/
+
+#include <string.h>
+
+#include "histcpu.h"
+#include "histsum.h"
+
+#define CHUNK 256 //bins, a multiple of 8; the peak bin is looked up again within one chunk
+
+typedef struct
+{
+ unsigned long long sum, wsum;       //counts, bin times counts
+ unsigned int max;
+ int maxbin;
+} part;
+
+
+#if defined(HIST_HAVE_AVX2) || defined(HIST_HAVE_SSE2)
+//the bins with 64 bit sums a[] of nlanes lanes and b[] of the running sums
+//after n vector steps; a count added in step k is in b n-k times, so the
+//bin times count sum of a lane is (first bin of the lane)*a + step*(n*a-b)
+static void lanes(part* p, const unsigned long long* a, const unsigned long long* b, int nlanes,
+        int first, int step, long long n)
+{
+ int l;
+
+ for(l=0;l<nlanes;l++)
+ {
+        p->sum += a[l];
+        p->wsum += (unsigned long long)(first+l)*a[l] + (unsigned long long)step*(n*a[l]-b[l]);
+ }
+}
+#endif
+
+#if defined(HIST_HAVE_SSE2)
+//SSE2 has no unsigned 32 bit max; flipping the sign bit lets the signed compare order them
+static __m128i max_epu32(__m128i x, __m128i y)
+{
+ const __m128i sign = _mm_set1_epi32((int)0x80000000u);
+ __m128i gt = _mm_cmpgt_epi32(_mm_xor_si128(x, sign), _mm_xor_si128(y, sign));
+
+ return _mm_or_si128(_mm_and_si128(gt, x), _mm_andnot_si128(gt, y));
+}
+#endif
+
+
+#ifdef HIST_HAVE_AVX2
+//the vector part of segment(), 8 bins a step; returns where it ended
+HIST_AVX2 static int vector_avx2(const unsigned int* c, int first, int last, part* p, int* peakchunk, int* peakend)
+{
+ int i, j, end, vend = first + ((last-first) & ~7);
+ unsigned int m;
+ unsigned long long a[8], b[8];
+ __m256i v, lo, hi, vmax;
+ __m256i alo = _mm256_setzero_si256(), ahi = alo, blo = alo, bhi = alo;
+ __m128i m4;
+
+ for(i=first;i<vend;i=end)
+ {
+        end = vend-i > CHUNK ? i+CHUNK : vend;
+        vmax = _mm256_setzero_si256();
+        for(j=i;j<end;j+=8)
+        {
+                v = _mm256_loadu_si256((const __m256i*)(c+j));
+                lo = _mm256_cvtepu32_epi64(_mm256_castsi256_si128(v));
+                hi = _mm256_cvtepu32_epi64(_mm256_extracti128_si256(v, 1));
+                alo = _mm256_add_epi64(alo, lo);
+                ahi = _mm256_add_epi64(ahi, hi);
+                blo = _mm256_add_epi64(blo, alo);
+                bhi = _mm256_add_epi64(bhi, ahi);
+                vmax = _mm256_max_epu32(vmax, v);
+        }
+        m4 = _mm_max_epu32(_mm256_castsi256_si128(vmax), _mm256_extracti128_si256(vmax, 1));
+        m4 = _mm_max_epu32(m4, _mm_shuffle_epi32(m4, _MM_SHUFFLE(1,0,3,2)));
+        m4 = _mm_max_epu32(m4, _mm_shuffle_epi32(m4, _MM_SHUFFLE(2,3,0,1)));
+        m = (unsigned int)_mm_cvtsi128_si32(m4);
+        if(m > p->max || i==first)
+        {
+                p->max = m;
+                *peakchunk = i;
+                *peakend = end;
+        }
+ }
+ _mm256_storeu_si256((__m256i*)a, alo);
+ _mm256_storeu_si256((__m256i*)(a+4), ahi);
+ _mm256_storeu_si256((__m256i*)b, blo);
+ _mm256_storeu_si256((__m256i*)(b+4), bhi);
+ lanes(p, a, b, 8, first, 8, (vend-first)/8);
+ return vend;
+}
+#endif
+
+
+//the same with SSE2, 4 bins a step, or none
+static int vector_sse2(const unsigned int* c, int first, int last, part* p, int* peakchunk, int* peakend)
+{
+#if defined(HIST_HAVE_SSE2)
+ int i, j, end, vend = first + ((last-first) & ~3);
+ unsigned int m;
+ unsigned long long a[4], b[4];
+ __m128i v, lo, hi, vmax;
+ __m128i zero = _mm_setzero_si128(), alo = zero, ahi = zero, blo = zero, bhi = zero;
+
+ for(i=first;i<vend;i=end)
+ {
+        end = vend-i > CHUNK ? i+CHUNK : vend;
+        vmax = zero;
+        for(j=i;j<end;j+=4)
+        {
+                v = _mm_loadu_si128((const __m128i*)(c+j));
+                lo = _mm_unpacklo_epi32(v, zero);
+                hi = _mm_unpackhi_epi32(v, zero);
+                alo = _mm_add_epi64(alo, lo);
+                ahi = _mm_add_epi64(ahi, hi);
+                blo = _mm_add_epi64(blo, alo);
+                bhi = _mm_add_epi64(bhi, ahi);
+                vmax = max_epu32(vmax, v);
+        }
+        vmax = max_epu32(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(1,0,3,2)));
+        vmax = max_epu32(vmax, _mm_shuffle_epi32(vmax, _MM_SHUFFLE(2,3,0,1)));
+        m = (unsigned int)_mm_cvtsi128_si32(vmax);
+        if(m > p->max || i==first)
+        {
+                p->max = m;
+                *peakchunk = i;
+                *peakend = end;
+        }
+ }
+ _mm_storeu_si128((__m128i*)a, alo);
+ _mm_storeu_si128((__m128i*)(a+2), ahi);
+ _mm_storeu_si128((__m128i*)b, blo);
+ _mm_storeu_si128((__m128i*)(b+2), bhi);
+ //lo holds bins 0 and 1 of each step, hi bins 2 and 3
+ lanes(p, a, b, 4, first, 4, (vend-first)/4);
+ return vend;
+#else
+ return first;
+#endif
+}
+
+
+//bins first to last-1; the vector loop keeps the counts and the running sums
+//of the counts in 64 bit lanes and the largest count of each chunk, the chunk
+//with the first occurrence of the peak is searched for its bin afterwards
+static void segment(const unsigned int* c, int first, int last, part* p)
+{
+ int i, j, vend, peakchunk = first, peakend = first;
+
+ memset(p, 0, sizeof(part));
+ p->maxbin = first;
+#ifdef HIST_HAVE_AVX2
+ if(histcpu_avx2())
+        vend = vector_avx2(c, first, last, p, &peakchunk, &peakend);
+ else
+#endif
+        vend = vector_sse2(c, first, last, p, &peakchunk, &peakend);
+ for(j=peakchunk;j<peakend;j++) //still in the cache
+        if(c[j]==p->max)
+        {
+                p->maxbin = j;
+                break;
+        }
+ for(i=vend;i<last;i++) //the rest, all of it without SIMD
+ {
+        p->sum += c[i];
+        p->wsum += (unsigned long long)i * c[i];
+        if(c[i] > p->max)
+        {
+                p->max = c[i];
+                p->maxbin = i;
+        }
+ }
+}
+
+
+//the width of the peak at half its height, interpolated between the bins
+static double fwhm(const unsigned int* c, int n, int peakbin)
+{
+ double half = c[peakbin]/2.0;
+ double left, right;
+ int i;
+
+ if(c[peakbin]==0)
+        return 0;
+ for(i=peakbin;i>0 && c[i-1]>=half;i--)
+        ;
+ left = i>0 ? i-1 + (half-c[i-1])/((double)c[i]-c[i-1]) : i;
+ for(i=peakbin;i<n-1 && c[i+1]>=half;i++)
+        ;
+ right = i<n-1 ? i + (c[i]-half)/((double)c[i]-c[i+1]) : i;
+ return right-left;
+}
+
+
+int histsum(const unsigned int* counts, int n, const histsum_window* windows, int nwindows, histsum_result* r)
+{
+ int edges[2*HISTSUM_MAXWINDOWS+2];
+ int nedges = 0, i, j, k, e;
+ unsigned long long wsum = 0;
+ part p;
+
+ memset(r, 0, sizeof(histsum_result));
+ if(nwindows<0 || nwindows>HISTSUM_MAXWINDOWS)
+        return -1;
+
+ //the segment edges, sorted and each once
+ edges[nedges++] = 0;
+ edges[nedges++] = n;
+ for(k=0;k<nwindows;k++)
+        for(j=0;j<2;j++)
+        {
+                e = j==0 ? windows[k].first : windows[k].last+1;
+                if(e>0 && e<n)
+                        edges[nedges++] = e;
+        }
+ for(i=1;i<nedges;i++)
+        for(j=i;j>0 && edges[j-1]>edges[j];j--)
+        {
+                e = edges[j];
+                edges[j] = edges[j-1];
+                edges[j-1] = e;
+        }
+
+ for(i=0;i+1<nedges;i++)
+ {
+        if(edges[i]==edges[i+1])
+                continue;
+        segment(counts, edges[i], edges[i+1], &p);
+        r->total += p.sum;
+        wsum += p.wsum;
+        if(p.max > r->peak) //strictly, so the first bin wins a tie; all zero leaves bin 0
+        {
+                r->peak = p.max;
+                r->peakbin = p.maxbin;
+        }
+        for(k=0;k<nwindows;k++)
+                if(windows[k].first<=edges[i] && edges[i+1]-1<=windows[k].last)
+                        r->window[k] += p.sum;
+ }
+ if(r->total>0)
+ {
+        r->centroid = (double)wsum / (double)r->total;
+        r->fwhm = fwhm(counts, n, r->peakbin);
+ }
+ return 0;
+}
+
+
+const char* histsum_kernel(void)
+{
+#ifdef HIST_HAVE_AVX2
+ if(histcpu_avx2())
+        return "AVX2";
+#endif
+#if defined(HIST_HAVE_SSE2)
+ return "SSE2";
+#else
+ return "scalar";
+#endif
+}
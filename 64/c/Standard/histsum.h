@@ -0,0 +1,43 @@
+/************************************************************************
+
+  Histogram reductions
+
+  Total count, peak bin, centroid and up to HISTSUM_MAXWINDOWS window
+  sums of a histogram in one pass over the bins, with AVX2 where the
+  CPU has it (see histcpu.h), SSE2 on any other x64 CPU and a scalar
+  loop elsewhere. The FWHM is then found by walking
+  down both sides of the peak, which touches only the bins of the peak.
+
+  Sums are 64 bit. The centroid needs bin number times count summed,
+  which is exact for any histogram a PicoHarp delivers (65536 bins of
+  at most 2^32 counts).
+
+************************************************************************/
+
+#ifndef HISTSUM_H
+#define HISTSUM_H
+
+#define HISTSUM_MAXWINDOWS 8
+
+typedef struct
+{
+ int first, last;                    //bins, both included
+} histsum_window;
+
+typedef struct
+{
+ unsigned long long total;
+ unsigned int peak;
+ int peakbin;                        //the first bin with the peak count
+ double centroid;                    //in bins, 0 for an empty histogram
+ double fwhm;                        //in bins, interpolated, 0 for an empty histogram
+ unsigned long long window[HISTSUM_MAXWINDOWS];
+} histsum_result;
+
+//n bins of counts, nwindows windows (may be 0); returns 0, or -1 for too many windows
+int histsum(const unsigned int* counts, int n, const histsum_window* windows, int nwindows, histsum_result* r);
+
+//"AVX2", "SSE2" or "scalar", whichever histsum uses on this CPU
+const char* histsum_kernel(void);
+
+#endif
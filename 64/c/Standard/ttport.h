@@ -0,0 +1,333 @@
+/************************************************************************
+
+  Minimal portability layer for the TTTR demo helpers
+
+  Threads, a mutex, a wakeup event, a few atomic operations, a monotonic
+  clock and sleeps, mapped onto Win32 or POSIX. Only what the TTTR helpers
+  actually need is provided here; everything is static inline so that
+  no extra translation unit is needed.
+
+************************************************************************/
+
+#ifndef TTPORT_H
+#define TTPORT_H
+
+#ifdef _WIN32
+#include <windows.h>
+#include <mmsystem.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "winmm.lib") //timeBeginPeriod
+#endif
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifdef _MSC_VER
+#define TT_INLINE static __inline
+#else
+#define TT_INLINE static inline
+#endif
+
+#define TT_CACHELINE 64
+
+
+//threads
+
+#ifdef _WIN32
+typedef HANDLE tt_thread;
+typedef DWORD (WINAPI *tt_threadfunc)(void*);
+#define TT_THREADFUNC(name) DWORD WINAPI name(void* arg)
+#define TT_THREADRETURN return 0
+#else
+typedef pthread_t tt_thread;
+typedef void* (*tt_threadfunc)(void*);
+#define TT_THREADFUNC(name) void* name(void* arg)
+#define TT_THREADRETURN return NULL
+#endif
+
+TT_INLINE int tt_thread_create(tt_thread* t, tt_threadfunc func, void* arg)
+{
+#ifdef _WIN32
+ *t = CreateThread(NULL, 0, func, arg, 0, NULL);
+ return (*t==NULL) ? -1 : 0;
+#else
+ return pthread_create(t, NULL, func, arg)==0 ? 0 : -1;
+#endif
+}
+
+TT_INLINE void tt_thread_join(tt_thread t)
+{
+#ifdef _WIN32
+ WaitForSingleObject(t, INFINITE);
+ CloseHandle(t);
+#else
+ pthread_join(t, NULL);
+#endif
+}
+
+TT_INLINE int tt_ncpus(void)
+{
+#ifdef _WIN32
+ SYSTEM_INFO si;
+ GetSystemInfo(&si);
+ return (int)si.dwNumberOfProcessors;
+#else
+ long n = sysconf(_SC_NPROCESSORS_ONLN);
+ return n<1 ? 1 : (int)n;
+#endif
+}
+
+//pins the calling thread to one CPU; on Linux this needs _GNU_SOURCE
+//defined before the first system header, otherwise it does nothing
+TT_INLINE int tt_pin_self(int cpu)
+{
+#if defined(_WIN32)
+ return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1<<cpu)==0 ? -1 : 0;
+#elif defined(__linux__) && defined(_GNU_SOURCE)
+ cpu_set_t set;
+ CPU_ZERO(&set);
+ CPU_SET(cpu, &set);
+ return pthread_setaffinity_np(pthread_self(), sizeof(set), &set)==0 ? 0 : -1;
+#else
+ return -1;
+#endif
+}
+
+TT_INLINE void tt_yield(void)
+{
+#ifdef _WIN32
+ SwitchToThread();
+#else
+ sched_yield();
+#endif
+}
+
+TT_INLINE void tt_sleep_ms(int ms)
+{
+#ifdef _WIN32
+ Sleep(ms);
+#else
+ usleep((useconds_t)ms*1000);
+#endif
+}
+
+//sleeps for about us microseconds; Win32 sleeps have millisecond granularity
+//(and 15.6 ms outside tt_timer_begin/tt_timer_end), shorter waits only yield
+TT_INLINE void tt_sleep_us(int us)
+{
+#ifdef _WIN32
+ if(us>=1000)
+        Sleep(us/1000);
+ else
+        SwitchToThread();
+#else
+ usleep((useconds_t)us);
+#endif
+}
+
+//bracket a measurement with these so that Win32 sleeps last 1 ms rather than
+//a whole 15.6 ms scheduler tick; calls must be paired, nothing to do elsewhere
+TT_INLINE void tt_timer_begin(void)
+{
+#ifdef _WIN32
+ timeBeginPeriod(1);
+#endif
+}
+
+TT_INLINE void tt_timer_end(void)
+{
+#ifdef _WIN32
+ timeEndPeriod(1);
+#endif
+}
+
+
+//mutex
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION tt_mutex;
+#define tt_mutex_init(m)    InitializeCriticalSection(m)
+#define tt_mutex_destroy(m) DeleteCriticalSection(m)
+#define tt_mutex_lock(m)    EnterCriticalSection(m)
+#define tt_mutex_unlock(m)  LeaveCriticalSection(m)
+#else
+typedef pthread_mutex_t tt_mutex;
+#define tt_mutex_init(m)    pthread_mutex_init(m, NULL)
+#define tt_mutex_destroy(m) pthread_mutex_destroy(m)
+#define tt_mutex_lock(m)    pthread_mutex_lock(m)
+#define tt_mutex_unlock(m)  pthread_mutex_unlock(m)
+#endif
+
+
+//wakeup event: wakes a thread that waits for work instead of polling. It resets
+//itself when a wait returns, and a set before the wait is not lost; the
+//waiter still checks its condition, since a set may wake it for nothing.
+
+#ifdef _WIN32
+typedef HANDLE tt_wakeup;
+#else
+typedef struct
+{
+ pthread_mutex_t lock;
+ pthread_cond_t cond;
+ int set;
+} tt_wakeup;
+#endif
+
+//returns 0 or -1
+TT_INLINE int tt_wakeup_init(tt_wakeup* e)
+{
+#ifdef _WIN32
+ *e = CreateEvent(NULL, FALSE, FALSE, NULL);
+ return *e==NULL ? -1 : 0;
+#else
+ e->set = 0;
+ if(pthread_mutex_init(&e->lock, NULL)!=0)
+        return -1;
+ if(pthread_cond_init(&e->cond, NULL)!=0)
+ {
+        pthread_mutex_destroy(&e->lock);
+        return -1;
+ }
+ return 0;
+#endif
+}
+
+TT_INLINE void tt_wakeup_destroy(tt_wakeup* e)
+{
+#ifdef _WIN32
+ CloseHandle(*e);
+#else
+ pthread_cond_destroy(&e->cond);
+ pthread_mutex_destroy(&e->lock);
+#endif
+}
+
+TT_INLINE void tt_wakeup_set(tt_wakeup* e)
+{
+#ifdef _WIN32
+ SetEvent(*e);
+#else
+ pthread_mutex_lock(&e->lock);
+ e->set = 1;
+ pthread_cond_signal(&e->cond);
+ pthread_mutex_unlock(&e->lock);
+#endif
+}
+
+//waits until the event is set, at most ms milliseconds
+TT_INLINE void tt_wakeup_wait(tt_wakeup* e, int ms)
+{
+#ifdef _WIN32
+ WaitForSingleObject(*e, (DWORD)ms);
+#else
+ struct timespec ts;
+
+ clock_gettime(CLOCK_REALTIME, &ts);
+ ts.tv_sec += ms/1000;
+ ts.tv_nsec += (long)(ms%1000)*1000000;
+ if(ts.tv_nsec>=1000000000)
+ {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+ }
+ pthread_mutex_lock(&e->lock);
+ while(!e->set)
+        if(pthread_cond_timedwait(&e->cond, &e->lock, &ts)!=0)
+                break;
+ e->set = 0;
+ pthread_mutex_unlock(&e->lock);
+#endif
+}
+
+
+//atomics: acquire loads and release stores for the index handoff between
+//one producer and one consumer, plus a relaxed add for statistics counters
+//and a full fence (64 bit values are atomic on x64 only)
+
+#ifdef _MSC_VER
+//on x86/x64 MSVC, volatile accesses have acquire/release semantics
+TT_INLINE unsigned int tt_load_acquire(volatile unsigned int* p)
+{
+ unsigned int v = *p;
+ _ReadWriteBarrier();
+ return v;
+}
+
+TT_INLINE void tt_store_release(volatile unsigned int* p, unsigned int v)
+{
+ _ReadWriteBarrier();
+ *p = v;
+}
+
+TT_INLINE unsigned __int64 tt_load_acquire64(volatile unsigned __int64* p)
+{
+ unsigned __int64 v = *p;
+ _ReadWriteBarrier();
+ return v;
+}
+
+TT_INLINE void tt_store_release64(volatile unsigned __int64* p, unsigned __int64 v)
+{
+ _ReadWriteBarrier();
+ *p = v;
+}
+
+TT_INLINE void tt_add64(volatile __int64* p, __int64 v)
+{
+ InterlockedExchangeAdd64(p, v);
+}
+
+#define tt_fence() MemoryBarrier()
+typedef __int64 tt_int64;
+#else
+TT_INLINE unsigned int tt_load_acquire(volatile unsigned int* p)
+{
+ return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+TT_INLINE void tt_store_release(volatile unsigned int* p, unsigned int v)
+{
+ __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+TT_INLINE unsigned long long tt_load_acquire64(volatile unsigned long long* p)
+{
+ return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+TT_INLINE void tt_store_release64(volatile unsigned long long* p, unsigned long long v)
+{
+ __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+TT_INLINE void tt_add64(volatile long long* p, long long v)
+{
+ __atomic_fetch_add(p, v, __ATOMIC_RELAXED);
+}
+
+#define tt_fence() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+typedef long long tt_int64;
+#endif
+
+
+//monotonic clock in microseconds
+
+TT_INLINE double tt_now_us(void)
+{
+#ifdef _WIN32
+ LARGE_INTEGER f, c;
+ QueryPerformanceFrequency(&f);
+ QueryPerformanceCounter(&c);
+ return (double)c.QuadPart * 1e6 / (double)f.QuadPart;
+#else
+ struct timespec ts;
+ clock_gettime(CLOCK_MONOTONIC, &ts);
+ return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec * 1e-3;
+#endif
+}
+
+#endif
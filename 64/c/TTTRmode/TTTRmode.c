@@ -19,10 +19,15 @@
 
 ************************************************************************/
 
+#ifdef _WIN32
 #include <windows.h>
 #include <dos.h>
-#include <stdio.h>
 #include <conio.h>
+#else
+#include <unistd.h>
+#define Sleep(msec) usleep((msec)*1000)
+#endif
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -31,8 +36,182 @@
 #include "phdefin.h"
 #include "phlib.h"
 #include "errorcodes.h"
+#include "ttring.h"
+#include "ttdecode.h"
+#include "ttpoll.h"
+#include "ttshm.h"
+#include "tthist.h"
+#include "ttcorr.h"
+#include "ttindex.h"
+#include "ttpack.h"
+#include "ttseg.h"
+#include "ttdio.h"
+#include "ttlat.h"
+#include "ttstat.h"
+
+//PH_ReadFiFo reads into blocks of this ring, a separate thread writes them to disk,
+//so that a disk stall does not hold up the FiFo polling
+ttring Ring;
+FILE *fpout;
+
+//optional compressed output instead of fpout, see Compress in main
+ttpack_writer Pack;
+int Packing=0;
+
+//optional output in a series of files instead of fpout, see SegmentMB in main
+ttseg_writer Seg;
+int Segmenting=0;
+
+//optional writing of tttrmode.out past the page cache, see DirectIO in main
+ttdio_writer Dio;
+int Direct=0;
+
+//telemetry of the reads and the writes, see StatsPeriod in main
+ttstat Stats;
+
+//optional coalescing of overflow runs before anything else sees the records, see CoalesceOverflows in main
+tt_coalescer Coalescer;
+int Coalescing=0;
+unsigned int* CoalescedBlock;
+double RecordsRead=0, RecordsWritten=0;
+
+//optional decoding of the records on the writer thread, see Decode in main
+int DecodeMode=0;
+tt_t2state T2State;
+tt_t3state T3State;
+unsigned long long *Times, *MarkerTimes;  //ps in T2, syncs in T3
+unsigned short *Dtimes;
+unsigned char *Channels, *MarkerBits;
+double NPhotons=0, NMarkers=0;
+unsigned long long LastTime=0;
+
+//optional shared-memory bus for live viewers such as ttshmview, see Publish in main
+ttshm Bus;
+int Publishing=0;
+
+//optional live T3 lifetime histograms, accumulated by the writer thread, see LiveHist in main
+tthist Hist;
+int Histogramming=0;
+unsigned long long HistSnapshot[TT_HISTCHANS][TT_HISTBINS];
+
+//optional sparse time index of tttrmode.out for random access by time, see WriteIndex in main
+ttindex_writer Index;
+int Indexing=0;
+
+//optional live T2 correlation of channels 0 and 1 on the decoded photons, see Correlate in main
+ttcorr Corr;
+int Correlating=0;
+double CorrPeriod_us=1e6, CorrSaved=0;
+double CorrLags[TT_CORRLEVELS*TT_CORRP], CorrG[4][TT_CORRLEVELS*TT_CORRP];
+
+
+//rewrites tttrmode_corr.out with the curves so far, BA as AB at negative lags
+int savecorr(void)
+{
+ FILE* fp;
+ int c, i, n;
+
+ n = tt_corr_lags(&Corr,CorrLags);
+ for(c=0;c<4;c++)
+        tt_corr_get(&Corr,c,CorrG[c]);
+ if((fp=fopen("tttrmode_corr.out","w"))==NULL)
+        return -1;
+ fprintf(fp,"#lag/ps g_00 g_11 g_01");
+ for(i=n-1;i>0;i--)
+        fprintf(fp,"\n%14.0lf %10.6lf %10.6lf %10.6lf",-CorrLags[i],CorrG[0][i],CorrG[1][i],CorrG[3][i]);
+ for(i=0;i<n;i++)
+        fprintf(fp,"\n%14.0lf %10.6lf %10.6lf %10.6lf",CorrLags[i],CorrG[0][i],CorrG[1][i],CorrG[2][i]);
+ fclose(fp);
+ return 0;
+}
+
+
+void decode(unsigned int* block, int n)
+{
+ int np=0, nm=0;
 
-unsigned int buffer[TTREADMAX];
+ if(DecodeMode==MODE_T2)
+ {
+        np = tt_decode_t2(&T2State,block,n,Times,Channels,MarkerTimes,MarkerBits,&nm);
+        if(np)
+                LastTime = Times[np-1];
+        if(Correlating)
+        {
+                tt_corr_add(&Corr,Times,Channels,np);
+                if(tt_now_us() - CorrSaved >= CorrPeriod_us) //so the curves can be watched while they converge
+                {
+                        savecorr();
+                        CorrSaved = tt_now_us();
+                }
+        }
+ }
+ if(DecodeMode==MODE_T3)
+ {
+        np = tt_decode_t3(&T3State,block,n,Times,Dtimes,Channels,MarkerTimes,MarkerBits,&nm);
+        if(np)
+                LastTime = Times[np-1];
+ }
+ NPhotons += np;
+ NMarkers += nm;
+}
+
+
+//writes the records and passes them on, returns -1 after a write error
+int output(unsigned int* block, int n)
+{
+ double t;
+ int err;
+
+ if(n==0) //all held back by the coalescer
+        return 0;
+ t = tt_now_us();
+ err = Segmenting ? ttseg_write(&Seg,block,n)<0
+     : Packing ? ttpack_write(&Pack,block,n)<0
+     : Direct ? ttdio_write(&Dio,block,n*4)<0 : fwrite(block,4,n,fpout)!=(unsigned)n;
+ ttstat_written(&Stats,n,tt_now_us()-t);
+ if(err)
+        return -1;
+ if(Indexing)
+        ttindex_add(&Index,block,n);
+ if(DecodeMode)
+        decode(block,n);
+ if(Publishing) //never waits for the viewers
+        ttshm_publish(&Bus,block,n);
+ if(Histogramming)
+        tthist_add(&Hist,0,block,n);
+ return 0;
+}
+
+
+TT_THREADFUNC(writer)
+{
+ unsigned int* block;
+ int n;
+
+ while(!ttring_finished(&Ring))
+ {
+        block = ttring_peek(&Ring,&n);
+        if(block==NULL)
+        {
+                tt_sleep_ms(1);
+                continue;
+        }
+        if(Coalescing)
+        {
+                RecordsRead += n;
+                n = tt_coalesce(&Coalescer,block,n,CoalescedBlock);
+                RecordsWritten += n;
+                block = CoalescedBlock;
+        }
+        if(output(block,n)<0)
+        {
+                ttring_fail(&Ring);
+                break;
+        }
+        ttring_release(&Ring);
+ }
+ TT_THREADRETURN;
+}
 
 
 int main(int argc, char* argv[])
@@ -40,7 +219,6 @@ int main(int argc, char* argv[])
  int i;
  int dev[MAXDEVNUM]; 
  int found=0;
- FILE *fpout; 
  int retcode;
  char LIB_Version[8];
  char HW_Model[16];
@@ -58,12 +236,55 @@ int main(int argc, char* argv[])
  int CFDZeroCross1=10; //you can change this
  int CFDLevel1=150; //you can change this
  int blocksz = TTREADMAX; // in steps of 512
+ int RingBlocks = 64; //you can change this, number of blocksz buffers between FiFo and disk
+ int Decode = 0; //you can change this, 1 decodes the records while writing them (for the summary only)
+ int MaxSleep = 5000; //you can change this, longest wait between FiFo reads in microsec, 0 to poll without waiting
+ int StatusPeriod = 100; //you can change this, interval of the status calls in idle times in millisec
+ int StatsPeriod = 1000; //you can change this, interval of the status line and of the tttrmode_stats.txt lines in millisec, 0 for neither (see ttstat.h)
+ int FiFoWarnMs = 200; //you can change this, warns when the reads have not drained the FiFo for so long
+ int Publish = 0; //you can change this, 1 publishes the data on a shared-memory bus for live viewers (see ttshm.h)
+ char BusName[] = "phtttr"; //you can change this, name of the bus
+ int BusSlots = 64; //you can change this, number of blocksz slots a viewer may fall behind
+ int LiveHist = 1; //you can change this, 1 accumulates the dtime histograms in T3 mode while measuring (see tthist.h)
+ int HistStartMarkers = 0; //you can change this, marker bits that open the histogram gate, 0 for no gating
+ int HistStopMarkers = 0; //you can change this, marker bits that close the histogram gate
+ int Correlate = 0; //you can change this, 1 correlates channels 0 and 1 in T2 mode while measuring (needs Decode, see ttcorr.h), about 2 Mcps per CPU
+ int CorrBase = 64; //you can change this, shortest correlation lag step in ps
+ int CorrSavePeriod = 1000; //you can change this, interval of the tttrmode_corr.out updates in millisec
+ int CoalesceOverflows = 0; //you can change this, 1 writes each run of overflow records as one counted record to tttrmode.ovc instead of tttrmode.out (see ttdecode.h), for low count rates
+ int Compress = 0; //you can change this, 1 writes the records block-compressed to tttrmode.ttz instead of tttrmode.out (see ttpack.h)
+ int CompressThreads = 0; //you can change this, number of compression threads, 0 for one per CPU
+ int CompressQueue = 16; //you can change this, number of blocksz blocks waiting for or in compression
+ int SegmentMB = 0; //you can change this, starts a new file tttrmode_NNNN.out every SegmentMB megabytes (see ttseg.h), 0 for one tttrmode.out
+ int SegmentMinutes = 0; //you can change this, also starts a new file after so many minutes, 0 for no limit
+ int SegmentCompress = 0; //you can change this, 1 compresses the closed segments in the background with CompressThreads threads
+ int DirectIO = 0; //you can change this, 1 writes tttrmode.out past the page cache with DirectIOThreads writes in flight (see ttdio.h)
+ int DirectIOThreads = 2; //you can change this, number of I/O threads
+ int DirectIOBufferKB = 4096; //you can change this, size of each of the DirectIOBuffers buffers
+ int DirectIOBuffers = 8; //you can change this
+ int PreallocMB = 1024; //you can change this, disk space reserved ahead of the data, 0 for none
+ int WriteIndex = 0; //you can change this, 1 writes the time index tttrmode.out.idx (or .ttz.idx) for random access (see ttindex.h)
+ int IndexRecords = 1048576; //you can change this, largest spacing of the index entries in records
+ int IndexPeriod = 100; //you can change this, largest spacing of the index entries in millisec of measurement time
+ double HistPhotons;
+ FILE *fphist=NULL;
+ double IndexUnit;
+ char* IndexName = "tttrmode.out.idx";
+ char* OutName;
  double Resolution; 
  int Countrate0;
  int Countrate1;
  int flags;
  int nactual;
- int FiFoWasFull,CTCDone,Progress;
+ int ntail;
+ int FiFoWasFull,CTCDone;
+ unsigned int* buffer;
+ tt_thread writerthread;
+ int WriterRunning=0;
+ int Measuring=0;
+ int fill=0;
+ double blockstart=0;
+ ttpoll Poll;
 
 
  printf("\nPicoHarp 300 PHLib.DLL   TTTR Mode Demo    M. Wahl, PicoQuant GmbH, 2013");
@@ -73,12 +294,81 @@ int main(int argc, char* argv[])
  if(strncmp(LIB_Version,LIB_VERSION,sizeof(LIB_VERSION))!=0)
          printf("\nWarning: The application was built for version %s.",LIB_VERSION);
 
- if((fpout=fopen("tttrmode.out","wb"))==NULL)
+ //other programs would take a coalesced overflow record for one wraparound, so such files are named differently
+ OutName = CoalesceOverflows ? "tttrmode" TT_COALESCEDEXT : "tttrmode.out";
+ if(SegmentMB>0 || SegmentMinutes>0) //the segments are compressed afterwards if at all, Compress does not apply
+ {
+         if(ttseg_create(&Seg,"tttrmode",Mode,CoalesceOverflows,SegmentMB*1048576LL,SegmentMinutes*60.0,SegmentCompress,CompressThreads)<0)
+         {
+                 printf("\ncannot create tttrmode_segments.txt or start the segment finalizer\n"); 
+                 goto ex;
+         }
+         Segmenting=1;
+ }
+ else if(Compress)
+ {
+         if(ttpack_create(&Pack,"tttrmode.ttz",Mode|(CoalesceOverflows ? TTPACK_COALESCED : 0),blocksz,CompressThreads,CompressQueue)<0)
+         {
+                 printf("\ncannot open output file\n"); 
+                 goto ex;
+         }
+         Packing=1;
+ }
+ else if(DirectIO)
+ {
+         if(ttdio_create(&Dio,OutName,DirectIOBufferKB*1024,DirectIOBuffers,DirectIOThreads,PreallocMB*1048576LL)<0)
+         {
+                 printf("\ncannot open output file\n"); 
+                 goto ex;
+         }
+         Direct=1;
+ }
+ else if((fpout=fopen(OutName,"wb"))==NULL)
  {
          printf("\ncannot open output file\n"); 
          goto ex;
  }
 
+ if(ttring_init(&Ring,RingBlocks,blocksz)<0)
+ {
+         printf("\ncannot allocate ring buffer\n"); 
+         goto ex;
+ }
+ ttstat_init(&Stats);
+
+ if(Decode)
+ {
+         Times = (unsigned long long*)malloc(blocksz*sizeof(unsigned long long));
+         MarkerTimes = (unsigned long long*)malloc(blocksz*sizeof(unsigned long long));
+         Dtimes = (unsigned short*)malloc(blocksz*sizeof(unsigned short));
+         Channels = (unsigned char*)malloc(blocksz);
+         MarkerBits = (unsigned char*)malloc(blocksz);
+         if(Times==NULL || MarkerTimes==NULL || Dtimes==NULL || Channels==NULL || MarkerBits==NULL)
+         {
+                 printf("\ncannot allocate decoder buffers\n"); 
+                 goto ex;
+         }
+         tt_t2_init(&T2State);
+         tt_t3_init(&T3State);
+         T2State.coalesced = T3State.coalesced = CoalesceOverflows; //they are decoded after coalescing
+         DecodeMode = Mode;
+ }
+
+ if(CoalesceOverflows)
+ {
+         //one more than a block, for a run held back from the block before
+         if((CoalescedBlock = (unsigned int*)malloc((blocksz+1)*sizeof(unsigned int)))==NULL)
+         {
+                 printf("\ncannot allocate coalescing buffer\n"); 
+                 goto ex;
+         }
+         if(Mode==MODE_T2)
+                 tt_coalesce_init_t2(&Coalescer);
+         else
+                 tt_coalesce_init_t3(&Coalescer);
+         Coalescing = 1;
+ }
+
  printf("\n\n");
  printf("Mode             : %ld\n",Mode);
  printf("Binning          : %ld\n",Binning);
@@ -213,64 +503,155 @@ int main(int argc, char* argv[])
 
  printf("\nResolution=%1lf Countrate0=%1d/s Countrate1=%1d/s", Resolution, Countrate0, Countrate1);
 
- Progress = 0;
- printf("\nProgress:%9d",Progress);
+ ttpoll_init(&Poll,blocksz,Tacq,MaxSleep,StatusPeriod*1000.0);
 
+ if(LiveHist && Mode==MODE_T3)
+ {
+        if(tthist_init(&Hist,1,100)<0)
+        {
+                printf("\ncannot allocate histograms\n");
+                goto ex;
+        }
+        tthist_gate(&Hist,HistStartMarkers,HistStopMarkers);
+        Histogramming=1;
+ }
+
+ if(Correlate && !Decode)
+        printf("\nCorrelate needs Decode, not correlating");
+ if(Correlate && DecodeMode==MODE_T2)
+ {
+        if(tt_corr_init(&Corr,0,1,CorrBase)<0)
+        {
+                printf("\ninvalid correlator settings\n");
+                goto ex;
+        }
+        CorrPeriod_us = CorrSavePeriod*1000.0;
+        CorrSaved = tt_now_us();
+        Correlating=1;
+ }
+
+ if(Publish)
+ {
+        if(ttshm_create(&Bus,BusName,BusSlots,blocksz,Mode,Resolution,CoalesceOverflows)<0)
+                printf("\ncannot create the live bus %s, continuing without it",BusName);
+        else
+                Publishing=1;
+ }
+
+ if(WriteIndex)
+ {
+        //T3 times are in syncs; the rate counter sees the sync input before the divider
+        IndexUnit = Mode==MODE_T2 ? 1.0 : (Countrate0>0 ? 1e12*SyncDivider/Countrate0 : 0.0);
+        //with compression the record numbers of the index lead to the blocks via the directory
+        IndexName = Packing ? "tttrmode.ttz.idx" : CoalesceOverflows ? "tttrmode" TT_COALESCEDEXT ".idx" : "tttrmode.out.idx";
+        if(Segmenting) //each segment gets its own, written by the finalizer
+                ttseg_index(&Seg,IndexRecords,IndexUnit>0 ? IndexPeriod*1e9/IndexUnit : 0.0,IndexUnit);
+        else if(ttindex_create(&Index,IndexName,Mode,CoalesceOverflows,IndexRecords,
+                               IndexUnit>0 ? IndexPeriod*1e9/IndexUnit : 0.0,IndexUnit)<0)
+                printf("\ncannot create %s, continuing without index",IndexName);
+        else
+                Indexing=1;
+ }
+
+ if(tt_thread_create(&writerthread,writer,NULL)<0)
+ {
+        printf("\ncannot start writer thread\n");
+        goto ex;
+ }
+ WriterRunning=1;
+
+ tt_timer_begin(); //1 ms sleeps in the read loop, see ttport.h
+ Measuring=1;
  retcode = PH_StartMeas(dev[0],Tacq);
  if(retcode<0)
  {
         printf("\nError in StartMeas. Aborted.\n");
         goto ex;
  }
+ ttpoll_start(&Poll);
+ printf("\n");
+ if(ttstat_start(&Stats,"tttrmode_stats.txt",1,StatsPeriod,FiFoWarnMs,&Ring)<0)
+        printf("\ncannot create tttrmode_stats.txt, continuing without it\n");
 
  while(1)  
  {
-        retcode = PH_GetFlags(dev[0],&flags);
-        if(retcode<0)
+        //the status calls are made only when due, see ttpoll.h
+        if(ttpoll_wantflags(&Poll))
         {
-                printf("\nError %1d in GetFlags. Aborted.\n",retcode);
-                goto ex;
+                retcode = PH_GetFlags(dev[0],&flags);
+                if(retcode<0)
+                {
+                        printf("\nError %1d in GetFlags. Aborted.\n",retcode);
+                        goto ex;
+                }
+
+                FiFoWasFull=flags&FLAG_FIFOFULL;
+
+                if (FiFoWasFull) 
+                {
+                        printf("\nFiFo Overrun!\n"); 
+                        goto stoptttr;
+                }
         }
-
-		FiFoWasFull=flags&FLAG_FIFOFULL;
-   
-		if (FiFoWasFull) 
+		
+		if(fill==0)
 		{
-			printf("\nFiFo Overrun!\n"); 
-			goto stoptttr;
+			buffer = ttring_acquire(&Ring); //waits only if the writer falls behind by RingBlocks
+			if(buffer==NULL)
+			{
+				printf("\nfile write error\n");
+				goto stoptttr;
+			}
+			blockstart = tt_now_us();
 		}
-		
-		retcode = PH_ReadFiFo(dev[0],buffer,blocksz,&nactual);	//may return less!  
+
+		//keep filling the same ring block until it is full or the FiFo runs empty
+		ttpoll_wait(&Poll);
+		retcode = PH_ReadFiFo(dev[0],buffer+fill,(blocksz-fill)&~511,&nactual);	//may return less!  
 		if(retcode<0) 
 		{ 
 			printf("\nReadData error %d\n",retcode); 
 			goto stoptttr; 
 		}  
+		ttpoll_update(&Poll,nactual,(blocksz-fill)&~511);
+		ttstat_read(&Stats,nactual,(blocksz-fill)&~511);
 
 		if(nactual) 
 		{
-			if(fwrite(buffer,4,nactual,fpout)!=(unsigned)nactual)
-			{
-				printf("\nfile write error\n");
-				goto stoptttr;
-			}               
-				Progress += nactual;
-				printf("\b\b\b\b\b\b\b\b\b%9d",Progress);
+				fill += nactual;
+				if(blocksz-fill < 512)
+				{
+					ttring_commit(&Ring,fill); //hand over to the writer thread
+					fill = 0;
+				}
 		}
-		else
+
+		//at low count rates hand over partial blocks now and then, but not on
+		//every read or the ring fills up with tiny blocks; with the waits of
+		//ttpoll a read is rarely empty, there are always overflow records
+		if(fill && tt_now_us()-blockstart > 100000.0)
 		{
-            retcode = PH_CTCStatus(dev[0],&CTCDone);
-            if(retcode<0)
+			ttring_commit(&Ring,fill);
+			fill = 0;
+		}
+
+		if(nactual==0)
+		{
+            if(ttpoll_wantctc(&Poll))
             {
-                printf("\nError %1d in StartMeas. Aborted.\n",retcode);
-                goto ex;
+                retcode = PH_CTCStatus(dev[0],&CTCDone);
+                if(retcode<0)
+                {
+                    printf("\nError %1d in StartMeas. Aborted.\n",retcode);
+                    goto ex;
+                }
+
+                if (CTCDone) 
+                { 
+                    printf("\nDone\n"); 
+                    goto stoptttr; 
+                }  
             }
-
-			if (CTCDone) 
-			{ 
-				printf("\nDone\n"); 
-				goto stoptttr; 
-			}  
 		}
 	
 		//You can query the count rates here, but do it only if you need them
@@ -297,6 +678,109 @@ stoptttr:
 
 ex:
 
+ if(Measuring)
+        tt_timer_end();
+ if(WriterRunning)
+ {
+        ttstat_readdone(&Stats); //no FiFo warnings while the writer empties the ring
+        if(fill)
+                ttring_commit(&Ring,fill);
+        ttring_close(&Ring);
+        tt_thread_join(writerthread);
+        if(Coalescing && !Ring.error) //the overflows at the very end
+        {
+                ntail = tt_coalesce_flush(&Coalescer,CoalescedBlock);
+                RecordsWritten += ntail;
+                if(output(CoalescedBlock,ntail)<0)
+                        Ring.error = 1;
+        }
+        ttstat_stop(&Stats);
+        if(Ring.error)
+                printf("\nfile write error\n");
+        printf("\nRing high-water mark %u of %u blocks, reader stalled %u times for %1.3lf ms",
+                Ring.highwater, Ring.nblocks, Ring.stalls, Ring.stalltime_us/1000.0);
+        printf("\nDevice calls: %1.0lf reads (%1.0lf empty), %1.0lf GetFlags, %1.0lf CTCStatus, %1.0lf calls/s",
+                Poll.reads, Poll.emptyreads, Poll.flagcalls, Poll.ctccalls, ttpoll_callrate(&Poll));
+        printf("\nPolling waited %1.0lf times for %1.3lf s in total",
+                Poll.waits, Poll.waittime_us/1e6);
+        printf("\nDisk writes: %1.0lf, p50 %1.0lf us, p99 %1.0lf us, p99.9 %1.0lf us, max %1.0lf us",
+                (double)Stats.writes.n, ttlat_percentile(&Stats.writes,50), ttlat_percentile(&Stats.writes,99),
+                ttlat_percentile(&Stats.writes,99.9), Stats.writes.max_us);
+        ttstat_print(&Stats);
+        if(DecodeMode==MODE_T2)
+                printf("\nDecoded %1.0lf photons and %1.0lf markers, last photon at %1.6lf s",
+                        NPhotons, NMarkers, LastTime*1e-12);
+        if(DecodeMode==MODE_T3)
+                printf("\nDecoded %1.0lf photons and %1.0lf markers, last photon at sync %1.0lf",
+                        NPhotons, NMarkers, (double)LastTime);
+ }
+ if(Coalescing)
+        printf("\nOverflow coalescing wrote %1.0lf of %1.0lf records (%1.1lf%%)",
+                RecordsWritten, RecordsRead, RecordsRead>0 ? 100.0*RecordsWritten/RecordsRead : 0.0);
+ if(Segmenting)
+ {
+        printf("\nFinalizing the segments ...");
+        if(ttseg_close(&Seg)<0)
+                printf("\nsegment write or finalization error");
+        printf("\n%d segments, listed in tttrmode_segments.txt",Seg.segment);
+ }
+ if(Packing)
+ {
+        if(ttpack_close(&Pack)<0)
+                printf("\ncompressed file write error");
+        else
+                printf("\nCompressed %1.1lf MB to %1.1lf MB (%1.1lf%%) in tttrmode.ttz, %1.0lf waits for the %d compression threads",
+                        Pack.rawbytes/1e6, Pack.packedbytes/1e6, Pack.rawbytes>0 ? 100.0*Pack.packedbytes/Pack.rawbytes : 0.0,
+                        Pack.waits, Pack.nworkers);
+ }
+ if(Direct)
+ {
+        if(ttdio_close(&Dio)<0)
+                printf("\nfile write error");
+        printf("\nDirect I/O%s: %1.0lf device writes, p50 %1.0lf us, p99 %1.0lf us, max %1.0lf us, %1.0lf waits for a free buffer (%1.3lf ms)",
+                Dio.direct ? "" : " (not supported here, went through the cache)",
+                (double)Dio.latency.n, ttlat_percentile(&Dio.latency,50), ttlat_percentile(&Dio.latency,99), Dio.latency.max_us,
+                Dio.waits, Dio.waittime_us/1000.0);
+ }
+ if(Indexing)
+ {
+        if(ttindex_finish(&Index)<0)
+                printf("\nindex write error");
+        else
+                printf("\nTime index saved to %s",IndexName);
+ }
+ if(Histogramming)
+ {
+        tthist_reduce(&Hist,0); //the writer thread has ended, so its part is ours now
+        tthist_snapshot(&Hist,HistSnapshot,&HistPhotons);
+        printf("\nLive histograms: %1.0lf photons",HistPhotons);
+        if((fphist=fopen("tttrmode_hist.out","w"))!=NULL)
+        {
+                for(i=0;i<TT_HISTBINS;i++)
+                        fprintf(fphist,"\n%9llu %9llu %9llu %9llu",
+                                HistSnapshot[0][i],HistSnapshot[1][i],HistSnapshot[2][i],HistSnapshot[3][i]);
+                fclose(fphist);
+                printf(", saved to tttrmode_hist.out");
+        }
+        tthist_free(&Hist);
+ }
+ if(Correlating)
+ {
+        printf("\nCorrelated %1.0lf + %1.0lf photons",Corr.na,Corr.nb);
+        if(savecorr()==0)
+                printf(", saved to tttrmode_corr.out");
+        tt_corr_free(&Corr);
+ }
+ ttring_free(&Ring);
+ if(Publishing)
+        ttshm_close(&Bus);
+ free(Times);
+ free(MarkerTimes);
+ free(Dtimes);
+ free(Channels);
+ free(MarkerBits);
+ free(CoalescedBlock);
+
  for(i=0;i<MAXDEVNUM;i++) //no harm to close all
  {
 	PH_CloseDevice(i);
@@ -0,0 +1,118 @@
+/************************************************************************
+
+  PicoHarp 300    Disk Write Benchmark in C
+
+  Writes a file in blocks the size tttrmode writes, once with fwrite
+  and once with the direct-I/O writer of ttdio.h, and reports how long
+  the write calls took:
+
+        diskbench file MB [MB/s]
+
+  With a rate the blocks are paced as a measurement at that data rate
+  would produce them (a PicoHarp at 5 Mcps gives 20 MB/s), without one
+  they are written as fast as possible. What matters for the FiFo is
+  the tail: a write that blocks for longer than the ring between FiFo
+  and disk can hold loses data, however short the average.
+
+  Note: This is a console application
+
+************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ttport.h"
+#include "ttdio.h"
+#include "ttlat.h"
+
+
+int BlockBytes = 131072*4; //you can change this, bytes per write, TTREADMAX records in tttrmode
+int DioThreads = 2; //you can change this, as DirectIOThreads in tttrmode
+int DioBufferKB = 4096; //you can change this
+int DioBuffers = 8; //you can change this
+int PreallocMB = 1024; //you can change this
+
+
+void report(const char* how, ttlat* lat, double seconds, long long bytes)
+{
+ printf("\n%-8s %6.1lf MB/s  p50 %7.0lf  p99 %7.0lf  p99.9 %7.0lf  max %7.0lf us",
+        how, seconds>0 ? bytes/seconds/1e6 : 0.0, ttlat_percentile(lat,50), ttlat_percentile(lat,99),
+        ttlat_percentile(lat,99.9), lat->max_us);
+}
+
+
+//writes bytes in blocks at rate MB/s (0 for unpaced) with fwrite, or ttdio if dio
+int bench(const char* name, long long bytes, double rate, int dio)
+{
+ FILE* fp = NULL;
+ ttdio_writer w;
+ ttlat lat;
+ unsigned int* block;
+ long long done;
+ double tstart, t, due;
+ int i, err = 0;
+
+ if((block = (unsigned int*)malloc(BlockBytes))==NULL)
+        return -1;
+ for(i=0;i<BlockBytes/4;i++) //T2 records, not that the disk cares
+        block[i] = (unsigned int)i*977 & 0x0FFFFFFF;
+ if(dio ? ttdio_create(&w,name,DioBufferKB*1024,DioBuffers,DioThreads,PreallocMB*1048576LL)<0
+        : (fp = fopen(name,"wb"))==NULL)
+ {
+        printf("\ncannot open %s\n",name);
+        free(block);
+        return -1;
+ }
+ ttlat_init(&lat);
+ tstart = tt_now_us();
+ for(done=0;done<bytes && !err;done+=BlockBytes)
+ {
+        if(rate>0)
+        {
+                due = tstart + done/rate; //rate in MB/s is bytes per microsec
+                while((t = tt_now_us()) < due)
+                        tt_sleep_us(due-t > 1000 ? 1000 : (int)(due-t)+1);
+        }
+        t = tt_now_us();
+        err = dio ? ttdio_write(&w,block,BlockBytes)<0 : fwrite(block,1,BlockBytes,fp)!=(size_t)BlockBytes;
+        ttlat_add(&lat,tt_now_us()-t);
+ }
+ if(dio ? ttdio_close(&w)<0 : fclose(fp)!=0)
+        err = 1;
+ t = (tt_now_us()-tstart)/1e6;
+ if(err)
+        printf("\nfile write error");
+ report(dio ? (w.direct ? "ttdio" : "ttdio(c)") : "fwrite", &lat, t, done);
+ if(dio)
+        printf("\n         device writes p50 %7.0lf  p99 %7.0lf  max %7.0lf us, %1.0lf waits for a buffer",
+                ttlat_percentile(&w.latency,50), ttlat_percentile(&w.latency,99), w.latency.max_us, w.waits);
+ free(block);
+ return err ? -1 : 0;
+}
+
+
+int main(int argc, char* argv[])
+{
+ long long bytes;
+ double rate = 0;
+
+ printf("\nPicoHarp 300 Disk Write Benchmark");
+ printf("\n~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+
+ if(argc<3 || argc>4 || (bytes = atoll(argv[2])*1048576LL)<=0)
+ {
+        printf("\nusage: diskbench file MB [MB/s]\n");
+        return -1;
+ }
+ if(argc==4)
+        rate = atof(argv[3]);
+ printf("\n%lld MB in blocks of %d kB%s", bytes/1048576, BlockBytes/1024, rate>0 ? "" : ", unpaced");
+ if(rate>0)
+        printf(" at %.1lf MB/s",rate);
+ if(bench(argv[1],bytes,rate,0)<0 || bench(argv[1],bytes,rate,1)<0)
+        return -1;
+ remove(argv[1]);
+ printf("\n");
+ return 0;
+}
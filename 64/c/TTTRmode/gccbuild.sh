@@ -0,0 +1,10 @@
+# Building this demo with gcc on Linux, against the PHLib stand-in in ../PHLibSim
+# (run its gccbuild.sh first)
+gcc -O2 TTTRmode.c ttcorr.c ttdecode.c ttdio.c tthist.c ttindex.c ttlat.c ttmap.c ttpack.c ttpoll.c ttring.c ttseg.c ttshm.c ttstat.c -L../PHLibSim -Wl,-rpath,'$ORIGIN/../PHLibSim' -lphlib -lpthread -lrt -o tttrmode
+gcc -O2 tttrmulti.c ttpoll.c ttring.c -L../PHLibSim -Wl,-rpath,'$ORIGIN/../PHLibSim' -lphlib -lpthread -o tttrmulti
+gcc -O2 t2merge.c ttmerge.c ttdecode.c -o t2merge
+gcc -O2 ttshmview.c ttshm.c -lrt -o ttshmview
+gcc -O2 pardecode.c ttdecode.c ttmap.c ttpool.c -lpthread -o pardecode
+gcc -O2 tttrindex.c ttdecode.c ttindex.c ttmap.c -o tttrindex
+gcc -O2 tttrpack.c ttdecode.c ttmap.c ttpack.c -lpthread -o tttrpack
+gcc -O2 diskbench.c ttdio.c ttlat.c -lpthread -o diskbench
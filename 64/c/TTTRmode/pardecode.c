@@ -0,0 +1,305 @@
+/************************************************************************
+
+  PicoHarp 300    Parallel TTTR Decode Demo in C
+
+  Decodes a raw record file as written by TTTRmode (tttrmode.out) on all
+  CPUs. The absolute time of a record depends on all overflow records
+  before it, so the file is decoded in two passes over chunks of
+  ChunkRecords records:
+
+    1. the overflows of every chunk are counted, in parallel;
+    2. a prefix sum over the counts gives the time base each chunk starts
+       with, and the number of events before it, i.e. where its output
+       goes; then all chunks are decoded in parallel and written to
+       their place in the output file.
+
+  Both passes run on a work-stealing pool (see ttpool.h) and work on the
+  memory-mapped file (see ttmap.h), so the records are never copied. The
+  result is the same as decoding the file from start to end.
+
+        pardecode tttrmode.out
+
+  The output goes to pardecode.out. In T2 mode it is a sequence of
+  tt_event records as written by t2merge (see ttmerge.h): 64 bit time in
+  ps, device 0 and the channel, where markers have TT_MARKERFLAG set. In
+  T3 mode it is a sequence of t3event records as defined below.
+
+  Note: The raw file has no header, so Mode must match the measurement.
+  A file named *.ovc is taken to hold coalesced overflow records (see
+  ttdecode.h).
+
+  Note: This is a console application
+
+************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "phdefin.h"
+#include "ttport.h"
+#include "ttdecode.h"
+#include "ttmap.h"
+#include "ttmerge.h"
+#include "ttpool.h"
+
+
+int Mode = MODE_T2; //you can change this, MODE_T2 or MODE_T3, as in the measurement
+int Threads = 0; //you can change this, 0 uses one per CPU
+int ChunkRecords = 1048576; //you can change this, records per task
+char OutFile[] = "pardecode.out"; //you can change this
+
+
+typedef struct
+{
+ unsigned long long nsync;       //absolute sync count
+ unsigned short dtime;           //in units of the resolution
+ unsigned char channel;          //photon channel, or TT_MARKERFLAG|markers
+ unsigned char reserved[5];
+} t3event;
+
+
+typedef struct
+{
+ FILE* out;                      //each worker writes with its own handle
+ unsigned long long* ptime;
+ unsigned short* pdtime;
+ unsigned char* pchan;
+ unsigned long long* mtime;
+ unsigned char* mbits;
+ void* ev;
+ int error;
+} worker;
+
+typedef struct
+{
+ ttmap map;
+ int nchunks;
+ long long* overflows;           //per chunk, then overflows before it
+ long long* events;              //per chunk, then events before it
+ worker* w;
+} job;
+
+
+static int seekto(FILE* fp, long long pos)
+{
+#ifdef _WIN32
+ return _fseeki64(fp, pos, SEEK_SET);
+#else
+ return fseeko(fp, (off_t)pos, SEEK_SET);
+#endif
+}
+
+
+//the records of chunk c, returns their number
+static int chunk(job* j, int c, const unsigned int** rec)
+{
+ long long first = (long long)c * ChunkRecords;
+
+ *rec = j->map.rec + first;
+ return (int)(j->map.nrecords-first < ChunkRecords ? j->map.nrecords-first : ChunkRecords);
+}
+
+
+void countchunk(void* ctx, int c, int wi)
+{
+ job* j = (job*)ctx;
+ const unsigned int* rec;
+ int n, k;
+
+ n = chunk(j, c, &rec);
+ //a coalesced overflow record stands for several wraparounds but is no event either
+ j->overflows[c] = Mode==MODE_T2 ? tt_overflows_t2(rec, n, j->map.coalesced, &k)
+                                  : tt_overflows_t3(rec, n, j->map.coalesced, &k);
+ j->events[c] = n - k;
+}
+
+
+void decodechunk(void* ctx, int c, int wi)
+{
+ job* j = (job*)ctx;
+ worker* w = &j->w[wi];
+ const unsigned int* rec;
+ tt_t2state s2;
+ tt_t3state s3;
+ tt_event* e2 = (tt_event*)w->ev;
+ t3event* e3 = (t3event*)w->ev;
+ size_t evsize = Mode==MODE_T2 ? sizeof(tt_event) : sizeof(t3event);
+ int n, np, nm = 0, i, k, ne;
+
+ n = chunk(j, c, &rec);
+
+ //photons and markers come out separately, merge them back into time order
+ memset(w->ev, 0, (size_t)(j->events[c+1]-j->events[c]) * evsize);
+ if(Mode==MODE_T2)
+ {
+        tt_t2_init(&s2);
+        s2.ofltime = (unsigned long long)j->overflows[c] * TT_T2WRAPAROUND;
+        s2.coalesced = j->map.coalesced;
+        np = tt_decode_t2(&s2, rec, n, w->ptime, w->pchan, w->mtime, w->mbits, &nm);
+        for(i=0, k=0, ne=0; i<np || k<nm; ne++)
+                if(k>=nm || (i<np && w->ptime[i]<=w->mtime[k]))
+                {
+                        e2[ne].time = (long long)w->ptime[i];
+                        e2[ne].channel = w->pchan[i++];
+                }
+                else
+                {
+                        e2[ne].time = (long long)w->mtime[k];
+                        e2[ne].channel = TT_MARKERFLAG | w->mbits[k++];
+                }
+ }
+ else
+ {
+        tt_t3_init(&s3);
+        s3.ofltime = (unsigned long long)j->overflows[c] * TT_T3WRAPAROUND;
+        s3.coalesced = j->map.coalesced;
+        np = tt_decode_t3(&s3, rec, n, w->ptime, w->pdtime, w->pchan, w->mtime, w->mbits, &nm);
+        for(i=0, k=0, ne=0; i<np || k<nm; ne++)
+                if(k>=nm || (i<np && w->ptime[i]<=w->mtime[k]))
+                {
+                        e3[ne].nsync = w->ptime[i];
+                        e3[ne].dtime = w->pdtime[i];
+                        e3[ne].channel = w->pchan[i++];
+                }
+                else
+                {
+                        e3[ne].nsync = w->mtime[k];
+                        e3[ne].channel = TT_MARKERFLAG | w->mbits[k++];
+                }
+ }
+
+ if(seekto(w->out, j->events[c] * (long long)evsize)
+    || fwrite(w->ev, evsize, ne, w->out)!=(size_t)ne)
+        w->error = 1;
+ ttmap_release(&j->map, (long long)c * ChunkRecords, n); //not needed again
+}
+
+
+int main(int argc, char* argv[])
+{
+ ttpool pool;
+ job j;
+ FILE* fp = NULL;
+ char* infile;
+ long long sum, t;
+ double tstart, tcount, tdecode;
+ int i, c, error = 0;
+
+ printf("\nPicoHarp 300 Parallel TTTR Decode Demo");
+ printf("\n~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+
+ memset(&j, 0, sizeof(j));
+ memset(&pool, 0, sizeof(pool));
+
+ if(argc!=2 || (Mode!=MODE_T2 && Mode!=MODE_T3) || ChunkRecords<1)
+ {
+        printf("\nusage: pardecode file  (Mode and ChunkRecords are set in the source)\n");
+        return -1;
+ }
+ infile = argv[1];
+
+ if(ttmap_open(&j.map,infile)<0)
+ {
+        printf("\ncannot open input file %s\n",infile);
+        goto ex;
+ }
+ j.nchunks = (int)((j.map.nrecords + ChunkRecords - 1) / ChunkRecords);
+
+ if(ttpool_init(&pool,Threads)<0)
+ {
+        printf("\nmemory allocation failed\n");
+        goto ex;
+ }
+ printf("\n%s: %lld records in %d chunks, %d threads, Mode %d",
+        infile, j.map.nrecords, j.nchunks, pool.nworkers, Mode);
+
+ //the output is created here, the workers then write into it at their offsets
+ if((fp = fopen(OutFile,"wb"))==NULL)
+ {
+        printf("\ncannot open output file %s\n",OutFile);
+        goto ex;
+ }
+ fclose(fp);
+
+ j.overflows = (long long*)calloc(j.nchunks+1, sizeof(long long));
+ j.events = (long long*)calloc(j.nchunks+1, sizeof(long long));
+ j.w = (worker*)calloc(pool.nworkers, sizeof(worker));
+ if(j.overflows==NULL || j.events==NULL || j.w==NULL)
+ {
+        printf("\nmemory allocation failed\n");
+        goto ex;
+ }
+ for(i=0;i<pool.nworkers;i++)
+ {
+        j.w[i].out = fopen(OutFile,"r+b");
+        j.w[i].ptime = (unsigned long long*)malloc(ChunkRecords*sizeof(unsigned long long));
+        j.w[i].pdtime = (unsigned short*)malloc(ChunkRecords*sizeof(unsigned short));
+        j.w[i].pchan = (unsigned char*)malloc(ChunkRecords);
+        j.w[i].mtime = (unsigned long long*)malloc(ChunkRecords*sizeof(unsigned long long));
+        j.w[i].mbits = (unsigned char*)malloc(ChunkRecords);
+        j.w[i].ev = malloc(ChunkRecords*sizeof(t3event));
+        if(!j.w[i].out || !j.w[i].ptime || !j.w[i].pdtime
+           || !j.w[i].pchan || !j.w[i].mtime || !j.w[i].mbits || !j.w[i].ev)
+        {
+                printf("\ncannot open the output file or allocate the buffers of thread %d\n",i);
+                goto ex;
+        }
+ }
+
+ tstart = tt_now_us();
+ if(ttpool_run(&pool,j.nchunks,countchunk,&j)<0)
+        printf("\nnot all threads could be started, continuing with fewer");
+ tcount = tt_now_us();
+ printf("\npass 1: %.3lf s, %d chunks stolen", (tcount-tstart)/1e6, ttpool_steals(&pool));
+
+ //exclusive prefix sums, entry nchunks holds the totals
+ for(c=0, sum=0; c<=j.nchunks; c++)
+ {
+        t = j.overflows[c];
+        j.overflows[c] = sum;
+        sum += t;
+ }
+ for(c=0, sum=0; c<=j.nchunks; c++)
+ {
+        t = j.events[c];
+        j.events[c] = sum;
+        sum += t;
+ }
+
+ ttpool_run(&pool,j.nchunks,decodechunk,&j);
+ tdecode = tt_now_us();
+ printf("\npass 2: %.3lf s, %d chunks stolen", (tdecode-tcount)/1e6, ttpool_steals(&pool));
+ for(i=0;i<pool.nworkers;i++)
+        error |= j.w[i].error;
+ if(error)
+ {
+        printf("\nfile write error\n");
+        goto ex;
+ }
+
+ printf("\n\n%lld records, %lld overflows, %lld events written to %s",
+        j.map.nrecords, j.overflows[j.nchunks], j.events[j.nchunks], OutFile);
+ printf("\n%.3lf s, %.1lf Mrecords/s\n", (tdecode-tstart)/1e6,
+        tdecode>tstart ? j.map.nrecords/(tdecode-tstart) : 0.0);
+
+ex:
+ if(j.w)
+        for(i=0;i<pool.nworkers;i++)
+        {
+                if(j.w[i].out)
+                        fclose(j.w[i].out);
+                free(j.w[i].ptime);
+                free(j.w[i].pdtime);
+                free(j.w[i].pchan);
+                free(j.w[i].mtime);
+                free(j.w[i].mbits);
+                free(j.w[i].ev);
+        }
+ free(j.w);
+ free(j.overflows);
+ free(j.events);
+ ttpool_free(&pool);
+ ttmap_close(&j.map);
+ return 0;
+}
@@ -0,0 +1,208 @@
+/************************************************************************
+
+  PicoHarp 300    T2 Stream Merge Demo in C
+
+  Merges the T2 output files of several devices (e.g. those written by
+  tttrmulti) into one time-ordered event stream. Each input file may be
+  given a constant time offset in ps to compensate for cable delays or
+  different start times:
+
+        t2merge tttrmode_1012345.out tttrmode_1012346.out@-1500
+
+  The result is written to t2merge.out as a sequence of tt_event records
+  (see ttmerge.h): 64 bit time in ps, device index (position on the
+  command line) and channel, where markers have TT_MARKERFLAG set.
+
+  A file named *.ovc is taken to hold coalesced overflow records (see
+  ttdecode.h).
+
+  With Follow set, the end of an input file is not taken as the end of
+  the stream, so the files can be merged while tttrmulti is still writing
+  them. An input is regarded as finished when it has not grown for
+  FollowIdle milliseconds.
+
+  Note: This is a console application
+
+************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ttport.h"
+#include "ttmerge.h"
+
+
+int Follow = 0; //you can change this, 1 merges files that are still being written
+int FollowIdle = 2000; //you can change this, unit is millisec
+int blocksz = 65536; //you can change this, records read per input at a time
+char OutFile[] = "t2merge.out"; //you can change this
+
+
+typedef struct
+{
+ FILE* fp;
+ long long pos; //bytes, the end of the last whole record read
+ double lastdata; //us
+ double records;
+} fileinput;
+
+
+static int seekto(FILE* fp, long long pos)
+{
+#ifdef _WIN32
+ return _fseeki64(fp, pos, SEEK_SET);
+#else
+ return fseeko(fp, (off_t)pos, SEEK_SET);
+#endif
+}
+
+
+int readfile(void* ctx, unsigned int* buf, int count)
+{
+ fileinput* f = (fileinput*)ctx;
+ int n;
+
+ n = (int)fread(buf,sizeof(unsigned int),count,f->fp);
+ f->pos += n*(long long)sizeof(unsigned int);
+ //at the end fread has taken the bytes of a partial record too; going back
+ //to the last whole record reads it again once it is complete, and clears EOF
+ if(n<count && Follow && seekto(f->fp,f->pos)!=0)
+        return -1;
+ if(n>0)
+ {
+        f->records += n;
+        f->lastdata = tt_now_us();
+        return n;
+ }
+ if(!Follow || tt_now_us()-f->lastdata > FollowIdle*1000.0)
+        return -1;
+ return 0;
+}
+
+
+int main(int argc, char* argv[])
+{
+ tt_merger merger;
+ fileinput in[TT_MERGEMAX];
+ tt_event* events = NULL;
+ FILE* fpout = NULL;
+ char name[1024];
+ char* at;
+ long long offset;
+ double nevents = 0, nrecords = 0, tstart, telapsed, lastreport;
+ long long lasttime = 0;
+ int ninputs = 0, i, n, unordered = 0;
+
+ printf("\nPicoHarp 300 T2 Stream Merge Demo");
+ printf("\n~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+
+ if(argc<2 || argc-1>TT_MERGEMAX)
+ {
+        printf("\nusage: t2merge file[@offset_ps] ...  (up to %d files)\n",TT_MERGEMAX);
+        return -1;
+ }
+
+ if(tt_merge_init(&merger,blocksz)<0)
+ {
+        printf("\ninvalid block size\n");
+        return -1;
+ }
+
+ for(i=1;i<argc;i++)
+ {
+        strncpy(name,argv[i],sizeof(name)-1);
+        name[sizeof(name)-1] = 0;
+        offset = 0;
+        at = strrchr(name,'@');
+        if(at)
+        {
+                *at = 0;
+                offset = atoll(at+1);
+        }
+        in[ninputs].fp = fopen(name,"rb");
+        if(in[ninputs].fp==NULL)
+        {
+                printf("\ncannot open input file %s\n",name);
+                goto ex;
+        }
+        in[ninputs].pos = 0;
+        in[ninputs].lastdata = tt_now_us();
+        in[ninputs].records = 0;
+        ninputs++;
+        if(tt_merge_add(&merger,readfile,&in[ninputs-1],offset)<0)
+        {
+                printf("\nmemory allocation failed\n");
+                goto ex;
+        }
+        merger.in[ninputs-1].state.coalesced = tt_coalesced_name(name);
+        printf("\ninput %d: %s, offset %lld ps",ninputs-1,name,offset);
+ }
+
+ if((fpout = fopen(OutFile,"wb"))==NULL)
+ {
+        printf("\ncannot open output file %s\n",OutFile);
+        goto ex;
+ }
+
+ events = (tt_event*)malloc(blocksz*sizeof(tt_event));
+ if(events==NULL)
+ {
+        printf("\nmemory allocation failed\n");
+        goto ex;
+ }
+
+ printf("\n\nmerging to %s ...\n",OutFile);
+ tstart = lastreport = tt_now_us();
+
+ while(1)
+ {
+        n = tt_merge_next(&merger,events,blocksz);
+        if(n>0)
+        {
+                for(i=0;i<n;i++) //cheap sanity check of the output order
+                {
+                        if(events[i].time<lasttime)
+                                unordered++;
+                        lasttime = events[i].time;
+                }
+                if(fwrite(events,sizeof(tt_event),n,fpout)!=(size_t)n)
+                {
+                        printf("\nfile write error\n");
+                        goto ex;
+                }
+                nevents += n;
+        }
+        else if(tt_merge_done(&merger))
+                break;
+        else
+                tt_sleep_ms(10); //an input is waiting for more data
+
+        if(tt_now_us()-lastreport > 1000000.0)
+        {
+                printf("\r%.0lf events",nevents);
+                fflush(stdout);
+                lastreport = tt_now_us();
+        }
+ }
+
+ telapsed = (tt_now_us()-tstart)/1e6;
+ for(i=0;i<ninputs;i++)
+        nrecords += in[i].records;
+ printf("\r%.0lf records read, %.0lf events written", nrecords, nevents);
+ printf("\n%.3lf s, %.2lf Mevents/s", telapsed, telapsed>0 ? nevents/telapsed/1e6 : 0.0);
+ if(nevents>0)
+        printf("\nlast event at %.6lf s", lasttime/1e12);
+ if(unordered)
+        printf("\nWARNING: %d events out of order", unordered);
+ printf("\n");
+
+ex:
+ tt_merge_free(&merger);
+ for(i=0;i<ninputs;i++)
+        fclose(in[i].fp);
+ if(fpout)
+        fclose(fpout);
+ free(events);
+ return 0;
+}
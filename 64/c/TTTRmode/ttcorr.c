@@ -0,0 +1,191 @@
+/************************************************************************
+
+  Streaming multi-tau correlator for T2 photon times
+
+  See ttcorr.h. With n_X(i) the photons of channel X in bin i of level k,
+  the raw curve is G_XY(k,j) = sum over i of n_X(i) n_Y(i+j), and for
+  uncorrelated photons it would be (M-j) N_X N_Y / M^2 with M the number
+  of bins the complete bins of the level span and N_X, N_Y their photons,
+  which gives the normalization.
+
+************************************************************************/
+
+#include <string.h>
+
+#include "ttcorr.h"
+
+
+//bin b of level k is complete: correlate it with the earlier bins and keep it;
+//next is the bin that follows
+static void closebin(ttcorr_level* l, int k, const ttcorr_bin* b, long long next)
+{
+ const ttcorr_bin* h;
+ int jmin = k ? TT_CORRP/2 : 0;
+ int m, idx;
+ long long j;
+
+ if(!l->closed)
+ {
+        l->first = b->bin;
+        l->closed = 1;
+ }
+ l->last = b->bin;
+ l->na += b->na;
+ l->nb += b->nb;
+ if(k==0) //pairs within one base bin
+        l->g[TT_CORR_AB][0] += (double)b->na * b->nb;
+
+ //a bin without neighbours within P bins on either side, as nearly all at the fine
+ //levels, has nothing to correlate with now or later, so it need not be kept either
+ if(next - b->bin >= TT_CORRP
+    && (!l->nhist || b->bin - l->hist[(l->histpos + TT_CORRP - 1) % TT_CORRP].bin >= TT_CORRP))
+        return;
+
+ for(m=0, idx=l->histpos; m<l->nhist; m++) //newest first
+ {
+        idx = (idx + TT_CORRP - 1) % TT_CORRP;
+        h = &l->hist[idx];
+        j = b->bin - h->bin;
+        if(j >= TT_CORRP)
+                break;
+        if(j < jmin)
+                continue;
+        l->g[TT_CORR_AA][j] += (double)h->na * b->na;
+        l->g[TT_CORR_BB][j] += (double)h->nb * b->nb;
+        l->g[TT_CORR_AB][j] += (double)h->na * b->nb;
+        l->g[TT_CORR_BA][j] += (double)h->nb * b->na;
+ }
+ l->hist[l->histpos] = *b;
+ l->histpos = (l->histpos + 1) % TT_CORRP;
+ if(l->nhist < TT_CORRP)
+        l->nhist++;
+}
+
+
+//counts photons into bin of level 0; every bin this completes is merged into the next level
+static void addbin(ttcorr* c, long long bin, unsigned int na, unsigned int nb)
+{
+ ttcorr_level* l;
+ ttcorr_bin b;
+ int k;
+
+ for(k=0;k<TT_CORRLEVELS;k++)
+ {
+        l = &c->level[k];
+        if(l->hascur && l->cur.bin==bin)
+        {
+                l->cur.na += na;
+                l->cur.nb += nb;
+                return;
+        }
+        if(!l->hascur)
+        {
+                l->cur.bin = bin;
+                l->cur.na = na;
+                l->cur.nb = nb;
+                l->hascur = 1;
+                return;
+        }
+        b = l->cur;
+        l->cur.bin = bin;
+        l->cur.na = na;
+        l->cur.nb = nb;
+        closebin(l, k, &b, bin);
+        bin = b.bin >> 1;
+        na = b.na;
+        nb = b.nb;
+ }
+}
+
+
+int tt_corr_init(ttcorr* c, int chana, int chanb, int base_ps)
+{
+ memset(c, 0, sizeof(ttcorr));
+ if(base_ps<1)
+        return -1;
+ c->chana = chana;
+ c->chanb = chanb;
+ c->base = base_ps;
+ tt_mutex_init(&c->lock);
+ return 0;
+}
+
+
+void tt_corr_free(ttcorr* c)
+{
+ tt_mutex_destroy(&c->lock);
+}
+
+
+void tt_corr_add(ttcorr* c, const unsigned long long* time, const unsigned char* chan, int n)
+{
+ unsigned int na, nb;
+ int i;
+
+ tt_mutex_lock(&c->lock);
+ for(i=0;i<n;i++)
+ {
+        na = chan[i]==c->chana;
+        nb = chan[i]==c->chanb;
+        if(!na && !nb)
+                continue;
+        c->na += na;
+        c->nb += nb;
+        addbin(c, (long long)(time[i] / c->base), na, nb);
+ }
+ tt_mutex_unlock(&c->lock);
+}
+
+
+//number of bins the complete bins of level k span, 0 for none yet
+static long long spanbins(ttcorr_level* l)
+{
+ return l->closed ? l->last - l->first + 1 : 0;
+}
+
+
+int tt_corr_lags(ttcorr* c, double* lag_ps)
+{
+ int k, j, n = 0;
+
+ tt_mutex_lock(&c->lock);
+ for(k=0;k<TT_CORRLEVELS;k++)
+        for(j=k ? TT_CORRP/2 : 0; j<TT_CORRP; j++)
+        {
+                if(j >= spanbins(&c->level[k])) //longer than the data
+                        goto done;
+                lag_ps[n++] = (double)j * (1LL<<k) * c->base;
+        }
+done:
+ tt_mutex_unlock(&c->lock);
+ return n;
+}
+
+
+void tt_corr_get(ttcorr* c, int curve, double* g)
+{
+ ttcorr_level* l;
+ double nx, ny, m;
+ int k, j, n = 0;
+
+ tt_mutex_lock(&c->lock);
+ for(k=0;k<TT_CORRLEVELS;k++)
+ {
+        l = &c->level[k];
+        m = (double)spanbins(l);
+        nx = (curve==TT_CORR_BB || curve==TT_CORR_BA) ? l->nb : l->na;
+        ny = (curve==TT_CORR_AA || curve==TT_CORR_BA) ? l->na : l->nb;
+        for(j=k ? TT_CORRP/2 : 0; j<TT_CORRP; j++)
+        {
+                if(j >= m)
+                        goto done;
+                if(nx>0 && ny>0)
+                        g[n] = l->g[curve][j] * m * m / ((m - j) * nx * ny);
+                else
+                        g[n] = 0;
+                n++;
+        }
+ }
+done:
+ tt_mutex_unlock(&c->lock);
+}
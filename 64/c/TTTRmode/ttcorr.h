@@ -0,0 +1,82 @@
+/************************************************************************
+
+  Streaming multi-tau correlator for T2 photon times
+
+  Computes the auto-correlations of two channels A and B and their cross-
+  correlation (positive and negative lags, for antibunching) from photon
+  times as they come in, with logarithmically spaced lags from the base
+  bin width up to seconds.
+
+  The photons are counted in bins of the base width. Level k uses bins of
+  base*2^k and holds the lags j = P/2..P-1 of that width (level 0 holds
+  j = 0..P-1), i.e. the usual multi-tau scheme. Only non-empty bins are
+  stored and processed: when a bin of level k is complete it is
+  correlated with the non-empty bins of the last P at that level and
+  then merged into the current bin of level k+1. At fine levels nearly
+  every photon has a bin of its own and there is hardly anything to
+  correlate with; at coarse levels bins close only once per bin width.
+  So memory is fixed (levels * P bins) and the cost per photon does not
+  grow with the measurement time.
+
+  Adding and reading the curves may happen in different threads.
+
+************************************************************************/
+
+#ifndef TTCORR_H
+#define TTCORR_H
+
+#include "ttport.h"
+
+#define TT_CORRP       16            //lags per level, even
+#define TT_CORRLEVELS  48            //base*2^47*16 covers any measurement
+
+//curves
+#define TT_CORR_AA     0
+#define TT_CORR_BB     1
+#define TT_CORR_AB     2             //B after A, lag >= 0
+#define TT_CORR_BA     3             //A after B, i.e. AB at negative lags; lag 0 is in AB only
+
+typedef struct
+{
+ long long bin;
+ unsigned int na, nb;
+} ttcorr_bin;
+
+typedef struct
+{
+ ttcorr_bin cur;                     //bin being filled
+ int hascur;
+ ttcorr_bin hist[TT_CORRP];          //last non-empty complete bins, ring
+ int histpos;                        //next write position
+ int nhist;
+ double g[4][TT_CORRP];              //raw pair counts per curve and lag index
+ double na, nb;                      //photons in the complete bins, for the normalization
+ long long first, last;              //first and last complete bin
+ int closed;
+} ttcorr_level;
+
+typedef struct
+{
+ int chana, chanb;
+ long long base;                     //ps
+ tt_mutex lock;
+
+ double na, nb;                      //photons
+
+ ttcorr_level level[TT_CORRLEVELS];
+} ttcorr;
+
+//returns 0 or -1
+int  tt_corr_init(ttcorr* c, int chana, int chanb, int base_ps);
+void tt_corr_free(ttcorr* c);
+
+//adds n photons in time order, e.g. the output of tt_decode_t2
+void tt_corr_add(ttcorr* c, const unsigned long long* time, const unsigned char* chan, int n);
+
+//lag times in ps of all curves, returns their number (at most TT_CORRLEVELS*TT_CORRP)
+int  tt_corr_lags(ttcorr* c, double* lag_ps);
+//normalized correlation g(lag) of one curve, 1 for uncorrelated photons;
+//the bins still open are left out, so recent photons count a little later
+void tt_corr_get(ttcorr* c, int curve, double* g);
+
+#endif
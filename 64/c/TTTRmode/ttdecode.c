@@ -0,0 +1,440 @@
+/************************************************************************
+
+  Streaming decoder for PicoHarp 300 TTTR records
+
+  See ttdecode.h. The vectorized paths are compiled with a per-function
+  target attribute (gcc/clang) or directly (MSVC 2013 and later), so no
+  special compiler flags are needed; whether they are used is decided at
+  run time from the CPU features.
+
+************************************************************************/
+
+#include <stddef.h>
+#include <string.h>
+
+#include "ttdecode.h"
+
+#if (defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))) || \
+    (defined(_MSC_VER) && _MSC_VER>=1800 && (defined(_M_X64) || defined(_M_IX86)))
+#define TT_HAVE_AVX2
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#ifdef __GNUC__
+#define TT_AVX2 __attribute__((target("avx2")))
+#else
+#define TT_AVX2
+#endif
+
+#ifdef _MSC_VER
+#define TT_INLINE static __inline
+#else
+#define TT_INLINE static inline
+#endif
+
+
+static int SimdEnabled = -1;  //-1 means not yet checked
+
+
+static int cpuhasavx2(void)
+{
+#if !defined(TT_HAVE_AVX2)
+ return 0;
+#elif defined(_MSC_VER)
+ int info[4];
+
+ __cpuid(info, 0);
+ if(info[0]<7)
+        return 0;
+ __cpuid(info, 1);
+ if(!(info[2] & (1<<27)) || !(info[2] & (1<<28)))  //OSXSAVE and AVX
+        return 0;
+ if((_xgetbv(0) & 6) != 6)                          //OS saves the YMM registers
+        return 0;
+ __cpuidex(info, 7, 0);
+ return (info[1] & (1<<5)) != 0;
+#else
+ __builtin_cpu_init();
+ return __builtin_cpu_supports("avx2");
+#endif
+}
+
+
+int tt_decode_hassimd(void)
+{
+ return cpuhasavx2();
+}
+
+
+void tt_decode_setsimd(int enable)
+{
+ SimdEnabled = enable && cpuhasavx2();
+}
+
+
+TT_INLINE int usesimd(void)
+{
+ if(SimdEnabled<0)
+        SimdEnabled = cpuhasavx2();
+ return SimdEnabled;
+}
+
+
+int tt_coalesced_name(const char* path)
+{
+ size_t n = strlen(path), k = strlen(TT_COALESCEDEXT);
+
+ return n>=k && strcmp(path+n-k, TT_COALESCEDEXT)==0;
+}
+
+
+/******************************** T2 ***********************************/
+
+void tt_t2_init(tt_t2state* s)
+{
+ s->ofltime = 0;
+ s->coalesced = 0;
+}
+
+
+typedef struct
+{
+ unsigned long long* time;
+ unsigned char* chan;
+ unsigned long long* mtime;
+ unsigned char* mbits;
+ int np;
+ int nm;
+ int coalesced;
+} t2out;
+
+
+TT_INLINE void t2_scalar(unsigned long long* ofltime, const unsigned int* rec, int n, t2out* o)
+{
+ unsigned long long ofl = *ofltime;
+ unsigned int r, chan, tag;
+ int i;
+
+ for(i=0;i<n;i++)
+ {
+        r = rec[i];
+        chan = r >> 28;
+        tag = r & 0x0FFFFFFF;
+        if(chan==0xF)
+        {
+                if((tag & 0xF)==0)
+                        ofl += (unsigned long long)TT_T2WRAPAROUND * TT_T2OVERFLOWS(tag, o->coalesced);
+                else if(o->mtime)
+                {
+                        //the low time bits carry the markers, so the marker time is 16 units coarse
+                        o->mtime[o->nm] = (ofl + (tag & ~0xFu)) * TT_T2RESOLUTION;
+                        o->mbits[o->nm] = (unsigned char)(tag & 0xF);
+                        o->nm++;
+                }
+                continue;
+        }
+        o->time[o->np] = (ofl + tag) * TT_T2RESOLUTION;
+        o->chan[o->np] = (unsigned char)chan;
+        o->np++;
+ }
+ *ofltime = ofl;
+}
+
+
+#ifdef TT_HAVE_AVX2
+
+TT_AVX2 static void t2_avx2(unsigned long long* ofltime, const unsigned int* rec, int n, t2out* o)
+{
+ const __m256i tagmask = _mm256_set1_epi32(0x0FFFFFFF);
+ const __m256i special = _mm256_set1_epi32(0xF);
+ //gathers the low byte of each 32 bit lane into the low 8 bytes
+ const __m256i bytesel = _mm256_setr_epi8(0,4,8,12,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+                                          0,4,8,12,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+ const __m256i lanesel = _mm256_setr_epi32(0,4,1,1,1,1,1,1);
+ __m256i v, chan, tags, base, lo, hi, packed;
+ int i, mask;
+
+ for(i=0;i+8<=n;i+=8)
+ {
+        v = _mm256_loadu_si256((const __m256i*)(rec+i));
+        chan = _mm256_srli_epi32(v, 28);
+        mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(chan, special)));
+        if(mask)
+        {
+                t2_scalar(ofltime, rec+i, 8, o);
+                continue;
+        }
+        tags = _mm256_and_si256(v, tagmask);
+        base = _mm256_set1_epi64x((long long)*ofltime);
+        lo = _mm256_add_epi64(base, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(tags)));
+        hi = _mm256_add_epi64(base, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(tags, 1)));
+        //TT_T2RESOLUTION is 4
+        lo = _mm256_slli_epi64(lo, 2);
+        hi = _mm256_slli_epi64(hi, 2);
+        _mm256_storeu_si256((__m256i*)(o->time + o->np), lo);
+        _mm256_storeu_si256((__m256i*)(o->time + o->np + 4), hi);
+        packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(chan, bytesel), lanesel);
+        _mm_storel_epi64((__m128i*)(o->chan + o->np), _mm256_castsi256_si128(packed));
+        o->np += 8;
+ }
+ if(i<n)
+        t2_scalar(ofltime, rec+i, n-i, o);
+}
+
+#endif
+
+
+int tt_decode_t2(tt_t2state* s, const unsigned int* rec, int n,
+                 unsigned long long* time, unsigned char* chan,
+                 unsigned long long* mtime, unsigned char* mbits, int* nmarkers)
+{
+ t2out o;
+
+ o.time = time;
+ o.chan = chan;
+ o.mtime = mbits ? mtime : NULL;
+ o.mbits = mbits;
+ o.np = 0;
+ o.nm = 0;
+ o.coalesced = s->coalesced;
+
+#ifdef TT_HAVE_AVX2
+ if(usesimd())
+        t2_avx2(&s->ofltime, rec, n, &o);
+ else
+#endif
+        t2_scalar(&s->ofltime, rec, n, &o);
+
+ if(nmarkers)
+        *nmarkers = o.nm;
+ return o.np;
+}
+
+
+long long tt_overflows_t2(const unsigned int* rec, int n, int coalesced, int* nrecords)
+{
+ long long wraps = 0;
+ int i, k = 0;
+
+ for(i=0;i<n;i++)
+        if((rec[i] >> 28)==0xF && (rec[i] & 0xF)==0)
+        {
+                wraps += TT_T2OVERFLOWS(rec[i], coalesced);
+                k++;
+        }
+ if(nrecords)
+        *nrecords = k;
+ return wraps;
+}
+
+
+/******************************** T3 ***********************************/
+
+void tt_t3_init(tt_t3state* s)
+{
+ s->ofltime = 0;
+ s->coalesced = 0;
+}
+
+
+typedef struct
+{
+ unsigned long long* nsync;
+ unsigned short* dtime;
+ unsigned char* chan;
+ unsigned long long* msync;
+ unsigned char* mbits;
+ int np;
+ int nm;
+ int coalesced;
+} t3out;
+
+
+TT_INLINE void t3_scalar(unsigned long long* ofltime, const unsigned int* rec, int n, t3out* o)
+{
+ unsigned long long ofl = *ofltime;
+ unsigned int r, chan, dtime;
+ int i;
+
+ for(i=0;i<n;i++)
+ {
+        r = rec[i];
+        chan = r >> 28;
+        dtime = (r >> 16) & 0xFFF;
+        if(chan==0xF)
+        {
+                if((dtime & 0xF)==0)
+                        ofl += (unsigned long long)TT_T3WRAPAROUND * TT_T3OVERFLOWS(r, o->coalesced);
+                else if(o->msync)
+                {
+                        o->msync[o->nm] = ofl + (r & 0xFFFF);
+                        o->mbits[o->nm] = (unsigned char)(dtime & 0xF);
+                        o->nm++;
+                }
+                continue;
+        }
+        o->nsync[o->np] = ofl + (r & 0xFFFF);
+        o->dtime[o->np] = (unsigned short)dtime;
+        o->chan[o->np] = (unsigned char)chan;
+        o->np++;
+ }
+ *ofltime = ofl;
+}
+
+
+#ifdef TT_HAVE_AVX2
+
+TT_AVX2 static void t3_avx2(unsigned long long* ofltime, const unsigned int* rec, int n, t3out* o)
+{
+ const __m256i syncmask = _mm256_set1_epi32(0xFFFF);
+ const __m256i dtimemask = _mm256_set1_epi32(0xFFF);
+ const __m256i special = _mm256_set1_epi32(0xF);
+ const __m256i bytesel = _mm256_setr_epi8(0,4,8,12,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+                                          0,4,8,12,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1);
+ const __m256i lanesel = _mm256_setr_epi32(0,4,1,1,1,1,1,1);
+ __m256i v, chan, sync, dt, base, packed;
+ int i, mask;
+
+ for(i=0;i+8<=n;i+=8)
+ {
+        v = _mm256_loadu_si256((const __m256i*)(rec+i));
+        chan = _mm256_srli_epi32(v, 28);
+        mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(chan, special)));
+        if(mask)
+        {
+                t3_scalar(ofltime, rec+i, 8, o);
+                continue;
+        }
+        sync = _mm256_and_si256(v, syncmask);
+        base = _mm256_set1_epi64x((long long)*ofltime);
+        _mm256_storeu_si256((__m256i*)(o->nsync + o->np),
+                _mm256_add_epi64(base, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(sync))));
+        _mm256_storeu_si256((__m256i*)(o->nsync + o->np + 4),
+                _mm256_add_epi64(base, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(sync, 1))));
+        //pack the 8 dtimes to 16 bit, packus works per 128 bit lane, so gather the lanes after
+        dt = _mm256_and_si256(_mm256_srli_epi32(v, 16), dtimemask);
+        dt = _mm256_permute4x64_epi64(_mm256_packus_epi32(dt, dt), 0xD8);
+        _mm_storeu_si128((__m128i*)(o->dtime + o->np), _mm256_castsi256_si128(dt));
+        packed = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(chan, bytesel), lanesel);
+        _mm_storel_epi64((__m128i*)(o->chan + o->np), _mm256_castsi256_si128(packed));
+        o->np += 8;
+ }
+ if(i<n)
+        t3_scalar(ofltime, rec+i, n-i, o);
+}
+
+#endif
+
+
+int tt_decode_t3(tt_t3state* s, const unsigned int* rec, int n,
+                 unsigned long long* nsync, unsigned short* dtime, unsigned char* chan,
+                 unsigned long long* msync, unsigned char* mbits, int* nmarkers)
+{
+ t3out o;
+
+ o.nsync = nsync;
+ o.dtime = dtime;
+ o.chan = chan;
+ o.msync = mbits ? msync : NULL;
+ o.mbits = mbits;
+ o.np = 0;
+ o.nm = 0;
+ o.coalesced = s->coalesced;
+
+#ifdef TT_HAVE_AVX2
+ if(usesimd())
+        t3_avx2(&s->ofltime, rec, n, &o);
+ else
+#endif
+        t3_scalar(&s->ofltime, rec, n, &o);
+
+ if(nmarkers)
+        *nmarkers = o.nm;
+ return o.np;
+}
+
+
+long long tt_overflows_t3(const unsigned int* rec, int n, int coalesced, int* nrecords)
+{
+ long long wraps = 0;
+ int i, k = 0;
+
+ for(i=0;i<n;i++)
+        if((rec[i] >> 28)==0xF && (rec[i] & 0xF0000)==0)
+        {
+                wraps += TT_T3OVERFLOWS(rec[i], coalesced);
+                k++;
+        }
+ if(nrecords)
+        *nrecords = k;
+ return wraps;
+}
+
+
+/**************************** Coalescing *******************************/
+
+void tt_coalesce_init_t2(tt_coalescer* c)
+{
+ c->run = 0;
+ c->max = TT_T2OVERFLOWMAX;
+ c->countshift = 4;
+ c->markershift = 0;
+}
+
+
+void tt_coalesce_init_t3(tt_coalescer* c)
+{
+ c->run = 0;
+ c->max = TT_T3OVERFLOWMAX;
+ c->countshift = 0;
+ c->markershift = 16;
+}
+
+
+//a single overflow is written as the device does, with count 0
+TT_INLINE unsigned int overflowrecord(tt_coalescer* c)
+{
+ return 0xF0000000u | (c->run>1 ? c->run << c->countshift : 0);
+}
+
+
+int tt_coalesce(tt_coalescer* c, const unsigned int* rec, int n, unsigned int* out)
+{
+ unsigned int r;
+ int i, m = 0;
+
+ for(i=0;i<n;i++)
+ {
+        r = rec[i];
+        if((r >> 28)==0xF && ((r >> c->markershift) & 0xF)==0)
+        {
+                if(c->run==c->max) //full, this one goes on with the next record
+                {
+                        out[m++] = overflowrecord(c);
+                        c->run = 0;
+                }
+                c->run++;
+                continue;
+        }
+        if(c->run)
+        {
+                out[m++] = overflowrecord(c);
+                c->run = 0;
+        }
+        out[m++] = r;
+ }
+ return m;
+}
+
+
+int tt_coalesce_flush(tt_coalescer* c, unsigned int* out)
+{
+ if(!c->run)
+        return 0;
+ out[0] = overflowrecord(c);
+ c->run = 0;
+ return 1;
+}
@@ -0,0 +1,121 @@
+/************************************************************************
+
+  Streaming decoder for PicoHarp 300 TTTR records
+
+  Turns the raw records delivered by PH_ReadFiFo into absolute times.
+  The overflow correction is kept in a small state struct, so the blocks
+  of one measurement can be fed in one after another in the order they
+  were read; the result is the same as decoding the whole file at once.
+
+  T2 record: bits 31..28 channel, bits 27..0 time tag in units of 4 ps.
+  Channel 0xF marks special records: with the low 4 time bits zero it is
+  an overflow (the time tag wrapped around), otherwise those bits are
+  the markers that were seen.
+
+  T3 record: bits 31..28 channel, bits 27..16 dtime (start-stop time in
+  units of the resolution), bits 15..0 nsync (sync counter). Channel 0xF
+  again marks special records, with the markers in the low 4 dtime bits;
+  zero markers mean the sync counter wrapped around.
+
+  The device writes one overflow record per wraparound, with the other
+  bits zero (T2 bits 27..4, T3 bits 15..0). A coalesced overflow record
+  (see tt_coalesce) stands for a run of them and holds their number in
+  those bits, where 0 counts as 1 like in the HydraHarp V2 formats. Other
+  readers of PicoQuant files count one wraparound per overflow record, so
+  coalesced records go to files of their own kind, *.ovc instead of *.out,
+  and the decoders below read the counts only when told the records are
+  coalesced; otherwise every overflow record is one wraparound, whatever
+  its other bits hold.
+
+  The decoder uses AVX2 where the CPU has it and falls back to plain C.
+  Blocks without special records, which is the common case at high count
+  rates, are processed 8 records at a time.
+
+************************************************************************/
+
+#ifndef TTDECODE_H
+#define TTDECODE_H
+
+#define TT_T2WRAPAROUND  210698240   //T2 overflow period in units of the T2 resolution
+#define TT_T2RESOLUTION  4           //ps
+#define TT_T3WRAPAROUND  65536       //T3 overflow period in syncs
+
+#define TT_MARKERFLAG    0x80        //in event channels, marks markers; the low bits are the marker bits
+
+//wraparounds an overflow record r stands for, in a coalesced stream or not
+#define TT_T2OVERFLOWS(r,coalesced) ((coalesced) ? (((r) >> 4) & 0xFFFFFF) + (((r) & 0x0FFFFFF0)==0) : 1u)
+#define TT_T3OVERFLOWS(r,coalesced) ((coalesced) ? ((r) & 0xFFFF) + (((r) & 0xFFFF)==0) : 1u)
+#define TT_T2OVERFLOWMAX    0xFFFFFF
+#define TT_T3OVERFLOWMAX    0xFFFF
+
+#define TT_COALESCEDEXT     ".ovc"   //extension of files of coalesced records
+
+//1 if path is a file of coalesced records by its extension, 0 if not
+int tt_coalesced_name(const char* path);
+
+typedef struct
+{
+ unsigned long long ofltime;         //accumulated overflow time in units of TT_T2RESOLUTION
+ int coalesced;                      //1 if the records are coalesced, 0 from tt_t2_init
+} tt_t2state;
+
+void tt_t2_init(tt_t2state* s);
+
+//Decodes n records. Photons go to time (ps) and chan, markers to mtime (ps)
+//and mbits (marker bit mask); each array must have room for n entries.
+//mtime/mbits may be NULL if markers are of no interest.
+//Returns the number of photons, the number of markers is stored in *nmarkers.
+int tt_decode_t2(tt_t2state* s, const unsigned int* rec, int n,
+                 unsigned long long* time, unsigned char* chan,
+                 unsigned long long* mtime, unsigned char* mbits, int* nmarkers);
+
+typedef struct
+{
+ unsigned long long ofltime;         //accumulated overflow in syncs
+ int coalesced;                      //as in tt_t2state
+} tt_t3state;
+
+void tt_t3_init(tt_t3state* s);
+
+//Decodes n records into structure-of-arrays photon data: absolute sync
+//count, dtime and channel. Markers go to msync (absolute sync count) and
+//mbits. Array sizes and return values as for tt_decode_t2.
+int tt_decode_t3(tt_t3state* s, const unsigned int* rec, int n,
+                 unsigned long long* nsync, unsigned short* dtime, unsigned char* chan,
+                 unsigned long long* msync, unsigned char* mbits, int* nmarkers);
+
+//Number of wraparounds among n records, e.g. to find the time base of a
+//part of a file without decoding what comes before it: a decoder whose state
+//has ofltime = overflows before the part * TT_T2WRAPAROUND (TT_T3WRAPAROUND)
+//gives the same times for the part as one that ran through from the start.
+//coalesced as in tt_t2state; *nrecords (may be NULL) gets the number of
+//overflow records, all other records are photons or markers.
+long long tt_overflows_t2(const unsigned int* rec, int n, int coalesced, int* nrecords);
+long long tt_overflows_t3(const unsigned int* rec, int n, int coalesced, int* nrecords);
+
+//Overflow coalescing, for writing: at low count rates nearly all records are
+//overflows, and a run of them becomes a single record. The result must be
+//marked as coalesced wherever it goes, see above.
+typedef struct
+{
+ unsigned int run;                   //wraparounds held back
+ unsigned int max;
+ int countshift, markershift;
+} tt_coalescer;
+
+void tt_coalesce_init_t2(tt_coalescer* c);
+void tt_coalesce_init_t3(tt_coalescer* c);
+
+//Copies n records as read from the device to out (room for n+1) with every
+//run of overflow records replaced by one coalesced record. A run at the end is held back, as it may
+//go on in the next block. Returns the number of records in out.
+int tt_coalesce(tt_coalescer* c, const unsigned int* rec, int n, unsigned int* out);
+//Puts the run held back, if any, to out; returns the number of records (0 or 1).
+int tt_coalesce_flush(tt_coalescer* c, unsigned int* out);
+
+//SIMD control, mainly for benchmarking: returns 1 if the vectorized code
+//path is available on this CPU, and lets it be switched off
+int  tt_decode_hassimd(void);
+void tt_decode_setsimd(int enable);
+
+#endif
@@ -0,0 +1,365 @@
+/************************************************************************
+
+  Direct-I/O file writer
+
+  See ttdio.h. The buffers go round in a ring: the caller fills them in
+  order, the I/O threads take any filled one, the one with the lowest
+  offset first, and give it back when it is on disk.
+
+************************************************************************/
+
+#ifndef _WIN32
+#define _GNU_SOURCE                  //O_DIRECT, fallocate
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#else
+#include <malloc.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ttdio.h"
+
+#define BUF_FREE    0
+#define BUF_FILLED  1
+#define BUF_BUSY    2
+
+
+static void* alignedalloc(size_t size)
+{
+#ifdef _WIN32
+ return _aligned_malloc(size, TTDIO_ALIGN);
+#else
+ void* p;
+
+ return posix_memalign(&p, TTDIO_ALIGN, size)==0 ? p : NULL;
+#endif
+}
+
+
+static void alignedfree(void* p)
+{
+#ifdef _WIN32
+ _aligned_free(p);
+#else
+ free(p);
+#endif
+}
+
+
+//returns 1 if all of data is on its way to disk
+#ifdef _WIN32
+static int writeat(ttdio_writer* w, const unsigned char* data, size_t len, long long offset, HANDLE ev)
+{
+ OVERLAPPED ov;
+ DWORD done = 0;
+
+ memset(&ov, 0, sizeof(ov));
+ ov.Offset = (DWORD)offset;
+ ov.OffsetHigh = (DWORD)(offset >> 32);
+ ov.hEvent = ev;
+ if(!WriteFile(w->h, data, (DWORD)len, NULL, &ov) && GetLastError()!=ERROR_IO_PENDING)
+        return 0;
+ if(!GetOverlappedResult(w->h, &ov, &done, TRUE))
+        return 0;
+ return done==(DWORD)len;
+}
+#else
+static int writeat(ttdio_writer* w, const unsigned char* data, size_t len, long long offset)
+{
+ ssize_t k;
+
+ while(len>0)
+ {
+        k = pwrite(w->fd, data, len, (off_t)offset);
+        if(k<0)
+        {
+                if(errno==EINTR)
+                        continue;
+                return 0;
+        }
+        data += k;
+        len -= (size_t)k;
+        offset += k;
+ }
+ return 1;
+}
+#endif
+
+
+static TT_THREADFUNC(iothread)
+{
+ ttdio_writer* w = (ttdio_writer*)arg;
+ ttdio_buf* b;
+ double t;
+ int i, ok, more;
+#ifdef _WIN32
+ HANDLE ev = CreateEvent(NULL, TRUE, FALSE, NULL);
+#endif
+
+ for(;;)
+ {
+        b = NULL;
+        more = 0;
+        tt_mutex_lock(&w->lock);
+        for(i=0;i<w->nbufs;i++)
+                if(w->bufs[i].state==BUF_FILLED)
+                {
+                        if(b)
+                                more = 1;
+                        if(b==NULL || w->bufs[i].offset < b->offset)
+                                b = &w->bufs[i];
+                }
+        if(b)
+                b->state = BUF_BUSY;
+        tt_mutex_unlock(&w->lock);
+        if(b==NULL)
+        {
+                if(tt_load_acquire(&w->stop))
+                {
+                        tt_wakeup_set(&w->work); //on to the next thread
+                        break;
+                }
+                tt_wakeup_wait(&w->work, 100);
+                continue;
+        }
+        if(more) //one set wakes one thread, so pass it on
+                tt_wakeup_set(&w->work);
+        t = tt_now_us();
+#ifdef _WIN32
+        ok = writeat(w, b->data, b->len, b->offset, ev);
+#else
+        ok = writeat(w, b->data, b->len, b->offset);
+#endif
+        t = tt_now_us() - t;
+        tt_mutex_lock(&w->lock);
+        ttlat_add(&w->latency, t);
+        if(!ok)
+                w->error = 1;
+        tt_mutex_unlock(&w->lock);
+        tt_store_release(&b->state, BUF_FREE);
+        tt_wakeup_set(&w->freed);
+ }
+#ifdef _WIN32
+ CloseHandle(ev);
+#endif
+ TT_THREADRETURN;
+}
+
+
+//reserves disk space up to at least end, in steps of prealloc; the file size stays
+static void reserve(ttdio_writer* w, long long end)
+{
+ long long newend;
+#ifdef _WIN32
+ FILE_ALLOCATION_INFO ai;
+#endif
+
+ if(w->prealloc<=0 || end<=w->allocated)
+        return;
+ newend = end + w->prealloc;
+#ifdef _WIN32
+ ai.AllocationSize.QuadPart = newend;
+ if(!SetFileInformationByHandle(w->h, FileAllocationInfo, &ai, sizeof(ai)))
+#else
+ if(fallocate(w->fd, FALLOC_FL_KEEP_SIZE, (off_t)w->allocated, (off_t)(newend - w->allocated))!=0)
+#endif
+ {
+        w->prealloc = 0; //not supported here, write without
+        return;
+ }
+ w->allocated = newend;
+}
+
+
+//hands the current buffer to the I/O threads and waits until the next one is free
+static int submit(ttdio_writer* w)
+{
+ ttdio_buf* b = &w->bufs[w->cur];
+ double t;
+
+ b->len = w->fill;
+ if(w->direct && b->len % TTDIO_ALIGN) //only the last one, cut off again in ttdio_close
+ {
+        memset(b->data + b->len, 0, TTDIO_ALIGN - b->len % TTDIO_ALIGN);
+        b->len += TTDIO_ALIGN - b->len % TTDIO_ALIGN;
+ }
+ b->offset = w->offset;
+ reserve(w, b->offset + (long long)b->len);
+ w->offset += (long long)b->len;
+ tt_store_release(&b->state, BUF_FILLED);
+ tt_wakeup_set(&w->work);
+ w->cur = (w->cur + 1) % w->nbufs;
+ w->fill = 0;
+
+ b = &w->bufs[w->cur];
+ if(tt_load_acquire(&b->state)!=BUF_FREE)
+ {
+        w->waits++;
+        t = tt_now_us();
+        while(tt_load_acquire(&b->state)!=BUF_FREE && !w->error)
+                tt_wakeup_wait(&w->freed, 100);
+        w->waittime_us += tt_now_us() - t;
+ }
+ return w->error ? -1 : 0;
+}
+
+
+int ttdio_create(ttdio_writer* w, const char* path, size_t bufsize, int nbufs, int nthreads, long long prealloc)
+{
+ int i;
+
+ memset(w, 0, sizeof(ttdio_writer));
+ if(nbufs<2 || nthreads<1)
+        return -1;
+ w->bufsize = (bufsize + TTDIO_ALIGN-1) / TTDIO_ALIGN * TTDIO_ALIGN;
+ w->nbufs = nbufs;
+ w->prealloc = prealloc>0 ? (prealloc + TTDIO_ALIGN-1) / TTDIO_ALIGN * TTDIO_ALIGN : 0;
+ ttlat_init(&w->latency);
+
+ w->bufs = (ttdio_buf*)calloc(nbufs, sizeof(ttdio_buf));
+ w->threads = (tt_thread*)calloc(nthreads, sizeof(tt_thread));
+ if(w->bufs==NULL || w->threads==NULL)
+        goto fail;
+ for(i=0;i<nbufs;i++)
+        if((w->bufs[i].data = (unsigned char*)alignedalloc(w->bufsize))==NULL)
+                goto fail;
+
+#ifdef _WIN32
+ w->direct = 1;
+ w->h = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                    FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED, NULL);
+ if(w->h==INVALID_HANDLE_VALUE)
+ {
+        w->direct = 0;
+        w->h = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_FLAG_OVERLAPPED, NULL);
+        if(w->h==INVALID_HANDLE_VALUE)
+                goto fail;
+ }
+#else
+ w->direct = 1;
+ w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+ if(w->fd<0 && errno==EINVAL)
+ {
+        w->direct = 0;
+        w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+ }
+ if(w->fd<0)
+        goto fail;
+ //some file systems accept O_DIRECT on open but not on write, so one aligned
+ //block is written here, before any thread uses the file; the data overwrite it
+ memset(w->bufs[0].data, 0, TTDIO_ALIGN);
+ if(w->direct && pwrite(w->fd, w->bufs[0].data, TTDIO_ALIGN, 0)<0)
+ {
+        if(errno!=EINVAL || fcntl(w->fd, F_SETFL, fcntl(w->fd, F_GETFL) & ~O_DIRECT)!=0)
+                goto failopen;
+        w->direct = 0;
+ }
+#endif
+ reserve(w, 1);
+
+ if(tt_wakeup_init(&w->work)<0)
+        goto failopen;
+ if(tt_wakeup_init(&w->freed)<0)
+ {
+        tt_wakeup_destroy(&w->work);
+        goto failopen;
+ }
+ tt_mutex_init(&w->lock);
+ for(w->nthreads=0; w->nthreads<nthreads; w->nthreads++)
+        if(tt_thread_create(&w->threads[w->nthreads], iothread, w)<0)
+                break;
+ if(w->nthreads==0)
+ {
+        tt_mutex_destroy(&w->lock);
+        tt_wakeup_destroy(&w->work);
+        tt_wakeup_destroy(&w->freed);
+        goto failopen;
+ }
+ return 0;
+
+failopen:
+#ifdef _WIN32
+ CloseHandle(w->h);
+#else
+ close(w->fd);
+#endif
+
+fail:
+ if(w->bufs)
+        for(i=0;i<nbufs;i++)
+                alignedfree(w->bufs[i].data);
+ free(w->bufs);
+ free(w->threads);
+ memset(w, 0, sizeof(ttdio_writer));
+ return -1;
+}
+
+
+int ttdio_write(ttdio_writer* w, const void* data, size_t bytes)
+{
+ const unsigned char* p = (const unsigned char*)data;
+ size_t k;
+
+ while(bytes>0)
+ {
+        if(w->error)
+                return -1;
+        k = w->bufsize - w->fill < bytes ? w->bufsize - w->fill : bytes;
+        memcpy(w->bufs[w->cur].data + w->fill, p, k);
+        w->fill += k;
+        w->size += (long long)k;
+        p += k;
+        bytes -= k;
+        if(w->fill==w->bufsize && submit(w)<0)
+                return -1;
+ }
+ return w->error ? -1 : 0;
+}
+
+
+int ttdio_close(ttdio_writer* w)
+{
+#ifdef _WIN32
+ FILE_END_OF_FILE_INFO eof;
+#endif
+ int i;
+
+ if(w->bufs==NULL)
+        return -1;
+ if(w->fill>0)
+        submit(w);
+ for(i=0;i<w->nbufs;i++)
+        while(tt_load_acquire(&w->bufs[i].state)!=BUF_FREE)
+                tt_wakeup_wait(&w->freed, 100);
+ tt_store_release(&w->stop, 1);
+ tt_wakeup_set(&w->work);
+ for(i=0;i<w->nthreads;i++)
+        tt_thread_join(w->threads[i]);
+ tt_mutex_destroy(&w->lock);
+ tt_wakeup_destroy(&w->work);
+ tt_wakeup_destroy(&w->freed);
+
+ //drops the padding of the last buffer and the space reserved beyond the data
+#ifdef _WIN32
+ eof.EndOfFile.QuadPart = w->size;
+ if(!SetFileInformationByHandle(w->h, FileEndOfFileInfo, &eof, sizeof(eof)))
+        w->error = 1;
+ if(!CloseHandle(w->h))
+        w->error = 1;
+#else
+ if(ftruncate(w->fd, (off_t)w->size)!=0)
+        w->error = 1;
+ if(close(w->fd)!=0)
+        w->error = 1;
+#endif
+ for(i=0;i<w->nbufs;i++)
+        alignedfree(w->bufs[i].data);
+ free(w->bufs);
+ free(w->threads);
+ w->bufs = NULL;
+ w->threads = NULL;
+ return w->error ? -1 : 0;
+}
@@ -0,0 +1,74 @@
+/************************************************************************
+
+  Direct-I/O file writer
+
+  Writes a file past the page cache (O_DIRECT on Linux, unbuffered I/O
+  on Windows), so a long recording does not fill the cache with dirty
+  pages that the kernel then writes back in bursts, which block whoever
+  writes at the time. The data is copied into page-aligned buffers; a
+  full buffer is written at its file position by one of several I/O
+  threads, so a few writes are in flight while the next buffer fills.
+  The file is preallocated ahead of the data (fallocate / file
+  allocation info), which keeps it contiguous and the writes free of
+  block allocation.
+
+  The last, partly filled buffer is written padded to the alignment and
+  the file is then cut to the exact size. Where the file system refuses
+  direct I/O the file is written the same way but through the cache.
+
+************************************************************************/
+
+#ifndef TTDIO_H
+#define TTDIO_H
+
+#include "ttport.h"
+#include "ttlat.h"
+
+#define TTDIO_ALIGN   4096           //buffer address, size and file offset alignment
+
+typedef struct
+{
+ unsigned char* data;
+ size_t len;
+ long long offset;
+ volatile unsigned int state;        //free, filled, being written
+} ttdio_buf;
+
+typedef struct
+{
+#ifdef _WIN32
+ HANDLE h;
+#else
+ int fd;
+#endif
+ int direct;                         //1 if the cache is bypassed, settled before the I/O threads start
+ size_t bufsize;
+ int nbufs;
+ ttdio_buf* bufs;
+ int cur;                            //buffer being filled
+ size_t fill;
+ long long offset;                   //file position of the current buffer
+ long long size;                     //bytes written so far, with the current buffer
+ long long prealloc, allocated;
+
+ int nthreads;
+ tt_thread* threads;
+ tt_mutex lock;
+ tt_wakeup work;                     //a buffer was filled, or stop was set
+ tt_wakeup freed;                    //a buffer is on disk
+ volatile unsigned int stop;
+ int error;
+
+ double waits, waittime_us;          //ttdio_write found the next buffer still in flight
+ ttlat latency;                      //of the device writes, guarded by lock
+} ttdio_writer;
+
+//bufsize is rounded up to TTDIO_ALIGN; nbufs buffers, nthreads I/O threads;
+//prealloc bytes are reserved ahead of the data, 0 for none. Returns 0 or -1.
+int  ttdio_create(ttdio_writer* w, const char* path, size_t bufsize, int nbufs, int nthreads, long long prealloc);
+//copies bytes of data, returns 0 or -1 after a write error
+int  ttdio_write(ttdio_writer* w, const void* data, size_t bytes);
+//writes the rest, waits for all writes, sets the exact size and closes; returns 0 or -1
+int  ttdio_close(ttdio_writer* w);
+
+#endif
@@ -0,0 +1,145 @@
+/************************************************************************
+
+  Online T3 lifetime histograms
+
+  See tthist.h.
+
+************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tthist.h"
+
+#define PENDINGMAX 0x80000000u   //reduce before a private bin could reach 2^32
+
+
+int tthist_init(tthist* h, int nparts, double reduceperiod_ms)
+{
+ memset(h, 0, sizeof(tthist));
+ if(nparts<1)
+        return -1;
+ h->parts = (tthist_part*)calloc(nparts, sizeof(tthist_part));
+ if(h->parts==NULL)
+        return -1;
+ h->nparts = nparts;
+ h->reduceperiod_us = reduceperiod_ms*1000.0;
+ tt_mutex_init(&h->lock);
+ return 0;
+}
+
+
+void tthist_free(tthist* h)
+{
+ if(h->parts)
+ {
+        tt_mutex_destroy(&h->lock);
+        free(h->parts);
+        h->parts = NULL;
+ }
+}
+
+
+void tthist_gate(tthist* h, int startbits, int stopbits)
+{
+ int i;
+
+ h->startbits = startbits & 0xF;
+ h->stopbits = stopbits & 0xF;
+ for(i=0;i<h->nparts;i++)
+        h->parts[i].gateopen = 0;
+}
+
+
+void tthist_add(tthist* h, int part, const unsigned int* rec, int n)
+{
+ tthist_part* p = &h->parts[part];
+ unsigned int r, chan, bits, counted = 0;
+ int i, open;
+
+ if(p->pending + (unsigned int)n >= PENDINGMAX)
+        tthist_reduce(h, part);
+
+ if(!h->startbits && !h->stopbits)
+ {
+        //the common case, the record holds the histogram bin directly
+        for(i=0;i<n;i++)
+        {
+                r = rec[i];
+                chan = (r >> 28) - 1;
+                if(chan < TT_HISTCHANS) //also drops the special records, channel 0xF
+                {
+                        p->counts[chan][(r >> 16) & 0xFFF]++;
+                        counted++;
+                }
+        }
+ }
+ else
+ {
+        open = p->gateopen;
+        for(i=0;i<n;i++)
+        {
+                r = rec[i];
+                chan = (r >> 28) - 1;
+                if(chan < TT_HISTCHANS)
+                {
+                        if(open)
+                        {
+                                p->counts[chan][(r >> 16) & 0xFFF]++;
+                                counted++;
+                        }
+                }
+                else if(chan==0xE) //special record, markers in the low dtime bits, none for an overflow
+                {
+                        bits = (r >> 16) & 0xF;
+                        if(bits & h->stopbits)
+                                open = 0;
+                        if(bits & h->startbits)
+                                open = 1;
+                }
+        }
+        p->gateopen = open;
+ }
+ p->pending += counted;
+
+ if(tt_now_us() - p->lastreduce >= h->reduceperiod_us)
+        tthist_reduce(h, part);
+}
+
+
+void tthist_reduce(tthist* h, int part)
+{
+ tthist_part* p = &h->parts[part];
+ int c, b;
+
+ p->lastreduce = tt_now_us();
+ if(!p->pending)
+        return;
+ tt_mutex_lock(&h->lock);
+ for(c=0;c<TT_HISTCHANS;c++)
+        for(b=0;b<TT_HISTBINS;b++)
+                h->totals[c][b] += p->counts[c][b];
+ h->photons += p->pending;
+ tt_mutex_unlock(&h->lock);
+ memset(p->counts, 0, sizeof(p->counts));
+ p->pending = 0;
+}
+
+
+void tthist_snapshot(tthist* h, unsigned long long hist[TT_HISTCHANS][TT_HISTBINS], double* photons)
+{
+ tt_mutex_lock(&h->lock);
+ memcpy(hist, h->totals, sizeof(h->totals));
+ if(photons)
+        *photons = h->photons;
+ tt_mutex_unlock(&h->lock);
+}
+
+
+void tthist_clear(tthist* h)
+{
+ tt_mutex_lock(&h->lock);
+ memset(h->totals, 0, sizeof(h->totals));
+ h->photons = 0;
+ tt_mutex_unlock(&h->lock);
+}
@@ -0,0 +1,69 @@
+/************************************************************************
+
+  Online T3 lifetime histograms
+
+  Accumulates the dtime histograms of the T3 photon channels 1..4 from
+  raw T3 records while the measurement runs, i.e. what MODE_HIST gives
+  with PH_GetHistogram, but alongside TTTR and optionally gated by the
+  markers: with gating, only photons between a marker with one of the
+  start bits and a marker with one of the stop bits are counted.
+
+  Every thread that adds records owns a part with private 32 bit
+  counters, so adding needs no locks or atomic operations. Now and then
+  (every reduceperiod, and before the private counters could overflow)
+  the owner adds its part to the shared 64 bit totals under a lock.
+  Snapshots are taken from the totals, so they lag by at most one
+  reduce period. Each part must see its records in order, e.g. one part
+  per device or per writer thread, since the marker gate state carries
+  over from one block to the next.
+
+************************************************************************/
+
+#ifndef TTHIST_H
+#define TTHIST_H
+
+#include "ttport.h"
+
+#define TT_HISTBINS   4096           //dtime is 12 bits
+#define TT_HISTCHANS  4              //T3 channels 1..4
+
+typedef struct
+{
+ unsigned int counts[TT_HISTCHANS][TT_HISTBINS];
+ unsigned int pending;               //photons since the last reduce
+ int gateopen;
+ double lastreduce;                  //us
+ char pad[TT_CACHELINE];
+} tthist_part;
+
+typedef struct
+{
+ int nparts;
+ tthist_part* parts;
+ int startbits;                      //marker gating, 0 for none
+ int stopbits;
+ double reduceperiod_us;
+
+ tt_mutex lock;
+ unsigned long long totals[TT_HISTCHANS][TT_HISTBINS];
+ double photons;                     //in the totals
+} tthist;
+
+//returns 0 or -1
+int  tthist_init(tthist* h, int nparts, double reduceperiod_ms);
+void tthist_free(tthist* h);
+
+//counts only photons after a marker with one of startbits and before one with stopbits;
+//call before adding, both 0 switches gating off
+void tthist_gate(tthist* h, int startbits, int stopbits);
+
+//adds n raw T3 records, only called by the thread that owns part
+void tthist_add(tthist* h, int part, const unsigned int* rec, int n);
+//moves the private counts of part to the totals, only called by its owner
+void tthist_reduce(tthist* h, int part);
+
+//copies the totals to hist[TT_HISTCHANS][TT_HISTBINS], any thread
+void tthist_snapshot(tthist* h, unsigned long long hist[TT_HISTCHANS][TT_HISTBINS], double* photons);
+void tthist_clear(tthist* h);
+
+#endif
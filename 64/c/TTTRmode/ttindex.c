@@ -0,0 +1,222 @@
+/************************************************************************
+
+  Sparse time index for raw TTTR record files
+
+  See ttindex.h.
+
+************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ttindex.h"
+
+
+static void writeentry(ttindex_writer* w)
+{
+ if(fwrite(&w->cur, sizeof(ttindex_entry), 1, w->fp)!=1)
+        w->error = 1;
+ w->nextrecord = w->cur.record + w->hdr.everyrecords;
+ w->nexttime = w->cur.lasttime + (unsigned long long)w->hdr.everytime;
+}
+
+
+//writes the header and the entry for the start of the data
+static int startfile(ttindex_writer* w, const char* path)
+{
+ if((w->fp = fopen(path, "wb"))==NULL)
+        return -1;
+ if(fwrite(&w->hdr, sizeof(ttindex_header), 1, w->fp)!=1)
+        w->error = 1;
+ writeentry(w);
+ return 0;
+}
+
+
+int ttindex_create(ttindex_writer* w, const char* path, int mode, int coalesced,
+                   long long everyrecords, double everytime, double unit_ps)
+{
+ memset(w, 0, sizeof(ttindex_writer));
+ if((mode!=MODE_T2 && mode!=MODE_T3) || everyrecords<1)
+        return -1;
+ w->hdr.magic = TTINDEX_MAGIC;
+ w->hdr.version = TTINDEX_VERSION;
+ w->hdr.mode = mode;
+ w->hdr.coalesced = coalesced;
+ w->hdr.everyrecords = everyrecords;
+ w->hdr.everytime = everytime>0 ? everytime : 0;
+ w->hdr.unit_ps = unit_ps;
+ return startfile(w, path);
+}
+
+
+int ttindex_continue(ttindex_writer* w, const char* path)
+{
+ if(w->fp!=NULL)
+        return -1;
+ w->cur.record = 0;
+ w->error = 0;
+ return startfile(w, path);
+}
+
+
+void ttindex_add(ttindex_writer* w, const unsigned int* rec, int n)
+{
+ ttindex_entry* c = &w->cur;
+ unsigned long long t;
+ unsigned int r, chan;
+ int i;
+
+ for(i=0;i<n;i++)
+ {
+        if(c->record>=w->nextrecord || (w->hdr.everytime>0 && c->lasttime>=w->nexttime))
+                writeentry(w);
+        r = rec[i];
+        chan = r >> 28;
+        c->record++;
+        if(w->hdr.mode==MODE_T2)
+        {
+                if(chan==0xF)
+                {
+                        if((r & 0xF)==0)
+                        {
+                                c->ofltime += (unsigned long long)TT_T2WRAPAROUND * TT_T2OVERFLOWS(r, w->hdr.coalesced);
+                                continue;
+                        }
+                        t = (c->ofltime + (r & 0x0FFFFFF0)) * TT_T2RESOLUTION;
+                }
+                else
+                        t = (c->ofltime + (r & 0x0FFFFFFF)) * TT_T2RESOLUTION;
+        }
+        else
+        {
+                if(chan==0xF && (r & 0xF0000)==0)
+                {
+                        c->ofltime += (unsigned long long)TT_T3WRAPAROUND * TT_T3OVERFLOWS(r, w->hdr.coalesced);
+                        continue;
+                }
+                t = c->ofltime + (r & 0xFFFF);
+        }
+        c->counts[chan]++; //channel 0xF is TTINDEX_MARKERS
+        if(t > c->lasttime) //T2 marker times are coarser than photon times
+                c->lasttime = t;
+ }
+}
+
+
+int ttindex_finish(ttindex_writer* w)
+{
+ if(w->fp==NULL)
+        return -1;
+ if(w->cur.record > w->nextrecord - w->hdr.everyrecords) //not already written
+        writeentry(w);
+ if(fclose(w->fp))
+        w->error = 1;
+ w->fp = NULL;
+ return w->error ? -1 : 0;
+}
+
+
+int ttindex_load(ttindex* ix, const char* path)
+{
+ FILE* fp;
+ long size;
+
+ memset(ix, 0, sizeof(ttindex));
+ if((fp = fopen(path, "rb"))==NULL)
+        return -1;
+ if(fread(&ix->hdr, sizeof(ttindex_header), 1, fp)!=1
+    || ix->hdr.magic!=TTINDEX_MAGIC || ix->hdr.version!=TTINDEX_VERSION
+    || fseek(fp, 0, SEEK_END) || (size = ftell(fp))<0)
+        goto fail;
+ ix->n = (int)((size - (long)sizeof(ttindex_header)) / (long)sizeof(ttindex_entry));
+ if(ix->n<1)
+        goto fail;
+ ix->e = (ttindex_entry*)malloc(ix->n * sizeof(ttindex_entry));
+ if(ix->e==NULL || fseek(fp, sizeof(ttindex_header), SEEK_SET)
+    || fread(ix->e, sizeof(ttindex_entry), ix->n, fp)!=(size_t)ix->n)
+        goto fail;
+ fclose(fp);
+ return 0;
+
+fail:
+ fclose(fp);
+ free(ix->e);
+ memset(ix, 0, sizeof(ttindex));
+ return -1;
+}
+
+
+void ttindex_free(ttindex* ix)
+{
+ free(ix->e);
+ memset(ix, 0, sizeof(ttindex));
+}
+
+
+const ttindex_entry* ttindex_find(ttindex* ix, unsigned long long time)
+{
+ int lo = 0, hi = ix->n-1, mid;
+
+ //the last entry with lasttime < time; entry 0 comes before all events
+ while(lo<hi)
+ {
+        mid = (lo + hi + 1) / 2;
+        if(ix->e[mid].lasttime < time)
+                lo = mid;
+        else
+                hi = mid - 1;
+ }
+ return &ix->e[lo];
+}
+
+
+//counts the events before time and returns the record of the first event at or after it
+static long long scanto(ttindex* ix, ttmap* m, unsigned long long time,
+                        unsigned long long counts[TTINDEX_CHANS])
+{
+ const ttindex_entry* e = ttindex_find(ix, time);
+ ttmap_iter it;
+ ttmap_event ev;
+ long long n;
+
+ memcpy(counts, e->counts, sizeof(e->counts));
+ //the next entry has an event at or after time just before it, so the scan ends there
+ n = e < ix->e + ix->n-1 ? (e+1)->record - e->record : -1;
+ ttmap_iter_init(&it, m, ix->hdr.mode, e->record, n, e->ofltime);
+ it.coalesced = ix->hdr.coalesced; //the index knows, whatever the file is called
+ while(ttmap_next(&it, &ev))
+ {
+        if(ev.time>=time)
+                return (long long)(it.p - m->rec) - 1;
+        counts[ev.channel & TT_MARKERFLAG ? TTINDEX_MARKERS : ev.channel]++;
+ }
+ return it.p ? (long long)(it.p - m->rec) : 0;
+}
+
+
+void ttindex_countbefore(ttindex* ix, ttmap* m, unsigned long long time,
+                         unsigned long long counts[TTINDEX_CHANS])
+{
+ scanto(ix, m, time, counts);
+}
+
+
+void ttindex_count(ttindex* ix, ttmap* m, unsigned long long t0, unsigned long long t1,
+                   unsigned long long counts[TTINDEX_CHANS], long long* first, long long* end)
+{
+ unsigned long long c0[TTINDEX_CHANS];
+ long long r0, r1;
+ int i;
+
+ if(t1<t0)
+        t1 = t0;
+ r0 = scanto(ix, m, t0, c0);
+ r1 = scanto(ix, m, t1, counts);
+ for(i=0;i<TTINDEX_CHANS;i++)
+        counts[i] -= c0[i];
+ if(first)
+        *first = r0;
+ if(end)
+        *end = r1;
+}
@@ -0,0 +1,106 @@
+/************************************************************************
+
+  Sparse time index for raw TTTR record files
+
+  A small sidecar file (e.g. tttrmode.out.idx) with one entry every
+  so many records or every so much measurement time, whichever comes
+  first. Each entry holds what a decoder would know on reaching that
+  record: the overflow time so far, the time of the last event before
+  it and the number of events per channel so far. The index can be
+  written while the data is acquired (ttindex_create / ttindex_add /
+  ttindex_finish, see TTTRmode.c) or built afterwards from the file.
+
+  With the index loaded, the place to start decoding for a given time
+  is found by binary search, and decoding can start there right away
+  (seed the decoder state or ttmap_iter with the entry's ofltime). The
+  events per channel in a time window are the difference of two counts
+  at the window edges, each being the count of an entry plus a scan of
+  less than one entry spacing of records.
+
+  Times are in the units of the decoded events: ps in T2, syncs in T3.
+  The file starts with a ttindex_header, then the entries follow; the
+  last entry is at the end of the data.
+
+************************************************************************/
+
+#ifndef TTINDEX_H
+#define TTINDEX_H
+
+#include <stdio.h>
+
+#include "ttmap.h"
+
+#define TTINDEX_MAGIC    0x58445454  //"TTDX"
+#define TTINDEX_VERSION  1
+#define TTINDEX_CHANS    16          //by the 4 bit channel field; markers count in TTINDEX_MARKERS
+#define TTINDEX_MARKERS  15
+
+typedef struct
+{
+ unsigned int magic;
+ unsigned int version;
+ int mode;                           //MODE_T2 or MODE_T3
+ int coalesced;                      //1 if the data are coalesced records (see ttdecode.h)
+ long long everyrecords;             //entry spacing
+ double everytime;                   //in event time units, 0 for none
+ double unit_ps;                     //length of the time unit, 1 in T2, the sync period in T3 (0 if unknown)
+} ttindex_header;
+
+typedef struct
+{
+ long long record;                   //number of the record the entry is at
+ unsigned long long ofltime;         //decoder overflow time before the record (see tt_t2state)
+ unsigned long long lasttime;        //time of the last event before the record, 0 if none
+ unsigned long long counts[TTINDEX_CHANS]; //events before the record
+} ttindex_entry;
+
+
+//writing
+
+typedef struct
+{
+ FILE* fp;
+ ttindex_header hdr;
+ ttindex_entry cur;                  //the state at the current record
+ long long nextrecord;               //where the next entry is due at the latest
+ unsigned long long nexttime;
+ int error;
+} ttindex_writer;
+
+//coalesced as in tt_t2state; returns 0 or -1
+int  ttindex_create(ttindex_writer* w, const char* path, int mode, int coalesced,
+                    long long everyrecords, double everytime, double unit_ps);
+//adds the next n records of the data
+void ttindex_add(ttindex_writer* w, const unsigned int* rec, int n);
+//writes the end entry and closes, returns 0 or -1 if any write failed
+int  ttindex_finish(ttindex_writer* w);
+//after ttindex_finish, starts another index file for the data that follows,
+//e.g. the next file of a segmented recording: record numbers start from 0
+//again, times and counts go on; returns 0 or -1
+int  ttindex_continue(ttindex_writer* w, const char* path);
+
+
+//querying
+
+typedef struct
+{
+ ttindex_header hdr;
+ ttindex_entry* e;
+ int n;
+} ttindex;
+
+//returns 0, or -1 if the file is missing or not an index
+int  ttindex_load(ttindex* ix, const char* path);
+void ttindex_free(ttindex* ix);
+
+//the last entry before all events at or after time, O(log n)
+const ttindex_entry* ttindex_find(ttindex* ix, unsigned long long time);
+
+//events per channel before time, using the data of the indexed file
+void ttindex_countbefore(ttindex* ix, ttmap* m, unsigned long long time,
+                         unsigned long long counts[TTINDEX_CHANS]);
+//events per channel in [t0,t1), and the range of records holding them
+void ttindex_count(ttindex* ix, ttmap* m, unsigned long long t0, unsigned long long t1,
+                   unsigned long long counts[TTINDEX_CHANS], long long* first, long long* end);
+
+#endif
@@ -0,0 +1,127 @@
+/************************************************************************
+
+  Latency histograms
+
+  See ttlat.h. Durations are counted in ns; below 16 ns every value has
+  its own bucket, above that bucket (e-2)*8+s holds the values with the
+  highest bit e and the next three bits s.
+
+************************************************************************/
+
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "ttlat.h"
+
+
+static int log2floor(unsigned long long v)
+{
+#if defined(__GNUC__)
+ return 63 - __builtin_clzll(v);
+#elif defined(_MSC_VER) && defined(_M_X64)
+ unsigned long i;
+
+ _BitScanReverse64(&i, v);
+ return (int)i;
+#else
+ int e = 0;
+
+ while(v >>= 1)
+        e++;
+ return e;
+#endif
+}
+
+
+static int bucket(unsigned long long ns)
+{
+ int e;
+
+ if(ns < 2*TTLAT_SUB)
+        return (int)ns;
+ e = log2floor(ns);
+ if(e >= TTLAT_BUCKETS/TTLAT_SUB + 1)
+        return TTLAT_BUCKETS-1;
+ return (e-2)*TTLAT_SUB + (int)((ns >> (e-3)) & (TTLAT_SUB-1));
+}
+
+
+//the smallest duration above bucket b, in ns
+static double upperedge(int b)
+{
+ int e, s;
+
+ if(b < 2*TTLAT_SUB)
+        return b + 1;
+ e = b/TTLAT_SUB + 2;
+ s = b%TTLAT_SUB;
+ return (double)(TTLAT_SUB + s + 1) * (double)(1ULL << (e-3));
+}
+
+
+void ttlat_init(ttlat* h)
+{
+ memset((void*)h, 0, sizeof(ttlat));
+}
+
+
+void ttlat_add(ttlat* h, double us)
+{
+ unsigned long long ns = us>0 ? (unsigned long long)(us*1000.0) : 0;
+
+ h->counts[bucket(ns)]++;
+ h->n++;
+ h->sum_us += us;
+ if(us > h->max_us)
+        h->max_us = us;
+}
+
+
+void ttlat_merge(ttlat* h, const ttlat* src)
+{
+ int b;
+
+ for(b=0;b<TTLAT_BUCKETS;b++)
+        h->counts[b] += src->counts[b];
+ h->n += src->n;
+ h->sum_us += src->sum_us;
+ if(src->max_us > h->max_us)
+        h->max_us = src->max_us;
+}
+
+
+double ttlat_percentile(const ttlat* h, double p)
+{
+ unsigned long long target, sum = 0;
+ int b;
+
+ if(h->n==0)
+        return 0;
+ if(p>=100)
+        return h->max_us;
+ target = (unsigned long long)(p/100.0 * h->n) + 1;
+ if(target > h->n)
+        target = h->n;
+ for(b=0;b<TTLAT_BUCKETS;b++)
+ {
+        sum += h->counts[b];
+        if(sum >= target)
+                return upperedge(b)/1000.0 < h->max_us ? upperedge(b)/1000.0 : h->max_us;
+ }
+ return h->max_us;
+}
+
+
+double ttlat_mean(const ttlat* h)
+{
+ return h->n ? h->sum_us/h->n : 0;
+}
+
+
+double ttlat_edge(int b)
+{
+ return upperedge(b)/1000.0;
+}
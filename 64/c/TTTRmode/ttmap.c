@@ -0,0 +1,165 @@
+/************************************************************************
+
+  Memory-mapped access to raw TTTR record files
+
+  See ttmap.h.
+
+************************************************************************/
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+#include <string.h>
+
+#include "ttmap.h"
+
+#ifndef _WIN32
+#define PAGESIZE 4096
+#endif
+
+
+int ttmap_open(ttmap* m, const char* path)
+{
+#ifdef _WIN32
+ LARGE_INTEGER size;
+
+ memset(m, 0, sizeof(ttmap));
+ m->coalesced = tt_coalesced_name(path);
+ m->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, NULL, OPEN_EXISTING,
+                       FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+ if(m->file==INVALID_HANDLE_VALUE)
+ {
+        m->file = NULL; //ttmap_close must not close it
+        return -1;
+ }
+ if(!GetFileSizeEx(m->file, &size))
+ {
+        CloseHandle(m->file);
+        m->file = NULL;
+        return -1;
+ }
+ m->size = size.QuadPart;
+ if(m->size<4) //nothing to map
+        return 0;
+ m->mapping = CreateFileMappingA(m->file, NULL, PAGE_READONLY, 0, 0, NULL);
+ if(m->mapping==NULL)
+ {
+        CloseHandle(m->file);
+        m->file = NULL;
+        return -1;
+ }
+ m->rec = (const unsigned int*)MapViewOfFile(m->mapping, FILE_MAP_READ, 0, 0, 0);
+ if(m->rec==NULL)
+ {
+        CloseHandle(m->mapping);
+        CloseHandle(m->file);
+        m->mapping = NULL;
+        m->file = NULL;
+        return -1;
+ }
+#else
+ struct stat st;
+ void* p;
+ int fd;
+
+ memset(m, 0, sizeof(ttmap));
+ m->coalesced = tt_coalesced_name(path);
+ fd = open(path, O_RDONLY);
+ if(fd<0)
+        return -1;
+ if(fstat(fd, &st)<0)
+ {
+        close(fd);
+        return -1;
+ }
+ m->size = (long long)st.st_size;
+ if(m->size<4)
+ {
+        close(fd);
+        return 0;
+ }
+ p = mmap(NULL, (size_t)m->size, PROT_READ, MAP_SHARED, fd, 0);
+ close(fd); //the mapping keeps the file open
+ if(p==MAP_FAILED)
+        return -1;
+ madvise(p, (size_t)m->size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+ madvise(p, (size_t)m->size, MADV_HUGEPAGE); //fails harmlessly where files cannot have huge pages
+#endif
+ m->rec = (const unsigned int*)p;
+#endif
+ m->nrecords = m->size/4;
+ return 0;
+}
+
+
+void ttmap_close(ttmap* m)
+{
+#ifdef _WIN32
+ if(m->rec)
+ {
+        UnmapViewOfFile(m->rec);
+        CloseHandle(m->mapping);
+ }
+ if(m->file)
+        CloseHandle(m->file);
+#else
+ if(m->rec)
+        munmap((void*)m->rec, (size_t)m->size);
+#endif
+ memset(m, 0, sizeof(ttmap));
+}
+
+
+#ifndef _WIN32
+//applies advice to the whole pages of a record range, which may be clipped
+static void advise(ttmap* m, long long first, long long n, int advice)
+{
+ long long from, to;
+
+ if(m->rec==NULL || first<0 || n<=0 || first>=m->nrecords)
+        return;
+ if(n > m->nrecords-first)
+        n = m->nrecords-first;
+ from = first*4 & ~(long long)(PAGESIZE-1);
+ to = (first+n)*4;
+ madvise((char*)m->rec + from, (size_t)(to-from), advice);
+}
+#endif
+
+
+void ttmap_prefetch(ttmap* m, long long first, long long n)
+{
+#ifndef _WIN32
+ advise(m, first, n, MADV_WILLNEED);
+#endif
+}
+
+
+void ttmap_release(ttmap* m, long long first, long long n)
+{
+#ifndef _WIN32
+ //on a read-only file mapping this only unmaps the pages, they stay in the page cache
+ //until the system needs the memory
+ advise(m, first, n, MADV_DONTNEED);
+#endif
+}
+
+
+void ttmap_iter_init(ttmap_iter* it, ttmap* m, int mode, long long first, long long n,
+                     unsigned long long ofltime)
+{
+ if(first<0)
+        first = 0;
+ if(first>m->nrecords)
+        first = m->nrecords;
+ if(n<0 || n>m->nrecords-first)
+        n = m->nrecords-first;
+ it->p = m->rec ? m->rec+first : NULL;
+ it->end = m->rec ? m->rec+first+n : NULL;
+ it->ofltime = ofltime;
+ it->mode = mode;
+ it->coalesced = m->coalesced;
+}
@@ -0,0 +1,124 @@
+/************************************************************************
+
+  Memory-mapped access to raw TTTR record files
+
+  Maps a raw record file as written by TTTRmode (tttrmode.out, or
+  tttrmode.ovc with coalesced overflows) read-only into memory, so the
+  records can be used in place instead of being copied into buffers
+  with fread. The whole file is mapped at once, which on a 64 bit
+  system works for files of any size: the pages are read in on first
+  touch and are page cache, not process memory, so the system can drop
+  them again when RAM runs short. The mapping is hinted for sequential
+  access (and transparent huge pages where the system supports them
+  for files); ranges that are done with can be released early, e.g. by
+  a pass over a file larger than RAM. On Windows only the sequential
+  hint is given, when the file is opened.
+
+  Access is through plain pointers: m.rec[0..m.nrecords-1] are the
+  records, and tt_decode_t2/t3 can be run directly on any part of them.
+  For code that wants one event at a time, ttmap_iter walks a range and
+  decodes in place without any buffers at all.
+
+************************************************************************/
+
+#ifndef TTMAP_H
+#define TTMAP_H
+
+#include "phdefin.h"
+#include "ttport.h"
+#include "ttdecode.h"
+
+typedef struct
+{
+ const unsigned int* rec;            //the records, NULL for an empty file
+ long long nrecords;                 //a trailing partial record is not counted
+ long long size;                     //bytes
+ int coalesced;                      //1 for a file of coalesced records, by its name (see ttdecode.h)
+#ifdef _WIN32
+ HANDLE file, mapping;
+#endif
+} ttmap;
+
+//returns 0 or -1
+int  ttmap_open(ttmap* m, const char* path);
+void ttmap_close(ttmap* m);
+
+//hints that records first..first+n-1 will be needed soon, or not again
+void ttmap_prefetch(ttmap* m, long long first, long long n);
+void ttmap_release(ttmap* m, long long first, long long n);
+
+
+//one event at a time
+
+typedef struct
+{
+ const unsigned int* p;
+ const unsigned int* end;
+ unsigned long long ofltime;         //in TT_T2RESOLUTION units (T2) or syncs (T3)
+ int mode;                           //MODE_T2 or MODE_T3
+ int coalesced;                      //from the ttmap, as in tt_t2state
+} ttmap_iter;
+
+typedef struct
+{
+ unsigned long long time;            //ps in T2, absolute sync count in T3
+ int channel;                        //photon channel, or TT_MARKERFLAG|markers
+ int dtime;                          //T3 only
+} ttmap_event;
+
+//iterates over records first..first+n-1; ofltime is the overflow time before
+//them, 0 for the start of the file (see tt_overflows_t2)
+void ttmap_iter_init(ttmap_iter* it, ttmap* m, int mode, long long first, long long n,
+                     unsigned long long ofltime);
+
+//the next photon or marker, 0 at the end of the range
+TT_INLINE int ttmap_next(ttmap_iter* it, ttmap_event* e)
+{
+ unsigned int r, chan;
+
+ while(it->p < it->end)
+ {
+        r = *it->p++;
+        chan = r >> 28;
+        if(it->mode==MODE_T2)
+        {
+                if(chan==0xF)
+                {
+                        if((r & 0xF)==0)
+                        {
+                                it->ofltime += (unsigned long long)TT_T2WRAPAROUND * TT_T2OVERFLOWS(r, it->coalesced);
+                                continue;
+                        }
+                        e->time = (it->ofltime + (r & 0x0FFFFFF0)) * TT_T2RESOLUTION;
+                        e->channel = TT_MARKERFLAG | (r & 0xF);
+                }
+                else
+                {
+                        e->time = (it->ofltime + (r & 0x0FFFFFFF)) * TT_T2RESOLUTION;
+                        e->channel = (int)chan;
+                }
+                e->dtime = 0;
+        }
+        else
+        {
+                e->dtime = (r >> 16) & 0xFFF;
+                if(chan==0xF)
+                {
+                        if((e->dtime & 0xF)==0)
+                        {
+                                it->ofltime += (unsigned long long)TT_T3WRAPAROUND * TT_T3OVERFLOWS(r, it->coalesced);
+                                continue;
+                        }
+                        e->channel = TT_MARKERFLAG | (e->dtime & 0xF);
+                        e->dtime = 0;
+                }
+                else
+                        e->channel = (int)chan;
+                e->time = it->ofltime + (r & 0xFFFF);
+        }
+        return 1;
+ }
+ return 0;
+}
+
+#endif
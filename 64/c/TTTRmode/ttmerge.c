@@ -0,0 +1,245 @@
+/************************************************************************
+
+  Time-ordered merge of the T2 streams of several devices
+
+  See ttmerge.h. The loser tree keeps the loser of each match in the
+  inner nodes, so after the winner's key changed only the path from its
+  leaf to the root has to be replayed.
+
+************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ttmerge.h"
+
+#define KEY_INF 0x7FFFFFFFFFFFFFFFLL
+#define KEY_MIN (-KEY_INF-1)
+
+
+static long long keyof(tt_merger* m, int i)
+{
+ return i<m->ninputs ? m->in[i].key : KEY_INF;
+}
+
+//strict order on (key, input index) so that equal times come out in input order
+static int less(tt_merger* m, int a, int b)
+{
+ long long ka = keyof(m,a), kb = keyof(m,b);
+
+ return ka<kb || (ka==kb && a<b);
+}
+
+static void build(tt_merger* m)
+{
+ int win[2*TT_MERGEMAX];
+ int i, a, b;
+
+ for(i=0;i<m->nleaves;i++)
+        win[m->nleaves+i] = i;
+ for(i=m->nleaves-1;i>=1;i--)
+ {
+        a = win[2*i];
+        b = win[2*i+1];
+        if(less(m,a,b))
+        {
+                win[i] = a;
+                m->tree[i] = b;
+        }
+        else
+        {
+                win[i] = b;
+                m->tree[i] = a;
+        }
+ }
+ m->tree[0] = win[1];
+}
+
+//the key of input i changed, find the new overall winner
+static void replay(tt_merger* m, int i)
+{
+ int node = (m->nleaves+i) >> 1;
+ int w = i, t;
+
+ while(node>=1)
+ {
+        if(less(m,m->tree[node],w))
+        {
+                t = m->tree[node];
+                m->tree[node] = w;
+                w = t;
+        }
+        node >>= 1;
+ }
+ m->tree[0] = w;
+}
+
+
+int tt_merge_init(tt_merger* m, int blocksz)
+{
+ memset(m, 0, sizeof(tt_merger));
+ if(blocksz<1)
+        return -1;
+ m->blocksz = blocksz;
+ return 0;
+}
+
+
+int tt_merge_add(tt_merger* m, tt_mergesource source, void* ctx, long long offset)
+{
+ tt_mergeinput* s;
+ int n = m->blocksz;
+
+ if(m->started || m->ninputs>=TT_MERGEMAX)
+        return -1;
+ s = &m->in[m->ninputs];
+ memset(s, 0, sizeof(tt_mergeinput));
+ s->source = source;
+ s->ctx = ctx;
+ s->offset = offset;
+ s->key = KEY_MIN; //forces a first read before anything is emitted
+ s->last = KEY_MIN;
+ tt_t2_init(&s->state);
+ s->rec = (unsigned int*)malloc(n*sizeof(unsigned int));
+ s->ptime = (unsigned long long*)malloc(n*sizeof(unsigned long long));
+ s->pchan = (unsigned char*)malloc(n);
+ s->mtime = (unsigned long long*)malloc(n*sizeof(unsigned long long));
+ s->mbits = (unsigned char*)malloc(n);
+ s->ev = (tt_event*)malloc(n*sizeof(tt_event));
+ m->ninputs++;
+ if(!s->rec || !s->ptime || !s->pchan || !s->mtime || !s->mbits || !s->ev)
+        return -1;
+ return 0;
+}
+
+
+void tt_merge_free(tt_merger* m)
+{
+ tt_mergeinput* s;
+ int i;
+
+ for(i=0;i<m->ninputs;i++)
+ {
+        s = &m->in[i];
+        free(s->rec);
+        free(s->ptime);
+        free(s->pchan);
+        free(s->mtime);
+        free(s->mbits);
+        free(s->ev);
+ }
+ m->ninputs = 0;
+}
+
+
+//reads and decodes the next block of an input, returns the number of records read
+static int refill(tt_merger* m, int idx)
+{
+ tt_mergeinput* s = &m->in[idx];
+ long long watermark;
+ int n, np, nm, i, j, k;
+ tt_event* e;
+
+ s->nev = 0;
+ s->pos = 0;
+ n = s->source(s->ctx, s->rec, m->blocksz);
+ if(n<0)
+ {
+        s->finished = 1;
+        s->key = KEY_INF;
+        return 0;
+ }
+
+ if(n>0)
+ {
+        np = tt_decode_t2(&s->state, s->rec, n, s->ptime, s->pchan, s->mtime, s->mbits, &nm);
+
+        //photons and markers are each in time order, zip them together
+        i = j = k = 0;
+        while(i<np || j<nm)
+        {
+                e = &s->ev[k++];
+                e->device = (unsigned char)idx;
+                if(j>=nm || (i<np && s->ptime[i]<=s->mtime[j]))
+                {
+                        e->time = (long long)s->ptime[i] + s->offset;
+                        e->channel = s->pchan[i];
+                        i++;
+                }
+                else
+                {
+                        e->time = (long long)s->mtime[j] + s->offset;
+                        e->channel = TT_MARKERFLAG | s->mbits[j];
+                        j++;
+                }
+        }
+        s->nev = k;
+
+        //coarse marker times may fall before the end of the previous block
+        for(k=0;k<s->nev && s->ev[k].time<s->last;k++)
+                s->ev[k].time = s->last;
+        if(s->nev)
+                s->last = s->ev[s->nev-1].time;
+ }
+
+ if(s->nev)
+        s->key = s->ev[0].time;
+ else
+ {
+        //nothing decoded, but nothing earlier than the current overflow period can follow
+        watermark = (long long)(s->state.ofltime * TT_T2RESOLUTION) + s->offset;
+        if(watermark > s->key)
+                s->key = watermark;
+ }
+ return n;
+}
+
+
+int tt_merge_next(tt_merger* m, tt_event* out, int max)
+{
+ tt_mergeinput* s;
+ int n = 0, w, got;
+
+ if(!m->started)
+ {
+        m->nleaves = 1;
+        while(m->nleaves<m->ninputs)
+                m->nleaves <<= 1;
+        build(m);
+        m->started = 1;
+ }
+
+ while(n<max)
+ {
+        w = m->tree[0];
+        s = &m->in[w];
+        if(w>=m->ninputs || s->key==KEY_INF) //all inputs finished
+                break;
+        if(s->pos<s->nev)
+        {
+                out[n++] = s->ev[s->pos++];
+                //once the block is used up the key stays at the last time,
+                //so this input is refilled before anything later is emitted
+                if(s->pos<s->nev)
+                        s->key = s->ev[s->pos].time;
+                replay(m,w);
+                continue;
+        }
+        got = refill(m,w);
+        replay(m,w);
+        if(got==0 && !s->finished && m->tree[0]==w) //live input without data holds up the merge
+                break;
+ }
+ return n;
+}
+
+
+int tt_merge_done(tt_merger* m)
+{
+ int i;
+
+ for(i=0;i<m->ninputs;i++)
+        if(!m->in[i].finished || m->in[i].pos<m->in[i].nev)
+                return 0;
+ return 1;
+}
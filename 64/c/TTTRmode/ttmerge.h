@@ -0,0 +1,89 @@
+/************************************************************************
+
+  Time-ordered merge of the T2 streams of several devices
+
+  Each input is a raw T2 record stream (e.g. one tttrmode_<serial>.out
+  of tttrmulti) with its own overflow-based time base. The merger decodes
+  every input block by block, shifts its times by a constant per-device
+  offset and emits one globally time-ordered event stream. Selection is
+  done with a loser tree, so each event costs O(log k) comparisons for k
+  inputs, and memory is bounded by one block per input.
+
+  Inputs are read through a callback so that the merger can be fed from
+  files as well as from the acquisition itself. A callback may report
+  "no data yet"; the merger then emits only what is already known to be
+  in order and returns, so it can be run live while data is still coming
+  in. The overflow state of a quiet input is used as a lower bound for
+  its next event, so one idle input does not hold up the others longer
+  than one overflow period.
+
+  Marker times are only 16 time units coarse (see ttdecode.c), so a
+  marker at the start of a block can lie a little before the last photon
+  of the previous block of the same input. Such events are raised to the
+  time of the last event already taken from that input, which keeps the
+  output in order at the cost of moving a marker by less than one marker
+  quantum.
+
+************************************************************************/
+
+#ifndef TTMERGE_H
+#define TTMERGE_H
+
+#include "ttdecode.h"
+
+#define TT_MERGEMAX     64       //maximum number of inputs
+
+typedef struct
+{
+ long long time;                 //ps, device offset applied
+ unsigned char device;           //index of the input
+ unsigned char channel;          //photon channel, or TT_MARKERFLAG|markers
+ unsigned char reserved[6];
+} tt_event;
+
+//reads up to count records into buf; returns the number read,
+//0 if there is no data yet (live input) or -1 at the end of the input
+typedef int (*tt_mergesource)(void* ctx, unsigned int* buf, int count);
+
+typedef struct
+{
+ tt_mergesource source;
+ void* ctx;
+ long long offset;               //ps
+ tt_t2state state;
+ int finished;
+
+ unsigned int* rec;              //raw block
+ unsigned long long* ptime;      //decoded photons
+ unsigned char* pchan;
+ unsigned long long* mtime;      //decoded markers
+ unsigned char* mbits;
+ tt_event* ev;                   //photons and markers of the block in time order
+ int nev;
+ int pos;
+
+ long long key;                  //time of the next event, or a lower bound for it
+ long long last;                 //time of the last event of the previous block
+} tt_mergeinput;
+
+typedef struct
+{
+ int ninputs;
+ int nleaves;                    //ninputs rounded up to a power of two
+ int blocksz;
+ int started;
+ int tree[2*TT_MERGEMAX];        //tree[0] is the winner, tree[1..nleaves-1] the losers
+ tt_mergeinput in[TT_MERGEMAX];
+} tt_merger;
+
+int  tt_merge_init(tt_merger* m, int blocksz);
+int  tt_merge_add(tt_merger* m, tt_mergesource source, void* ctx, long long offset);
+void tt_merge_free(tt_merger* m);
+
+//emits up to max events in time order; returns the number emitted.
+//0 means either that all inputs are finished (see tt_merge_done) or that
+//a live input has to deliver more data first.
+int  tt_merge_next(tt_merger* m, tt_event* out, int max);
+int  tt_merge_done(tt_merger* m);
+
+#endif
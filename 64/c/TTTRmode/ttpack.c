@@ -0,0 +1,587 @@
+/************************************************************************
+
+  Block-compressed container for raw TTTR records
+
+  See ttpack.h. The bit unpacking reads 8 bytes at a time, which assumes
+  a little-endian CPU (x86/x64).
+
+************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "phdefin.h"
+#include "ttdecode.h"
+#include "ttpack.h"
+
+#define GROUP 128
+
+//job states
+#define JOB_FREE    0
+#define JOB_FILLED  1
+#define JOB_BUSY    2
+#define JOB_DONE    3
+
+
+/****************************** coding *********************************/
+
+static int width(unsigned int m)
+{
+ int w = 0;
+
+ while(m)
+ {
+        w++;
+        m >>= 1;
+ }
+ return w;
+}
+
+
+static unsigned char* pack(unsigned char* p, const unsigned int* v, int n, int w)
+{
+ unsigned long long acc = 0;
+ int bits = 0, i;
+
+ if(w==0)
+        return p;
+ for(i=0;i<n;i++)
+ {
+        acc |= (unsigned long long)v[i] << bits;
+        bits += w;
+        while(bits>=8)
+        {
+                *p++ = (unsigned char)acc;
+                acc >>= 8;
+                bits -= 8;
+        }
+ }
+ if(bits>0)
+        *p++ = (unsigned char)acc;
+ return p;
+}
+
+
+static const unsigned char* unpack(const unsigned char* p, unsigned int* v, int n, int w)
+{
+ unsigned long long x;
+ unsigned int mask = (1u << w) - 1;
+ int i, bit;
+
+ if(w==0)
+ {
+        for(i=0;i<n;i++)
+                v[i] = 0;
+        return p;
+ }
+ for(i=0, bit=0; i<n; i++, bit+=w)
+ {
+        memcpy(&x, p + (bit>>3), 8);
+        v[i] = (unsigned int)(x >> (bit & 7)) & mask;
+ }
+ return p + (n*w + 7) / 8;
+}
+
+
+static unsigned char* putvarint(unsigned char* p, unsigned int v)
+{
+ while(v>=0x80)
+ {
+        *p++ = (unsigned char)(v | 0x80);
+        v >>= 7;
+ }
+ *p++ = (unsigned char)v;
+ return p;
+}
+
+
+//NULL if the data is corrupt
+static const unsigned char* getvarint(const unsigned char* p, const unsigned char* end, unsigned int* v)
+{
+ int shift;
+
+ *v = 0;
+ for(shift=0; shift<28; shift+=7)
+ {
+        if(p>=end)
+                return NULL;
+        *v |= (unsigned int)(*p & 0x7F) << shift;
+        if(!(*p++ & 0x80))
+                return p;
+ }
+ return NULL;
+}
+
+
+int ttpack_encode(int mode, const unsigned int* rec, int n, unsigned char* out, int* method)
+{
+ unsigned int delta[GROUP], dtime[GROUP];
+ unsigned int prev = 0, r, tag, dmax, tmax;
+ unsigned char* p = out;
+ int g, i, k, np, w;
+
+ if(mode!=MODE_T2 && mode!=MODE_T3)
+        goto raw;
+
+ for(g=0;g<n;g+=GROUP)
+ {
+        k = n-g < GROUP ? n-g : GROUP;
+        for(i=0;i<k;i+=2)
+                *p++ = (unsigned char)((rec[g+i] >> 28) | (i+1<k ? (rec[g+i+1] >> 28) << 4 : 0));
+
+        np = 0;
+        dmax = 0;
+        tmax = 0;
+        for(i=0;i<k;i++)
+        {
+                r = rec[g+i];
+                if((r >> 28)==0xF)
+                {
+                        p = putvarint(p, r & 0x0FFFFFFF);
+                        continue;
+                }
+                if(mode==MODE_T2)
+                {
+                        tag = r & 0x0FFFFFFF;
+                        if(tag>=TT_T2WRAPAROUND) //not a valid T2 record, the difference would be ambiguous
+                                goto raw;
+                        delta[np] = tag>=prev ? tag-prev : tag + TT_T2WRAPAROUND - prev;
+                }
+                else
+                {
+                        tag = r & 0xFFFF;
+                        delta[np] = (tag - prev) & 0xFFFF;
+                        dtime[np] = (r >> 16) & 0xFFF;
+                        tmax |= dtime[np];
+                }
+                dmax |= delta[np];
+                prev = tag;
+                np++;
+        }
+        w = width(dmax);
+        *p++ = (unsigned char)w;
+        p = pack(p, delta, np, w);
+        if(mode==MODE_T3)
+        {
+                w = width(tmax);
+                *p++ = (unsigned char)w;
+                p = pack(p, dtime, np, w);
+        }
+        if(p - out >= 4*n) //would not get smaller
+                goto raw;
+ }
+ *method = TTPACK_DELTA;
+ return (int)(p - out);
+
+raw:
+ memcpy(out, rec, n*4);
+ *method = TTPACK_RAW;
+ return n*4;
+}
+
+
+int ttpack_decode(int mode, int method, const unsigned char* in, int size, unsigned int* rec, int n)
+{
+ const unsigned char* p = in;
+ const unsigned char* end = in + size;
+ unsigned int chan[GROUP], delta[GROUP], dtime[GROUP];
+ unsigned int prev = 0, v, tag;
+ int g, i, j, k, np, w, wt = 0;
+
+ if(method==TTPACK_RAW)
+ {
+        if(size!=n*4)
+                return -1;
+        memcpy(rec, in, size);
+        return 0;
+ }
+ if(method!=TTPACK_DELTA || (mode!=MODE_T2 && mode!=MODE_T3))
+        return -1;
+
+ for(g=0;g<n;g+=GROUP)
+ {
+        k = n-g < GROUP ? n-g : GROUP;
+        if(p + (k+1)/2 > end)
+                return -1;
+        for(i=0;i<k;i+=2)
+        {
+                chan[i] = *p & 0xF;
+                chan[i+1] = *p++ >> 4; //one beyond k for odd k, harmless
+        }
+
+        np = 0;
+        for(i=0;i<k;i++)
+        {
+                if(chan[i]==0xF)
+                {
+                        if((p = getvarint(p, end, &v))==NULL)
+                                return -1;
+                        rec[g+i] = 0xF0000000 | v;
+                }
+                else
+                        np++;
+        }
+        if(p>=end || (w = *p++)>28 || p + (np*w+7)/8 > end)
+                return -1;
+        p = unpack(p, delta, np, w);
+        if(mode==MODE_T3)
+        {
+                if(p>=end || (wt = *p++)>12 || p + (np*wt+7)/8 > end)
+                        return -1;
+                p = unpack(p, dtime, np, wt);
+        }
+
+        for(i=0, j=0; i<k; i++)
+        {
+                if(chan[i]==0xF)
+                        continue;
+                if(mode==MODE_T2)
+                {
+                        tag = prev + delta[j];
+                        if(tag>=TT_T2WRAPAROUND)
+                                tag -= TT_T2WRAPAROUND;
+                        rec[g+i] = (chan[i] << 28) | (tag & 0x0FFFFFFF);
+                }
+                else
+                {
+                        tag = (prev + delta[j]) & 0xFFFF;
+                        rec[g+i] = (chan[i] << 28) | (dtime[j] << 16) | tag;
+                }
+                prev = tag;
+                j++;
+        }
+ }
+ return p==end ? 0 : -1;
+}
+
+
+/****************************** writing ********************************/
+
+static int seekto(FILE* fp, long long pos)
+{
+#ifdef _WIN32
+ return _fseeki64(fp, pos, SEEK_SET);
+#else
+ return fseeko(fp, (off_t)pos, SEEK_SET);
+#endif
+}
+
+
+static TT_THREADFUNC(packer)
+{
+ ttpack_writer* w = (ttpack_writer*)arg;
+ ttpack_job* j;
+ int i, first, more;
+
+ while(1)
+ {
+        //the oldest filled job first, so the blocks can be written soon
+        j = NULL;
+        more = 0;
+        tt_mutex_lock(&w->lock);
+        first = (int)(w->nextout % w->njobs);
+        for(i=0;i<w->njobs;i++)
+                if(w->jobs[(first+i) % w->njobs].state==JOB_FILLED)
+                {
+                        if(j)
+                        {
+                                more = 1;
+                                break;
+                        }
+                        j = &w->jobs[(first+i) % w->njobs];
+                        j->state = JOB_BUSY;
+                }
+        tt_mutex_unlock(&w->lock);
+        if(j==NULL)
+        {
+                if(tt_load_acquire(&w->stop))
+                {
+                        tt_wakeup_set(&w->work); //on to the next worker
+                        break;
+                }
+                tt_wakeup_wait(&w->work, 100);
+                continue;
+        }
+        if(more) //one set wakes one worker, so pass it on
+                tt_wakeup_set(&w->work);
+        j->size = ttpack_encode(w->mode, j->rec, j->n, j->out, &j->method);
+        tt_store_release(&j->state, JOB_DONE);
+        tt_wakeup_set(&w->done);
+ }
+ TT_THREADRETURN;
+}
+
+
+//writes the coded jobs in order, returns how many
+static int flush(ttpack_writer* w)
+{
+ ttpack_job* j;
+ ttpack_blockheader h;
+ ttpack_direntry* d;
+ int n = 0;
+
+ while(w->nextout < w->nextin)
+ {
+        j = &w->jobs[w->nextout % w->njobs];
+        if(tt_load_acquire(&j->state)!=JOB_DONE)
+                break;
+        if(w->ndir==w->dircap)
+        {
+                d = (ttpack_direntry*)realloc(w->dir, (size_t)(w->dircap*2) * sizeof(ttpack_direntry));
+                if(d==NULL)
+                        w->error = 1;
+                else
+                {
+                        w->dir = d;
+                        w->dircap *= 2;
+                }
+        }
+        h.nrecords = j->n;
+        h.size = j->size;
+        h.method = j->method;
+        h.magic = TTPACK_MAGIC;
+        if(!w->error)
+        {
+                if(fwrite(&h, sizeof(h), 1, w->fp)!=1 || fwrite(j->out, 1, j->size, w->fp)!=(size_t)j->size)
+                        w->error = 1;
+                w->dir[w->ndir].record = w->records;
+                w->dir[w->ndir].offset = w->offset;
+                w->ndir++;
+        }
+        w->records += j->n;
+        w->offset += sizeof(h) + j->size;
+        w->rawbytes += j->n*4.0;
+        w->packedbytes += sizeof(h) + j->size;
+        tt_store_release(&j->state, JOB_FREE);
+        w->nextout++;
+        n++;
+ }
+ return n;
+}
+
+
+int ttpack_create(ttpack_writer* w, const char* path, int mode, int blockrecords, int nworkers, int njobs)
+{
+ ttpack_fileheader h;
+ int i;
+
+ memset(w, 0, sizeof(ttpack_writer));
+ if(blockrecords<1 || njobs<1)
+        return -1;
+ if(nworkers<=0)
+        nworkers = tt_ncpus();
+ w->mode = mode & ~TTPACK_COALESCED; //the coding is the same
+ w->blockrecords = blockrecords;
+ w->njobs = njobs;
+ w->dircap = 1024;
+ w->jobs = (ttpack_job*)calloc(njobs, sizeof(ttpack_job));
+ w->threads = (tt_thread*)calloc(nworkers, sizeof(tt_thread));
+ w->dir = (ttpack_direntry*)malloc(w->dircap * sizeof(ttpack_direntry));
+ if(w->jobs==NULL || w->threads==NULL || w->dir==NULL)
+        goto fail;
+ for(i=0;i<njobs;i++)
+ {
+        w->jobs[i].rec = (unsigned int*)malloc(blockrecords*sizeof(unsigned int));
+        w->jobs[i].out = (unsigned char*)malloc(TTPACK_BOUND(blockrecords));
+        if(w->jobs[i].rec==NULL || w->jobs[i].out==NULL)
+                goto fail;
+ }
+ if((w->fp = fopen(path, "wb"))==NULL)
+        goto fail;
+ h.magic = TTPACK_MAGIC;
+ h.version = TTPACK_VERSION;
+ h.mode = mode;
+ h.blockrecords = blockrecords;
+ if(fwrite(&h, sizeof(h), 1, w->fp)!=1)
+        goto fail;
+ w->offset = sizeof(h);
+
+ if(tt_wakeup_init(&w->work)<0)
+        goto fail;
+ if(tt_wakeup_init(&w->done)<0)
+ {
+        tt_wakeup_destroy(&w->work);
+        goto fail;
+ }
+ tt_mutex_init(&w->lock);
+ for(w->nworkers=0; w->nworkers<nworkers; w->nworkers++) //with none at all, ttpack_write codes itself
+        if(tt_thread_create(&w->threads[w->nworkers], packer, w)<0)
+                break;
+ return 0;
+
+fail:
+ if(w->fp)
+        fclose(w->fp);
+ if(w->jobs)
+        for(i=0;i<njobs;i++)
+        {
+                free(w->jobs[i].rec);
+                free(w->jobs[i].out);
+        }
+ free(w->jobs);
+ free(w->threads);
+ free(w->dir);
+ memset(w, 0, sizeof(ttpack_writer));
+ return -1;
+}
+
+
+int ttpack_write(ttpack_writer* w, const unsigned int* rec, int n)
+{
+ ttpack_job* j;
+ int k;
+
+ while(n>0 && !w->error)
+ {
+        k = n < w->blockrecords ? n : w->blockrecords;
+        j = &w->jobs[w->nextin % w->njobs];
+        if(tt_load_acquire(&j->state)!=JOB_FREE)
+        {
+                w->waits++;
+                while(tt_load_acquire(&j->state)!=JOB_FREE)
+                        if(!flush(w))
+                                tt_wakeup_wait(&w->done, 100);
+        }
+        memcpy(j->rec, rec, k*4);
+        j->n = k;
+        if(w->nworkers)
+        {
+                tt_store_release(&j->state, JOB_FILLED);
+                tt_wakeup_set(&w->work);
+        }
+        else
+        {
+                j->size = ttpack_encode(w->mode, j->rec, j->n, j->out, &j->method);
+                j->state = JOB_DONE;
+        }
+        w->nextin++;
+        rec += k;
+        n -= k;
+ }
+ flush(w);
+ return w->error ? -1 : 0;
+}
+
+
+int ttpack_close(ttpack_writer* w)
+{
+ ttpack_trailer t;
+ int i;
+
+ if(w->fp==NULL)
+        return -1;
+ while(w->nextout < w->nextin)
+        if(!flush(w))
+                tt_wakeup_wait(&w->done, 100);
+ tt_store_release(&w->stop, 1);
+ tt_wakeup_set(&w->work);
+ for(i=0;i<w->nworkers;i++)
+        tt_thread_join(w->threads[i]);
+ tt_mutex_destroy(&w->lock);
+ tt_wakeup_destroy(&w->work);
+ tt_wakeup_destroy(&w->done);
+
+ t.diroffset = w->offset;
+ t.nblocks = w->ndir;
+ t.nrecords = w->records;
+ t.version = TTPACK_VERSION;
+ t.magic = TTPACK_MAGIC;
+ if(!w->error && (fwrite(w->dir, sizeof(ttpack_direntry), (size_t)w->ndir, w->fp)!=(size_t)w->ndir
+                  || fwrite(&t, sizeof(t), 1, w->fp)!=1))
+        w->error = 1;
+ if(fclose(w->fp))
+        w->error = 1;
+ w->fp = NULL;
+
+ for(i=0;i<w->njobs;i++)
+ {
+        free(w->jobs[i].rec);
+        free(w->jobs[i].out);
+ }
+ free(w->jobs);
+ free(w->threads);
+ free(w->dir);
+ w->jobs = NULL;
+ w->threads = NULL;
+ w->dir = NULL;
+ return w->error ? -1 : 0;
+}
+
+
+/****************************** reading ********************************/
+
+int ttpack_open(ttpack_reader* r, const char* path)
+{
+ ttpack_trailer t;
+
+ memset(r, 0, sizeof(ttpack_reader));
+ if((r->fp = fopen(path, "rb"))==NULL)
+        return -1;
+ if(fread(&r->hdr, sizeof(r->hdr), 1, r->fp)!=1 || r->hdr.magic!=TTPACK_MAGIC
+    || r->hdr.version!=TTPACK_VERSION || r->hdr.blockrecords<1)
+        goto fail;
+#ifdef _WIN32
+ if(_fseeki64(r->fp, -(long long)sizeof(t), SEEK_END))
+#else
+ if(fseeko(r->fp, -(off_t)sizeof(t), SEEK_END))
+#endif
+        goto fail;
+ if(fread(&t, sizeof(t), 1, r->fp)!=1 || t.magic!=TTPACK_MAGIC || t.version!=TTPACK_VERSION
+    || t.nblocks<0 || t.nblocks>0x7FFFFFFF)
+        goto fail;
+ r->nblocks = (int)t.nblocks;
+ r->nrecords = t.nrecords;
+ r->dir = (ttpack_direntry*)malloc((r->nblocks+1) * sizeof(ttpack_direntry));
+ r->buf = (unsigned char*)malloc(TTPACK_BOUND(r->hdr.blockrecords) + TTPACK_PADDING);
+ if(r->dir==NULL || r->buf==NULL || seekto(r->fp, t.diroffset)
+    || fread(r->dir, sizeof(ttpack_direntry), r->nblocks, r->fp)!=(size_t)r->nblocks)
+        goto fail;
+ return 0;
+
+fail:
+ ttpack_closereader(r);
+ return -1;
+}
+
+
+void ttpack_closereader(ttpack_reader* r)
+{
+ if(r->fp)
+        fclose(r->fp);
+ free(r->dir);
+ free(r->buf);
+ memset(r, 0, sizeof(ttpack_reader));
+}
+
+
+int ttpack_find(ttpack_reader* r, long long record)
+{
+ int lo = 0, hi = r->nblocks-1, mid;
+
+ if(record<0 || record>=r->nrecords)
+        return -1;
+ while(lo<hi)
+ {
+        mid = (lo + hi + 1) / 2;
+        if(r->dir[mid].record <= record)
+                lo = mid;
+        else
+                hi = mid - 1;
+ }
+ return lo;
+}
+
+
+int ttpack_read(ttpack_reader* r, int b, unsigned int* rec)
+{
+ ttpack_blockheader h;
+
+ if(b<0 || b>=r->nblocks || seekto(r->fp, r->dir[b].offset)
+    || fread(&h, sizeof(h), 1, r->fp)!=1 || h.magic!=TTPACK_MAGIC
+    || h.nrecords>(unsigned int)r->hdr.blockrecords || h.size>(unsigned int)TTPACK_BOUND(r->hdr.blockrecords)
+    || fread(r->buf, 1, h.size, r->fp)!=h.size)
+        return -1;
+ if(ttpack_decode(r->hdr.mode & ~TTPACK_COALESCED, h.method, r->buf, h.size, rec, h.nrecords)<0)
+        return -1;
+ return h.nrecords;
+}
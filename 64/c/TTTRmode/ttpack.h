@@ -0,0 +1,161 @@
+/************************************************************************
+
+  Block-compressed container for raw TTTR records
+
+  The records are grouped into blocks that are compressed independently,
+  so any block can be decompressed on its own. A block directory at the
+  end of the file maps record numbers to blocks for random access.
+
+  Coding, per group of 128 records of a block:
+    - the 4 bit channels, two per byte;
+    - the special records (channel 0xF: overflows and markers) with
+      their other 28 bits as varints, plain overflows take one byte;
+    - the photon time tags (T2) or sync counts (T3) as differences to
+      the previous photon, modulo the wraparound, bit-packed with the
+      smallest width that holds all of the group;
+    - in T3 the dtimes, bit-packed the same way.
+  Time differences between photons need far fewer bits than the tags,
+  and the overflow records shrink to a nibble and a byte. A block that
+  does not fit the scheme (e.g. garbage data) or would not get smaller
+  is stored raw, so coding is always lossless.
+
+  Compression runs on a pool of worker threads; the thread calling
+  ttpack_write only copies the records and writes finished blocks to
+  the file, in order.
+
+  File layout: ttpack_fileheader, the blocks (each a ttpack_blockheader
+  and its data), the directory (ttpack_direntry per block) and a
+  ttpack_trailer. A file that was not closed has no directory, but its
+  blocks can still be read one after another.
+
+************************************************************************/
+
+#ifndef TTPACK_H
+#define TTPACK_H
+
+#include <stdio.h>
+
+#include "ttport.h"
+
+#define TTPACK_MAGIC    0x4B505454   //"TTPK"
+#define TTPACK_VERSION  1
+
+//in the mode of the file header, for coalesced records (see ttdecode.h)
+#define TTPACK_COALESCED 0x100
+
+//block coding methods
+#define TTPACK_RAW      0
+#define TTPACK_DELTA    1
+
+//largest coded size of n records, for buffers
+#define TTPACK_BOUND(n) (((n)+127)/128*1224 + 16)
+//a coded block must be followed by this many readable bytes when it is decoded
+#define TTPACK_PADDING  8
+
+typedef struct
+{
+ unsigned int magic;
+ unsigned int version;
+ int mode;                           //MODE_T2 or MODE_T3, TTPACK_COALESCED added for coalesced records
+ int blockrecords;                   //largest block
+} ttpack_fileheader;
+
+typedef struct
+{
+ unsigned int nrecords;
+ unsigned int size;                  //bytes of coded data that follow
+ unsigned int method;
+ unsigned int magic;                 //TTPACK_MAGIC, to find blocks without the directory
+} ttpack_blockheader;
+
+typedef struct
+{
+ long long record;                   //number of the first record of the block
+ long long offset;                   //file position of the block header
+} ttpack_direntry;
+
+typedef struct
+{
+ long long diroffset;
+ long long nblocks;
+ long long nrecords;
+ unsigned int version;
+ unsigned int magic;
+} ttpack_trailer;
+
+
+//coding of one block, returns the coded size and sets *method
+int ttpack_encode(int mode, const unsigned int* rec, int n, unsigned char* out, int* method);
+//returns 0, or -1 if the data is corrupt
+int ttpack_decode(int mode, int method, const unsigned char* in, int size, unsigned int* rec, int n);
+
+
+//writing
+
+typedef struct
+{
+ unsigned int* rec;
+ int n;
+ unsigned char* out;
+ int size;
+ int method;
+ volatile unsigned int state;        //free, filled, being coded or coded
+} ttpack_job;
+
+typedef struct
+{
+ FILE* fp;
+ int mode;
+ int blockrecords;
+ int njobs;
+ ttpack_job* jobs;
+ long long nextin;                   //sequence numbers of the next job to fill and to write;
+ long long nextout;                  //job seq is jobs[seq % njobs]
+
+ int nworkers;
+ tt_thread* threads;
+ tt_mutex lock;                      //for claiming jobs
+ tt_wakeup work;                     //a job was filled, or stop was set
+ tt_wakeup done;                     //a job was coded
+ volatile unsigned int stop;
+
+ ttpack_direntry* dir;
+ long long ndir, dircap;
+ long long records;                  //written so far
+ long long offset;                   //file position
+ double rawbytes, packedbytes;
+ double waits;                       //times ttpack_write found all jobs busy
+ int error;
+} ttpack_writer;
+
+//mode as in ttpack_fileheader; nworkers 0 means one per CPU; njobs blocks may be
+//queued or in progress
+int  ttpack_create(ttpack_writer* w, const char* path, int mode, int blockrecords, int nworkers, int njobs);
+//adds n records, split into blocks of at most blockrecords; returns 0 or -1 after a write error
+int  ttpack_write(ttpack_writer* w, const unsigned int* rec, int n);
+//codes and writes what is left, writes the directory and closes; returns 0 or -1
+int  ttpack_close(ttpack_writer* w);
+
+
+//reading
+
+typedef struct
+{
+ FILE* fp;
+ ttpack_fileheader hdr;
+ ttpack_direntry* dir;
+ int nblocks;
+ long long nrecords;
+ unsigned char* buf;                 //coded block
+} ttpack_reader;
+
+//returns 0, or -1 if the file is missing, not closed properly or not a container
+int  ttpack_open(ttpack_reader* r, const char* path);
+void ttpack_closereader(ttpack_reader* r);
+
+//the block holding record, -1 if there is none
+int  ttpack_find(ttpack_reader* r, long long record);
+//decodes block b into rec (room for hdr.blockrecords); returns the number of records or -1
+int  ttpack_read(ttpack_reader* r, int b, unsigned int* rec);
+
+#endif
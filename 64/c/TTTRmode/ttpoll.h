@@ -0,0 +1,69 @@
+/************************************************************************
+
+  Adaptive polling for the TTTR read loop
+
+  Calling PH_ReadFiFo, PH_GetFlags and PH_CTCStatus back to back keeps
+  one CPU core busy and floods the USB bus with control transfers that
+  compete with the FiFo bulk transfers. The scheduler here decides how
+  long to wait before the next PH_ReadFiFo and whether a status call is
+  due, based on what the reads return and on the measurement time left.
+
+  - The count rate is estimated from the records per read. The wait
+    before the next read is chosen so that it returns about half of the
+    read size; a read that returns at least that much, or all it asked
+    for, means the FiFo is filling up, so the next read follows at once.
+  - No wait is longer than maxsleep_us, so a sudden rise in the count
+    rate after a quiet period can fill at most that much of the FiFo.
+  - PH_GetFlags is called after every busy read, when an overrun is
+    possible at all, and otherwise once per status period.
+  - PH_CTCStatus is only needed after an empty read. It is called once
+    per status period and after every empty read near the end of Tacq.
+
+  With maxsleep_us and statusperiod_us both 0 the loop polls as fast as
+  before, which is useful for comparison.
+
+************************************************************************/
+
+#ifndef TTPOLL_H
+#define TTPOLL_H
+
+typedef struct
+{
+ //configuration
+ int readmax;                //records requested per PH_ReadFiFo call
+ double tacq_us;
+ double maxsleep_us;
+ double statusperiod_us;
+
+ //state, all times in us
+ double tstart;
+ double tlastread;
+ double tlastflags;
+ double tlastctc;
+ double rate;                //estimated records per us
+ double wait_us;             //planned wait before the next read
+ int busy;                   //last read returned all it asked for or at least half of readmax
+
+ //statistics
+ double reads;
+ double emptyreads;
+ double flagcalls;
+ double ctccalls;
+ double waits;
+ double waittime_us;
+} ttpoll;
+
+void ttpoll_init(ttpoll* p, int readmax, int tacq_ms, double maxsleep_us, double statusperiod_us);
+void ttpoll_start(ttpoll* p);                //right after PH_StartMeas
+
+void ttpoll_wait(ttpoll* p);                 //before each PH_ReadFiFo
+void ttpoll_update(ttpoll* p, int nactual, int count);  //after each PH_ReadFiFo(...,count,&nactual)
+
+//return 1 if the call is due now; the call is then counted
+int  ttpoll_wantflags(ttpoll* p);
+int  ttpoll_wantctc(ttpoll* p);              //only after an empty read
+
+double ttpoll_calls(ttpoll* p);              //library calls that went to the device so far
+double ttpoll_callrate(ttpoll* p);           //the same per second since the start
+
+#endif
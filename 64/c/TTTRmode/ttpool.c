@@ -0,0 +1,166 @@
+/************************************************************************
+
+  Small work-stealing pool for coarse independent tasks
+
+  See ttpool.h.
+
+************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ttpool.h"
+
+
+typedef struct
+{
+ ttpool* p;
+ int worker;
+} workerarg;
+
+
+//next task of worker w, from its own range or stolen; -1 when none is left anywhere
+static int nexttask(ttpool* p, int w)
+{
+ ttpool_queue* q = &p->q[w];
+ int task = -1, i, victim, left, most;
+
+ tt_mutex_lock(&q->lock);
+ if(q->next < q->end)
+        task = q->next++;
+ tt_mutex_unlock(&q->lock);
+ if(task>=0)
+        return task;
+
+ while(1)
+ {
+        //the sizes are read without the locks, the choice is checked below
+        victim = -1;
+        most = 0;
+        for(i=0;i<p->nworkers;i++)
+        {
+                left = p->q[i].end - p->q[i].next;
+                if(i!=w && left>most)
+                {
+                        most = left;
+                        victim = i;
+                }
+        }
+        if(victim<0)
+                return -1;
+        q = &p->q[victim];
+        tt_mutex_lock(&q->lock);
+        if(q->next < q->end)
+                task = --q->end;
+        tt_mutex_unlock(&q->lock);
+        if(task>=0)
+        {
+                p->q[w].stolen++;
+                return task;
+        }
+ }
+}
+
+
+static void work(ttpool* p, int w)
+{
+ int task;
+
+ while((task = nexttask(p, w))>=0)
+ {
+        p->func(p->ctx, task, w);
+        p->q[w].done++;
+ }
+}
+
+
+static TT_THREADFUNC(workerthread)
+{
+ workerarg* a = (workerarg*)arg;
+
+ work(a->p, a->worker);
+ TT_THREADRETURN;
+}
+
+
+int ttpool_init(ttpool* p, int nworkers)
+{
+ int i;
+
+ memset(p, 0, sizeof(ttpool));
+ if(nworkers<=0)
+        nworkers = tt_ncpus();
+ p->q = (ttpool_queue*)calloc(nworkers, sizeof(ttpool_queue));
+ if(p->q==NULL)
+        return -1;
+ p->nworkers = nworkers;
+ for(i=0;i<nworkers;i++)
+        tt_mutex_init(&p->q[i].lock);
+ return 0;
+}
+
+
+void ttpool_free(ttpool* p)
+{
+ int i;
+
+ if(p->q==NULL)
+        return;
+ for(i=0;i<p->nworkers;i++)
+        tt_mutex_destroy(&p->q[i].lock);
+ free(p->q);
+ p->q = NULL;
+}
+
+
+int ttpool_run(ttpool* p, int ntasks, ttpool_func func, void* ctx)
+{
+ tt_thread* threads;
+ workerarg* args;
+ int i, started = 0, ret = 0;
+
+ p->func = func;
+ p->ctx = ctx;
+ for(i=0;i<p->nworkers;i++) //equal contiguous ranges
+ {
+        p->q[i].next = (int)((long long)ntasks * i / p->nworkers);
+        p->q[i].end = (int)((long long)ntasks * (i+1) / p->nworkers);
+        p->q[i].done = 0;
+        p->q[i].stolen = 0;
+ }
+
+ threads = (tt_thread*)malloc(p->nworkers * sizeof(tt_thread));
+ args = (workerarg*)malloc(p->nworkers * sizeof(workerarg));
+ if(threads==NULL || args==NULL)
+        ret = -1; //worker 0 steals all ranges
+ else
+ {
+        for(started=1;started<p->nworkers;started++)
+        {
+                args[started].p = p;
+                args[started].worker = started;
+                if(tt_thread_create(&threads[started], workerthread, &args[started])<0)
+                {
+                        ret = -1; //the others steal the ranges of the missing workers
+                        break;
+                }
+        }
+ }
+
+ work(p, 0);
+ for(i=1;i<started;i++)
+        tt_thread_join(threads[i]);
+ free(threads);
+ free(args);
+ return ret;
+}
+
+
+int ttpool_steals(ttpool* p)
+{
+ int i, n = 0;
+
+ for(i=0;i<p->nworkers;i++)
+        n += p->q[i].stolen;
+ return n;
+}
@@ -0,0 +1,54 @@
+/************************************************************************
+
+  Small work-stealing pool for coarse independent tasks
+
+  Runs a task function for the task numbers 0..ntasks-1 on a number of
+  workers. Every worker starts with its own contiguous range of tasks
+  and takes them from the front, so a worker mostly walks through
+  neighbouring data (e.g. consecutive chunks of a file). A worker whose
+  range is empty steals from the back of the largest range left, so a
+  worker that was slowed down (by I/O, or by another process on its CPU)
+  does not hold up the end of the run.
+
+  The tasks are expected to take milliseconds at least, so each range is
+  simply guarded by a lock. The threads live for one run only.
+
+************************************************************************/
+
+#ifndef TTPOOL_H
+#define TTPOOL_H
+
+#include "ttport.h"
+
+//worker is 0..nworkers-1, for per-worker buffers
+typedef void (*ttpool_func)(void* ctx, int task, int worker);
+
+typedef struct
+{
+ tt_mutex lock;
+ int next, end;                      //tasks next..end-1 are left
+ int done;                           //statistics of the last run
+ int stolen;
+ char pad[TT_CACHELINE];
+} ttpool_queue;
+
+typedef struct
+{
+ int nworkers;
+ ttpool_queue* q;
+ ttpool_func func;
+ void* ctx;
+} ttpool;
+
+//nworkers 0 means one per CPU; returns 0 or -1
+int  ttpool_init(ttpool* p, int nworkers);
+void ttpool_free(ttpool* p);
+
+//runs all tasks, the calling thread is worker 0; returns when they are done,
+//or -1 if the threads cannot be started (the tasks then all ran on the caller)
+int  ttpool_run(ttpool* p, int ntasks, ttpool_func func, void* ctx);
+
+//tasks stolen from other workers in the last run
+int  ttpool_steals(ttpool* p);
+
+#endif
@@ -0,0 +1,128 @@
+/************************************************************************
+
+  Lock-free single-producer/single-consumer ring of TTTR record blocks
+
+  See ttring.h. Head and tail are free-running counters; the slot index
+  is the counter masked by nblocks-1, so nblocks must be a power of two.
+
+************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "ttring.h"
+
+
+int ttring_init(ttring* r, int nblocks, int blocksz)
+{
+ unsigned int n = 1;
+
+ memset(r, 0, sizeof(ttring));
+ if(nblocks<2 || blocksz<1)
+        return -1;
+ while(n<(unsigned)nblocks)
+        n <<= 1;
+
+ r->nblocks = n;
+ r->blocksz = blocksz;
+ r->data = (unsigned int*)malloc((size_t)n*blocksz*sizeof(unsigned int));
+ r->count = (int*)malloc(n*sizeof(int));
+ if(r->data==NULL || r->count==NULL)
+ {
+        ttring_free(r);
+        return -1;
+ }
+ //touch all pages now so that the acquisition does not take page faults
+ memset(r->data, 0, (size_t)n*blocksz*sizeof(unsigned int));
+ return 0;
+}
+
+
+void ttring_free(ttring* r)
+{
+ free(r->data);
+ free(r->count);
+ r->data = NULL;
+ r->count = NULL;
+}
+
+
+unsigned int ttring_fill(ttring* r)
+{
+ return tt_load_acquire(&r->head) - tt_load_acquire(&r->tail);
+}
+
+
+unsigned int* ttring_acquire(ttring* r)
+{
+ unsigned int head = r->head;
+ double t0;
+
+ if(head - tt_load_acquire(&r->tail) == r->nblocks)
+ {
+        r->stalls++;
+        t0 = tt_now_us();
+        while(head - tt_load_acquire(&r->tail) == r->nblocks)
+        {
+                if(tt_load_acquire(&r->error))
+                        return NULL;
+                tt_yield();
+        }
+        r->stalltime_us += tt_now_us() - t0;
+ }
+ if(tt_load_acquire(&r->error))
+        return NULL;
+ return r->data + (size_t)(head & (r->nblocks-1)) * r->blocksz;
+}
+
+
+void ttring_commit(ttring* r, int nrecords)
+{
+ unsigned int head = r->head;
+ unsigned int fill;
+
+ r->count[head & (r->nblocks-1)] = nrecords;
+ tt_store_release(&r->head, head+1);
+
+ fill = head + 1 - tt_load_acquire(&r->tail);
+ if(fill > r->highwater)
+        r->highwater = fill;
+}
+
+
+void ttring_close(ttring* r)
+{
+ tt_store_release(&r->closed, 1);
+}
+
+
+unsigned int* ttring_peek(ttring* r, int* nrecords)
+{
+ unsigned int tail = r->tail;
+ unsigned int slot;
+
+ if(tt_load_acquire(&r->head) == tail)
+        return NULL;
+ slot = tail & (r->nblocks-1);
+ *nrecords = r->count[slot];
+ return r->data + (size_t)slot * r->blocksz;
+}
+
+
+void ttring_release(ttring* r)
+{
+ tt_store_release(&r->tail, r->tail+1);
+}
+
+
+int ttring_finished(ttring* r)
+{
+ //read closed before head so that a block committed just before closing is not missed
+ return tt_load_acquire(&r->closed) && tt_load_acquire(&r->head)==r->tail;
+}
+
+
+void ttring_fail(ttring* r)
+{
+ tt_store_release(&r->error, 1);
+}
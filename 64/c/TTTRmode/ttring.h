@@ -0,0 +1,59 @@
+/************************************************************************
+
+  Lock-free single-producer/single-consumer ring of TTTR record blocks
+
+  The ring holds a fixed number of preallocated blocks, each large enough
+  for one PH_ReadFiFo call. The producer (the thread calling PH_ReadFiFo)
+  acquires a free block, reads into it and commits the number of records
+  received. The consumer (e.g. the file writer) peeks at the oldest filled
+  block and releases it when done. No locks are taken; the only shared
+  state is the head and tail index, each written by one side only.
+
+************************************************************************/
+
+#ifndef TTRING_H
+#define TTRING_H
+
+#include "ttport.h"
+
+typedef struct
+{
+ unsigned int* data;     //nblocks*blocksz records
+ int* count;             //number of valid records per block
+ unsigned int nblocks;   //power of two
+ int blocksz;
+
+ //producer side, own cache line
+ volatile unsigned int head;
+ char pad0[TT_CACHELINE-sizeof(unsigned int)];
+
+ //consumer side, own cache line
+ volatile unsigned int tail;
+ char pad1[TT_CACHELINE-sizeof(unsigned int)];
+
+ volatile unsigned int closed;   //set by the producer when no more blocks follow
+ volatile unsigned int error;    //set by the consumer when it cannot continue
+
+ //statistics, maintained by the producer
+ unsigned int highwater;         //maximum number of filled blocks seen
+ unsigned int stalls;            //number of times the ring was found full
+ double stalltime_us;            //total time the producer waited for a free block
+} ttring;
+
+int  ttring_init(ttring* r, int nblocks, int blocksz);
+void ttring_free(ttring* r);
+
+//producer
+unsigned int* ttring_acquire(ttring* r);  //waits while the ring is full, NULL if the consumer failed
+void ttring_commit(ttring* r, int nrecords);
+void ttring_close(ttring* r);
+
+//consumer
+unsigned int* ttring_peek(ttring* r, int* nrecords); //NULL if no filled block is available
+void ttring_release(ttring* r);
+int  ttring_finished(ttring* r);          //closed and drained
+void ttring_fail(ttring* r);
+
+unsigned int ttring_fill(ttring* r);      //number of filled blocks right now
+
+#endif
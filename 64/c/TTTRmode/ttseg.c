@@ -0,0 +1,281 @@
+/************************************************************************
+
+  Segmented output for long TTTR recordings
+
+  See ttseg.h. The writing thread only counts the segments it has
+  closed; the finalizer takes them from there in order, so it can carry
+  the overflow time and the index state from one segment to the next.
+
+************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "phdefin.h"
+#include "ttdecode.h"
+#include "ttmap.h"
+#include "ttpack.h"
+#include "ttseg.h"
+
+#define CHUNK       1048576          //records the finalizer handles at a time
+#define PACKBLOCK   131072           //records per block of a compressed segment
+#define PACKQUEUE   16
+
+
+static unsigned int CrcTable[256];
+
+
+static void crcinit(void)
+{
+ unsigned int c;
+ int i, k;
+
+ for(i=0;i<256;i++)
+ {
+        c = (unsigned int)i;
+        for(k=0;k<8;k++)
+                c = c&1 ? 0xEDB88320u ^ (c>>1) : c>>1;
+        CrcTable[i] = c;
+ }
+}
+
+
+//CRC-32 as in zlib, start with crc 0
+static unsigned int crc32(unsigned int crc, const unsigned char* p, size_t n)
+{
+ crc = ~crc;
+ while(n--)
+        crc = CrcTable[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+ return ~crc;
+}
+
+
+void ttseg_name(ttseg_writer* w, int segment, const char* ext, char* name)
+{
+ sprintf(name, "%s_%04d%s", w->base, segment, ext);
+}
+
+
+//checksum, index and compression of a closed segment, then the manifest line; returns 0 or -1
+static int finalize(ttseg_writer* w, int segment)
+{
+ char name[TTSEG_NAMEMAX+32], packname[TTSEG_NAMEMAX+32], idxname[TTSEG_NAMEMAX+32], ext[16];
+ ttmap map;
+ ttpack_writer pack;
+ FILE* fp = NULL;
+ unsigned int* buf = NULL;
+ const unsigned int* rec;
+ unsigned int crc = 0;
+ long long pos, nrecords = 0, wraps = 0;
+ int n, mapped, packing = 0, ret = 0;
+
+ ttseg_name(w, segment, w->ext, name);
+ //the overflows must be counted whatever happens, or the later segments
+ //get the wrong ofltime, so without a mapping the file is read with stdio
+ mapped = ttmap_open(&map, name)==0;
+ if(mapped)
+        nrecords = map.nrecords;
+ else if((fp = fopen(name, "rb"))==NULL || (buf = (unsigned int*)malloc(CHUNK*sizeof(unsigned int)))==NULL)
+ {
+        if(fp)
+                fclose(fp);
+        w->indexing = 0; //the index could not go on past this segment
+        ret = -1;
+        goto manifest;
+ }
+ if(w->compress)
+ {
+        ttseg_name(w, segment, ".ttz", packname);
+        if(ttpack_create(&pack, packname, w->mode | (w->coalesced ? TTPACK_COALESCED : 0), PACKBLOCK, w->compressthreads, PACKQUEUE)<0)
+                ret = -1;
+        else
+                packing = 1;
+ }
+ if(w->indexing)
+ {
+        sprintf(ext, "%s.idx", packing ? ".ttz" : w->ext);
+        ttseg_name(w, segment, ext, idxname);
+        if((segment==0 ? ttindex_create(&w->index, idxname, w->mode, w->coalesced, w->indexrecords, w->indextime, w->indexunit)
+                       : ttindex_continue(&w->index, idxname))<0)
+        {
+                w->indexing = 0; //the state is lost, so no index for the later segments either
+                ret = -1;
+        }
+ }
+
+ for(pos=0;;pos+=n)
+ {
+        if(mapped)
+        {
+                n = (int)(nrecords-pos < CHUNK ? nrecords-pos : CHUNK);
+                rec = map.rec + pos;
+        }
+        else
+        {
+                n = (int)fread(buf, 4, CHUNK, fp); //a trailing partial record is left out, as by ttmap
+                rec = buf;
+        }
+        if(n<=0)
+                break;
+        crc = crc32(crc, (const unsigned char*)rec, (size_t)n*4);
+        wraps += w->mode==MODE_T2 ? tt_overflows_t2(rec, n, w->coalesced, NULL) : tt_overflows_t3(rec, n, w->coalesced, NULL);
+        if(w->indexing)
+                ttindex_add(&w->index, rec, n);
+        if(packing && ttpack_write(&pack, rec, n)<0)
+                ret = -1;
+        if(mapped)
+                ttmap_release(&map, pos, n);
+ }
+ if(!mapped)
+ {
+        nrecords = pos;
+        if(ferror(fp))
+                ret = -1;
+        fclose(fp);
+        free(buf);
+ }
+
+ if(w->indexing && ttindex_finish(&w->index)<0)
+        ret = -1;
+ if(packing && ttpack_close(&pack)<0)
+        ret = -1;
+ if(mapped)
+        ttmap_close(&map);
+ //the raw segment goes only once its compressed copy is complete
+ if(packing && ret==0 && remove(name)!=0)
+        ret = -1;
+
+manifest:
+ fprintf(w->manifest, "%d %s %lld %llu %08x%s\n",
+         segment, packing && ret==0 ? packname : name, nrecords, w->ofltime, crc, ret<0 ? " failed" : "");
+ if(fflush(w->manifest))
+        ret = -1;
+ w->ofltime += (unsigned long long)wraps * (w->mode==MODE_T2 ? TT_T2WRAPAROUND : TT_T3WRAPAROUND);
+ return ret;
+}
+
+
+static TT_THREADFUNC(finalizer)
+{
+ ttseg_writer* w = (ttseg_writer*)arg;
+
+ for(;;)
+ {
+        if(w->finalized < tt_load_acquire(&w->closed))
+        {
+                if(finalize(w, (int)w->finalized)<0)
+                        w->finalerrors++;
+                tt_store_release(&w->finalized, w->finalized+1);
+                continue;
+        }
+        //stop is set after the last segment was closed
+        if(tt_load_acquire(&w->stop) && w->finalized==tt_load_acquire(&w->closed))
+                break;
+        tt_sleep_ms(10);
+ }
+ TT_THREADRETURN;
+}
+
+
+int ttseg_create(ttseg_writer* w, const char* base, int mode, int coalesced, long long maxbytes,
+                 double maxseconds, int compress, int compressthreads)
+{
+ char name[TTSEG_NAMEMAX+32];
+
+ memset(w, 0, sizeof(ttseg_writer));
+ if((mode!=MODE_T2 && mode!=MODE_T3) || strlen(base)>=TTSEG_NAMEMAX)
+        return -1;
+ strcpy(w->base, base);
+ w->mode = mode;
+ w->coalesced = coalesced;
+ w->ext = coalesced ? TT_COALESCEDEXT : ".out";
+ w->maxbytes = maxbytes>0 ? maxbytes : 0;
+ w->maxtime_us = maxseconds>0 ? maxseconds*1e6 : 0;
+ w->compress = compress;
+ w->compressthreads = compressthreads;
+ crcinit();
+
+ sprintf(name, "%s_segments.txt", base);
+ if((w->manifest = fopen(name, "w"))==NULL)
+        return -1;
+ fprintf(w->manifest, "#segment file records ofltime crc32 [failed]\n");
+ fflush(w->manifest);
+ if(tt_thread_create(&w->thread, finalizer, w)<0)
+ {
+        fclose(w->manifest);
+        w->manifest = NULL;
+        return -1;
+ }
+ w->running = 1;
+ return 0;
+}
+
+
+void ttseg_index(ttseg_writer* w, long long everyrecords, double everytime, double unit_ps)
+{
+ w->indexing = 1;
+ w->indexrecords = everyrecords;
+ w->indextime = everytime;
+ w->indexunit = unit_ps;
+}
+
+
+//hands the current segment to the finalizer
+static int closesegment(ttseg_writer* w)
+{
+ if(fclose(w->fp))
+        w->error = 1;
+ w->fp = NULL;
+ w->segment++;
+ tt_store_release(&w->closed, (unsigned int)w->segment);
+ return w->error ? -1 : 0;
+}
+
+
+int ttseg_write(ttseg_writer* w, const unsigned int* rec, int n)
+{
+ char name[TTSEG_NAMEMAX+32];
+
+ if(w->error)
+        return -1;
+ if(w->fp==NULL)
+ {
+        ttseg_name(w, w->segment, w->ext, name);
+        if((w->fp = fopen(name, "wb"))==NULL)
+        {
+                w->error = 1;
+                return -1;
+        }
+        w->bytes = 0;
+        w->opened = tt_now_us();
+ }
+ if(fwrite(rec, 4, n, w->fp)!=(size_t)n)
+ {
+        w->error = 1;
+        return -1;
+ }
+ w->bytes += n*4LL;
+ if((w->maxbytes>0 && w->bytes>=w->maxbytes) || (w->maxtime_us>0 && tt_now_us()-w->opened>=w->maxtime_us))
+        return closesegment(w);
+ return 0;
+}
+
+
+int ttseg_close(ttseg_writer* w)
+{
+ if(w->fp)
+        closesegment(w);
+ if(w->running)
+ {
+        tt_store_release(&w->stop, 1);
+        tt_thread_join(w->thread);
+        w->running = 0;
+ }
+ if(w->manifest)
+ {
+        if(fclose(w->manifest))
+                w->error = 1;
+        w->manifest = NULL;
+ }
+ return w->error || w->finalerrors ? -1 : 0;
+}
@@ -0,0 +1,95 @@
+/************************************************************************
+
+  Segmented output for long TTTR recordings
+
+  Instead of one file for the whole measurement the records go to a
+  series of segments, base_0000.out, base_0001.out and so on (.ovc
+  instead of .out for coalesced records, see ttdecode.h). A new
+  segment is started when the current one has reached a size or has
+  been open for a given wall time, always at a block boundary. Joined
+  in order, the segments are exactly the file that would have been
+  written otherwise.
+
+  Each closed segment is finalized on a background thread, so the
+  thread writing the data never waits for it:
+    - the CRC-32 of the file (as computed by zlib and most crc32 tools);
+    - optionally its time index base_NNNN.out.idx (see ttindex.h), which
+      continues the one of the segment before, so its times are those
+      of the whole measurement;
+    - optionally compression to base_NNNN.ttz (see ttpack.h), after
+      which the raw segment is deleted and the index is base_NNNN.ttz.idx.
+  Then a line is added to the manifest base_segments.txt:
+
+        segment file records ofltime crc32 [failed]
+
+  where ofltime is the overflow time before the first record, in the
+  units of tt_t2state / tt_t3state. Seeding a decoder with it gives
+  the times of the whole measurement for a segment on its own, so a
+  segment can be processed as soon as it is listed, while the
+  recording goes on. A segment that could not be finalized completely
+  is still listed, with "failed" at the end; if it could not be read
+  at all its records and crc32 are 0 and the ofltime of the segments
+  after it is too small by its overflows.
+
+************************************************************************/
+
+#ifndef TTSEG_H
+#define TTSEG_H
+
+#include <stdio.h>
+
+#include "ttport.h"
+#include "ttindex.h"
+
+#define TTSEG_NAMEMAX 1024
+
+typedef struct
+{
+ char base[TTSEG_NAMEMAX];
+ int mode;
+ int coalesced;                      //as in tt_t2state
+ const char* ext;                    //of the raw segments, ".out" or TT_COALESCEDEXT
+ long long maxbytes;                 //0 for no limit
+ double maxtime_us;                  //wall time, 0 for no limit
+
+ //writing, on the caller's thread
+ FILE* fp;                           //NULL until the first records of a segment come
+ int segment;                        //number of the segment being written
+ long long bytes;
+ double opened;
+ int error;
+
+ //finalizing, on the background thread
+ tt_thread thread;
+ int running;
+ volatile unsigned int closed;       //segments complete on disk
+ volatile unsigned int finalized;
+ volatile unsigned int stop;
+ int indexing;
+ long long indexrecords;
+ double indextime, indexunit;
+ ttindex_writer index;
+ int compress, compressthreads;
+ FILE* manifest;
+ unsigned long long ofltime;         //before the segment being finalized
+ int finalerrors;
+} ttseg_writer;
+
+//coalesced 1 for coalesced records; maxbytes and maxseconds as above; compress 1
+//packs the closed segments with compressthreads threads (0 for one per CPU);
+//returns 0 or -1
+int  ttseg_create(ttseg_writer* w, const char* base, int mode, int coalesced, long long maxbytes,
+                  double maxseconds, int compress, int compressthreads);
+//makes the finalizer write the time index of each segment, with the parameters of
+//ttindex_create; call before the first ttseg_write
+void ttseg_index(ttseg_writer* w, long long everyrecords, double everytime, double unit_ps);
+//writes n records, then starts a new segment if this one is full; returns 0 or -1
+int  ttseg_write(ttseg_writer* w, const unsigned int* rec, int n);
+//closes the last segment and waits until all are finalized; returns 0, or -1 if
+//any write or finalization failed
+int  ttseg_close(ttseg_writer* w);
+
+//the name of a segment file, ext e.g. ".out"
+void ttseg_name(ttseg_writer* w, int segment, const char* ext, char* name);
+
+#endif
@@ -0,0 +1,239 @@
+/************************************************************************
+
+  Shared-memory live event bus for TTTR data
+
+  See ttshm.h. Region layout: the header, then nslots slots of slotsize
+  bytes, each a ttshm_slot followed by up to slotrecords records.
+
+************************************************************************/
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+
+#include "ttport.h"
+#include "ttshm.h"
+
+
+static ttshm_slot* slotof(ttshm* s, unsigned long long seq)
+{
+ return (ttshm_slot*)(s->slots + (size_t)(seq % s->hdr->nslots) * s->hdr->slotsize);
+}
+
+
+//maps the region; creates it if size is not 0
+static int mapregion(ttshm* s, const char* name, size_t size)
+{
+#ifdef _WIN32
+ char wname[80];
+ DWORD access = size ? FILE_MAP_WRITE : FILE_MAP_READ;
+ MEMORY_BASIC_INFORMATION info;
+
+ _snprintf(wname, sizeof(wname), "Local\\%s", name);
+ wname[sizeof(wname)-1] = 0;
+ if(size)
+        s->mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                        (DWORD)((unsigned long long)size>>32), (DWORD)size, wname);
+ else
+        s->mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, wname);
+ if(s->mapping==NULL)
+        return -1;
+ s->hdr = (ttshm_header*)MapViewOfFile((HANDLE)s->mapping, access, 0, 0, size);
+ if(s->hdr==NULL)
+ {
+        CloseHandle((HANDLE)s->mapping);
+        return -1;
+ }
+ if(!size)
+ {
+        VirtualQuery(s->hdr, &info, sizeof(info));
+        size = info.RegionSize;
+ }
+#else
+ char pname[80];
+ struct stat st;
+ int fd;
+ void* p;
+
+ snprintf(pname, sizeof(pname), "/%s", name);
+ if(size)
+ {
+        shm_unlink(pname); //a stale bus of an earlier run
+        fd = shm_open(pname, O_CREAT|O_EXCL|O_RDWR, 0644);
+        if(fd<0)
+                return -1;
+        if(ftruncate(fd, (off_t)size)<0)
+        {
+                close(fd);
+                shm_unlink(pname);
+                return -1;
+        }
+        p = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+ }
+ else
+ {
+        fd = shm_open(pname, O_RDONLY, 0);
+        if(fd<0)
+                return -1;
+        if(fstat(fd, &st)<0 || st.st_size < (off_t)sizeof(ttshm_header))
+        {
+                close(fd);
+                return -1;
+        }
+        size = (size_t)st.st_size;
+        p = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+ }
+ close(fd);
+ if(p==MAP_FAILED)
+ {
+        if(s->writer)
+                shm_unlink(pname);
+        return -1;
+ }
+ s->hdr = (ttshm_header*)p;
+#endif
+ s->size = size;
+ s->slots = (unsigned char*)s->hdr + sizeof(ttshm_header);
+ strncpy(s->name, name, sizeof(s->name)-1);
+ return 0;
+}
+
+
+int ttshm_create(ttshm* s, const char* name, int nslots, int slotrecords, int mode, double resolution,
+                 int coalesced)
+{
+ unsigned int slotsize;
+ size_t size;
+ int i;
+
+ memset(s, 0, sizeof(ttshm));
+ if(nslots<1 || slotrecords<1)
+        return -1;
+ slotsize = (unsigned int)((sizeof(ttshm_slot) + slotrecords*4 + TT_CACHELINE-1) & ~(TT_CACHELINE-1));
+ size = sizeof(ttshm_header) + (size_t)nslots * slotsize;
+ s->writer = 1;
+ if(mapregion(s, name, size)<0)
+        return -1;
+
+ memset(s->hdr, 0, sizeof(ttshm_header));
+ s->hdr->version = TTSHM_VERSION;
+ s->hdr->nslots = nslots;
+ s->hdr->slotrecords = slotrecords;
+ s->hdr->slotsize = slotsize;
+ s->hdr->mode = mode;
+ s->hdr->resolution = resolution;
+ s->hdr->coalesced = coalesced;
+ for(i=0;i<nslots;i++)
+        slotof(s, i)->seq = TTSHM_NOSEQ;
+ tt_fence();
+ s->hdr->magic = TTSHM_MAGIC; //readers check this last
+ return 0;
+}
+
+
+void ttshm_publish(ttshm* s, const unsigned int* rec, int n)
+{
+ ttshm_slot* slot;
+ unsigned long long seq;
+ int k;
+
+ while(n>0)
+ {
+        k = n < (int)s->hdr->slotrecords ? n : (int)s->hdr->slotrecords;
+        seq = s->hdr->head;
+        slot = slotof(s, seq);
+        //mark the slot as being written before touching the data
+        slot->seq = TTSHM_NOSEQ;
+        tt_fence();
+        memcpy(slot+1, rec, k*4);
+        slot->n = k;
+        tt_store_release64(&slot->seq, seq);
+        tt_store_release64(&s->hdr->head, seq+1);
+        rec += k;
+        n -= k;
+ }
+}
+
+
+int ttshm_open(ttshm* s, const char* name)
+{
+ memset(s, 0, sizeof(ttshm));
+ if(mapregion(s, name, 0)<0)
+        return -1;
+ if(s->hdr->magic!=TTSHM_MAGIC || s->hdr->version!=TTSHM_VERSION
+    || sizeof(ttshm_header) + (size_t)s->hdr->nslots * s->hdr->slotsize > s->size)
+ {
+        ttshm_close(s);
+        return -1;
+ }
+ return 0;
+}
+
+
+int ttshm_get(ttshm* s, unsigned long long seq, const unsigned int** rec, int* n)
+{
+ ttshm_slot* slot;
+ unsigned long long head = tt_load_acquire64(&s->hdr->head);
+
+ if(seq>=head)
+        return tt_load_acquire(&s->hdr->closed) && seq>=tt_load_acquire64(&s->hdr->head) ? TTSHM_ENDED : TTSHM_EMPTY;
+ slot = slotof(s, seq);
+ if(tt_load_acquire64(&slot->seq)!=seq)
+        return TTSHM_LOST;
+ *rec = (const unsigned int*)(slot+1);
+ *n = slot->n;
+ if(!ttshm_valid(s, seq)) //n may belong to a newer block
+        return TTSHM_LOST;
+ return TTSHM_OK;
+}
+
+
+int ttshm_valid(ttshm* s, unsigned long long seq)
+{
+ tt_fence(); //all reads of the data are done before the check
+ return slotof(s, seq)->seq==seq;
+}
+
+
+unsigned long long ttshm_head(ttshm* s)
+{
+ return tt_load_acquire64(&s->hdr->head);
+}
+
+
+unsigned long long ttshm_oldest(ttshm* s)
+{
+ unsigned long long head = tt_load_acquire64(&s->hdr->head);
+
+ //the slot of head-nslots may be being overwritten right now
+ return head>=s->hdr->nslots ? head+1-s->hdr->nslots : 0;
+}
+
+
+void ttshm_close(ttshm* s)
+{
+#ifndef _WIN32
+ char pname[80];
+#endif
+
+ if(s->hdr==NULL)
+        return;
+ if(s->writer)
+        tt_store_release(&s->hdr->closed, 1);
+#ifdef _WIN32
+ UnmapViewOfFile(s->hdr);
+ CloseHandle((HANDLE)s->mapping);
+#else
+ munmap(s->hdr, s->size);
+ if(s->writer) //readers that are attached keep their mapping
+ {
+        snprintf(pname, sizeof(pname), "/%s", s->name);
+        shm_unlink(pname);
+ }
+#endif
+ s->hdr = NULL;
+}
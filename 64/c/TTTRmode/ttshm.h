@@ -0,0 +1,93 @@
+/************************************************************************
+
+  Shared-memory live event bus for TTTR data
+
+  The acquisition publishes its record blocks into a ring of slots in a
+  named shared memory region (POSIX shm_open, or a file mapping on
+  Windows). Any number of local processes can map the region read-only
+  and look at the data while it is being acquired, without copying it
+  and without the acquisition knowing about them.
+
+  Every published block gets a sequence number, which is stored in its
+  slot. The writer never waits: when the ring is full it overwrites the
+  oldest slot. A reader asks for a sequence number and gets a pointer to
+  the records in place; after it has used them it checks with
+  ttshm_valid that the slot was not overwritten in the meantime (as in a
+  seqlock). A reader that falls behind by more than the ring size sees
+  TTSHM_LOST and can resume at the oldest block still available.
+
+  Writer:  ttshm_create, ttshm_publish per block, ttshm_close
+  Reader:  ttshm_open, then ttshm_get / ttshm_valid in a loop, ttshm_close
+
+************************************************************************/
+
+#ifndef TTSHM_H
+#define TTSHM_H
+
+#include <stddef.h>
+
+#define TTSHM_MAGIC     0x48535454   //"TTSH"
+#define TTSHM_VERSION   2
+
+//ttshm_get results
+#define TTSHM_OK         0
+#define TTSHM_EMPTY     -1           //not published yet
+#define TTSHM_LOST      -2           //already overwritten
+#define TTSHM_ENDED     -3           //not published and the writer has closed the bus
+
+typedef struct
+{
+ unsigned int magic;
+ unsigned int version;
+ unsigned int nslots;
+ unsigned int slotrecords;           //maximum records per slot
+ unsigned int slotsize;              //bytes per slot including its header
+ int mode;                           //measurement mode of the records (MODE_T2 / MODE_T3)
+ double resolution;                  //ps, for T3 dtimes
+ volatile unsigned int closed;       //set by the writer at the end
+ int coalesced;                      //1 if the records are coalesced (see ttdecode.h)
+ char pad1[64-40];
+ volatile unsigned long long head;   //sequence number of the next block to be published
+ char pad2[64-8];
+} ttshm_header;
+
+typedef struct
+{
+ volatile unsigned long long seq;    //sequence number of the block in the slot, TTSHM_NOSEQ while written
+ unsigned int n;                     //records
+ unsigned int reserved;
+} ttshm_slot;                        //followed by the records
+
+#define TTSHM_NOSEQ 0xFFFFFFFFFFFFFFFFull
+
+typedef struct
+{
+ ttshm_header* hdr;
+ unsigned char* slots;
+ size_t size;
+ int writer;
+ char name[64];
+ void* mapping;                      //Win32 mapping handle
+} ttshm;
+
+
+//writer side, coalesced as in ttshm_header; returns 0 or -1
+int  ttshm_create(ttshm* s, const char* name, int nslots, int slotrecords, int mode, double resolution,
+                  int coalesced);
+//publishes n records, split into several slots if needed
+void ttshm_publish(ttshm* s, const unsigned int* rec, int n);
+
+//reader side; returns 0 or -1 (no such bus or not compatible)
+int  ttshm_open(ttshm* s, const char* name);
+//gets block seq in place; returns TTSHM_OK and sets *rec and *n, or one of the other codes
+int  ttshm_get(ttshm* s, unsigned long long seq, const unsigned int** rec, int* n);
+//returns 1 if the block seq obtained with ttshm_get is still intact
+int  ttshm_valid(ttshm* s, unsigned long long seq);
+//sequence number of the next block to be published, and of the oldest one still available
+unsigned long long ttshm_head(ttshm* s);
+unsigned long long ttshm_oldest(ttshm* s);
+
+//both sides; the writer marks the bus as ended and removes its name
+void ttshm_close(ttshm* s);
+
+#endif
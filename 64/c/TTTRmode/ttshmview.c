@@ -0,0 +1,115 @@
+/************************************************************************
+
+  PicoHarp 300    Live TTTR Viewer Demo in C
+
+  Attaches to the shared-memory event bus of a running TTTR acquisition
+  (see ttshm.h and Publish in TTTRmode.c) and prints the count rates per
+  channel once per second. The records are evaluated in place in the
+  shared memory; the acquisition is not affected by this program, even
+  if it is too slow or is stopped at any time.
+
+        ttshmview [busname]
+
+  Note: This is a console application
+
+************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "phdefin.h"
+#include "ttport.h"
+#include "ttshm.h"
+
+char DefaultBus[] = "phtttr"; //must match BusName in TTTRmode.c
+
+
+int main(int argc, char* argv[])
+{
+ ttshm bus;
+ const char* name = argc>1 ? argv[1] : DefaultBus;
+ const unsigned int* rec;
+ unsigned long long seq, oldest;
+ double counts[16], records = 0, lost = 0, tlast, now, dt;
+ double blockcounts[16];
+ int n, i, status, chan, dtime;
+
+ printf("\nPicoHarp 300 Live TTTR Viewer Demo");
+ printf("\n~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+
+ if(ttshm_open(&bus,name)<0)
+ {
+        printf("\nno bus named %s, is the acquisition running with Publish=1?\n",name);
+        return -1;
+ }
+ printf("\nattached to %s: %s mode%s, %u slots of %u records\n", name,
+        bus.hdr->mode==MODE_T2 ? "T2" : "T3", bus.hdr->coalesced ? " with coalesced overflows" : "",
+        bus.hdr->nslots, bus.hdr->slotrecords);
+ printf("\n   chan 0/s   chan 1/s   chan 2/s   chan 3/s   chan 4/s   marker/s   lost blocks");
+
+ for(i=0;i<16;i++)
+        counts[i] = 0;
+ seq = ttshm_head(&bus); //start with what comes next
+ tlast = tt_now_us();
+
+ while(1)
+ {
+        status = ttshm_get(&bus,seq,&rec,&n);
+        if(status==TTSHM_ENDED)
+                break;
+        if(status==TTSHM_EMPTY)
+        {
+                tt_sleep_ms(1);
+        }
+        else if(status==TTSHM_LOST) //we fell behind, continue with the oldest block still there
+        {
+                oldest = ttshm_oldest(&bus);
+                lost += (double)(oldest>seq ? oldest-seq : 1);
+                seq = oldest>seq ? oldest : seq+1;
+        }
+        else
+        {
+                for(i=0;i<16;i++)
+                        blockcounts[i] = 0;
+                for(i=0;i<n;i++)
+                {
+                        chan = rec[i] >> 28;
+                        if(chan==0xF)
+                        {
+                                //markers in the low bits of the time tag (T2) or dtime (T3), 0 is an overflow
+                                dtime = bus.hdr->mode==MODE_T2 ? rec[i] & 0xF : (rec[i] >> 16) & 0xF;
+                                if(dtime==0)
+                                        continue;
+                        }
+                        blockcounts[chan]++;
+                }
+                if(ttshm_valid(&bus,seq)) //only count what was not overwritten while we looked at it
+                {
+                        for(i=0;i<16;i++)
+                                counts[i] += blockcounts[i];
+                        records += n;
+                }
+                else
+                        lost++;
+                seq++;
+        }
+
+        now = tt_now_us();
+        if(now-tlast >= 1e6)
+        {
+                dt = (now-tlast)/1e6;
+                //T2 uses channels 0 and 1, T3 the routing channels 1..4
+                printf("\n%11.0lf%11.0lf%11.0lf%11.0lf%11.0lf%11.0lf%14.0lf",
+                        counts[0]/dt, counts[1]/dt, counts[2]/dt, counts[3]/dt, counts[4]/dt,
+                        counts[15]/dt, lost);
+                fflush(stdout);
+                for(i=0;i<16;i++)
+                        counts[i] = 0;
+                tlast = now;
+        }
+ }
+
+ printf("\n\nacquisition ended, %1.0lf records seen, %1.0lf blocks lost\n",records,lost);
+ ttshm_close(&bus);
+ return 0;
+}
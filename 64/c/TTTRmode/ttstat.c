@@ -0,0 +1,240 @@
+/************************************************************************
+
+  Telemetry of the TTTR read and write pipeline
+
+  See ttstat.h. Each counter has one writer, which stores it with
+  release semantics; the reporter loads it with acquire semantics and
+  works with differences to the last report, so it never has to stop
+  anyone.
+
+************************************************************************/
+
+#include <string.h>
+
+#include "ttstat.h"
+
+#define LOAD(x)     tt_load_acquire64(&(x))
+#define BUMP(x, v)  tt_store_release64(&(x), (x) + (v)) //by its one writer only
+
+
+static int sizeclass(int n)
+{
+ int c = 0;
+
+ while(c<TTSTAT_CLASSES-1 && (n>>c)>0)
+        c++;
+ return c;
+}
+
+
+void ttstat_init(ttstat* s)
+{
+ memset((void*)s, 0, sizeof(ttstat));
+ ttlat_init(&s->writes);
+ s->tstart = s->tlast = tt_now_us();
+ s->tdrained = (unsigned long long)s->tstart;
+}
+
+
+void ttstat_read(ttstat* s, int nactual, int count)
+{
+ BUMP(s->reads, 1);
+ BUMP(s->records, (unsigned)nactual);
+ BUMP(s->nactual[sizeclass(nactual)], 1);
+ if(nactual==0)
+        BUMP(s->emptyreads, 1);
+ if(nactual>=count)
+        BUMP(s->fullreads, 1);
+ else
+        tt_store_release64(&s->tdrained, (unsigned long long)tt_now_us());
+}
+
+
+void ttstat_readdone(ttstat* s)
+{
+ tt_store_release(&s->readdone, 1);
+}
+
+
+void ttstat_written(ttstat* s, int n, double us)
+{
+ ttlat_add(&s->writes, us);
+ BUMP(s->written, (unsigned)n);
+}
+
+
+//final: after the reads have ended, when the warnings no longer apply
+static void report(ttstat* s, int final)
+{
+ ttlat period;
+ unsigned long long records, reads, empty, full, written, d, half, sum;
+ unsigned long long nactual[TTSTAT_CLASSES];
+ double now, dt, drained, p50;
+ unsigned int ring = 0;
+ int c, b;
+
+ now = tt_now_us();
+ dt = (now - s->tlast)/1e6;
+ records = LOAD(s->records);
+ reads = LOAD(s->reads);
+ empty = LOAD(s->emptyreads);
+ full = LOAD(s->fullreads);
+ written = LOAD(s->written);
+ drained = (now - (double)LOAD(s->tdrained))/1000.0;
+ if(drained<0)
+        drained = 0;
+ if(s->ring)
+        ring = ttring_fill(s->ring);
+
+ //the median records per read of this period
+ for(c=0;c<TTSTAT_CLASSES;c++)
+        nactual[c] = LOAD(s->nactual[c]);
+ half = (reads - s->lastreads + 1)/2;
+ sum = 0;
+ p50 = 0;
+ for(c=0;c<TTSTAT_CLASSES && half>0;c++)
+ {
+        sum += nactual[c] - s->lastnactual[c];
+        if(sum>=half)
+        {
+                p50 = c ? (double)(1ULL<<(c-1)) : 0;
+                break;
+        }
+ }
+
+ //the disk writes of this period
+ ttlat_init(&period);
+ for(b=0;b<TTLAT_BUCKETS;b++)
+ {
+        d = s->writes.counts[b];
+        period.counts[b] = d - s->lastwrites[b];
+        s->lastwrites[b] = d;
+        if(period.counts[b])
+        {
+                period.n += period.counts[b];
+                period.max_us = ttlat_edge(b);
+        }
+ }
+ if(period.max_us > s->writes.max_us)
+        period.max_us = s->writes.max_us;
+
+ if(tt_load_acquire(&s->readdone))
+        final = 1;
+ if(!final && s->warn_us>0 && drained > s->warn_us/1000.0)
+ {
+        s->warnings++;
+        if(s->console)
+                printf("\nWarning: the FiFo has not been drained for %1.0lf ms, it may overrun\n", drained);
+ }
+ else if(!final && s->ring && ring > s->ring->nblocks*3/4)
+ {
+        s->warnings++;
+        if(s->console)
+                printf("\nWarning: %u of %u ring blocks wait for the disk, the FiFo may overrun\n", ring, s->ring->nblocks);
+ }
+
+ if(s->console)
+ {
+        printf("\r%7.1lf s %12llu records %8.3lf Mcps  ring %3u  write p99 %6.0lf us  drained %5.0lf ms ago ",
+                (now - s->tstart)/1e6, records, dt>0 ? (records - s->lastrecords)/dt/1e6 : 0.0,
+                ring, ttlat_percentile(&period, 99), drained);
+        fflush(stdout);
+ }
+ if(s->fp)
+ {
+        fprintf(s->fp, "%.3lf %llu %.0lf %llu %llu %llu %.0lf %.1lf %u %.1lf %.0lf %.0lf %u\n",
+                (now - s->tstart)/1e6, records, dt>0 ? (records - s->lastrecords)/dt : 0.0,
+                reads - s->lastreads, empty - s->lastempty, full - s->lastfull, p50, drained,
+                ring, records>written ? (records - written)*4/1024.0 : 0.0,
+                ttlat_percentile(&period, 99), period.max_us, s->warnings);
+        fflush(s->fp);
+ }
+
+ s->tlast = now;
+ s->lastrecords = records;
+ s->lastreads = reads;
+ s->lastempty = empty;
+ s->lastfull = full;
+ memcpy(s->lastnactual, nactual, sizeof(nactual));
+}
+
+
+static TT_THREADFUNC(reporter)
+{
+ ttstat* s = (ttstat*)arg;
+ double due = s->tstart + s->period_us;
+
+ while(!tt_load_acquire(&s->stop))
+ {
+        if(tt_now_us() < due)
+        {
+                tt_sleep_ms(10);
+                continue;
+        }
+        report(s,0);
+        due += s->period_us;
+        if(due < s->tlast) //fell behind, e.g. the machine was suspended
+                due = s->tlast + s->period_us;
+ }
+ TT_THREADRETURN;
+}
+
+
+int ttstat_start(ttstat* s, const char* path, int console, double period_ms, double warn_ms, ttring* ring)
+{
+ s->ring = ring;
+ s->console = console;
+ s->period_us = period_ms*1000.0;
+ s->warn_us = warn_ms*1000.0;
+ if(s->period_us<=0 || (!console && path==NULL))
+        return 0;
+ if(path)
+ {
+        if((s->fp = fopen(path, "w"))==NULL)
+                return -1;
+        fprintf(s->fp, "time_s records rate_cps reads empty full nactual_p50 drained_ms ring pending_kB write_p99_us write_max_us warnings\n");
+ }
+ s->tstart = s->tlast = tt_now_us();
+ tt_store_release64(&s->tdrained, (unsigned long long)s->tstart);
+ if(tt_thread_create(&s->thread, reporter, s)<0)
+ {
+        if(s->fp)
+                fclose(s->fp);
+        s->fp = NULL;
+        return -1;
+ }
+ s->running = 1;
+ return 0;
+}
+
+
+void ttstat_stop(ttstat* s)
+{
+ if(s->running)
+ {
+        tt_store_release(&s->stop, 1);
+        tt_thread_join(s->thread);
+        report(s,1);
+        s->running = 0;
+ }
+ if(s->fp)
+        fclose(s->fp);
+ s->fp = NULL;
+}
+
+
+void ttstat_print(ttstat* s)
+{
+ int c;
+
+ printf("\nRecords per read:");
+ for(c=0;c<TTSTAT_CLASSES;c++)
+        if(s->nactual[c])
+        {
+                if(c==0)
+                        printf("\n%8d%10s", 0, "");
+                else
+                        printf("\n%8llu..%-8llu", 1ULL<<(c-1), (1ULL<<c)-1);
+                printf(" %10llu reads", s->nactual[c]);
+        }
+}
@@ -0,0 +1,96 @@
+/************************************************************************
+
+  Telemetry of the TTTR read and write pipeline
+
+  The thread reading the FiFo and the thread writing to disk each update
+  their own counters, without locks and without calling anything that
+  can block. A reporter thread looks at them once per period and
+
+    - prints one status line on the console, overwriting the last one;
+    - appends a line to a stats file, whitespace separated columns as
+      named in its first line:
+
+        time_s        since the start of the measurement
+        records       read from the FiFo so far
+        rate_cps      records per second in this period
+        reads         PH_ReadFiFo calls in this period
+        empty         of these, the ones that returned nothing
+        full          of these, the ones that returned all they asked for
+        nactual_p50   median records per read in this period (the lower
+                      end of its power-of-two class)
+        drained_ms    time since a read last returned less than it asked
+                      for, i.e. since the FiFo was last found drained
+        ring          blocks waiting for the writer
+        pending_kB    read but not yet written
+        write_p99_us  99th percentile of the disk writes in this period
+        write_max_us  longest disk write in this period (bucket edge)
+        warnings      so far
+
+  It warns, at most once per period, before FLAG_FIFOFULL can come:
+  when the reads have not drained the FiFo for longer than warn_ms
+  (the host is reading as fast as it can and the FiFo is not emptying)
+  or when the ring is over three quarters full (the disk is falling
+  behind, and once the ring is full the reads have to wait).
+
+************************************************************************/
+
+#ifndef TTSTAT_H
+#define TTSTAT_H
+
+#include <stdio.h>
+
+#include "ttport.h"
+#include "ttring.h"
+#include "ttlat.h"
+
+#define TTSTAT_CLASSES 20 //nactual classes: 0, 1, 2..3, 4..7, ..., 2^18 and more
+
+typedef struct
+{
+ //read side, updated only by the thread calling PH_ReadFiFo
+ volatile unsigned long long records, reads, emptyreads, fullreads;
+ volatile unsigned long long nactual[TTSTAT_CLASSES];
+ volatile unsigned long long tdrained;  //tt_now_us when the FiFo was last found drained
+ volatile unsigned int readdone;        //set by ttstat_readdone
+
+ //write side, updated only by the thread writing to disk
+ volatile unsigned long long written;   //records
+ ttlat writes;                          //duration of each write
+
+ //reporter
+ ttring* ring;
+ FILE* fp;
+ int console;
+ double period_us, warn_us, tstart;
+ tt_thread thread;
+ int running;
+ volatile unsigned int stop;
+ unsigned int warnings;
+
+ //the last report, for the differences per period
+ unsigned long long lastrecords, lastreads, lastempty, lastfull;
+ unsigned long long lastnactual[TTSTAT_CLASSES];
+ unsigned long long lastwrites[TTLAT_BUCKETS];
+ double tlast;
+} ttstat;
+
+//clears the counters; call before the reads start
+void ttstat_init(ttstat* s);
+//starts the reporter: every period_ms a line on the console if console is 1 and in
+//the file path if not NULL; ring may be NULL; returns 0 or -1
+int  ttstat_start(ttstat* s, const char* path, int console, double period_ms, double warn_ms, ttring* ring);
+//the last report, then stops the reporter and closes the file
+void ttstat_stop(ttstat* s);
+
+//after each PH_ReadFiFo(...,count,&nactual)
+void ttstat_read(ttstat* s, int nactual, int count);
+//after the last PH_ReadFiFo, before waiting for the writer: the FiFo and ring
+//warnings no longer apply while the ring is emptied
+void ttstat_readdone(ttstat* s);
+//after each disk write of n records that took us microsec
+void ttstat_written(ttstat* s, int n, double us);
+
+//prints the nactual distribution since the start, one line per class
+void ttstat_print(ttstat* s);
+
+#endif
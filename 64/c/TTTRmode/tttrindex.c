@@ -0,0 +1,134 @@
+/************************************************************************
+
+  PicoHarp 300    TTTR Time Index Demo in C
+
+  Builds the sparse time index (see ttindex.h) of a raw record file, if
+  it does not exist yet, and uses it to count the events per channel in
+  a time window and to find the records holding them, without decoding
+  the file from the start:
+
+        tttrindex tttrmode.out            builds tttrmode.out.idx
+        tttrindex tttrmode.out 3600 3601  events from 3600 s to 3601 s
+
+  TTTRmode writes the index along with the data, so for its files this
+  only does the query. A file named *.ovc is taken to hold coalesced
+  overflow records (see ttdecode.h).
+
+  Note: The raw file has no header, so Mode must match the measurement
+  when the index is built here.
+
+  Note: This is a console application
+
+************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "phdefin.h"
+#include "ttport.h"
+#include "ttmap.h"
+#include "ttindex.h"
+
+
+int Mode = MODE_T2; //you can change this, MODE_T2 or MODE_T3, as in the measurement
+int IndexRecords = 1048576; //you can change this, largest spacing of the index entries in records
+int IndexPeriod = 100; //you can change this, largest spacing of the index entries in millisec
+double SyncRate = 0; //you can change this, sync rate in Hz after the divider, for T3 times in s
+
+
+int main(int argc, char* argv[])
+{
+ ttmap map;
+ ttindex ix;
+ ttindex_writer w;
+ char idxname[1040];
+ double unit, tstart, t0, t1;
+ unsigned long long counts[TTINDEX_CHANS];
+ long long pos, first, end;
+ int i, n;
+
+ printf("\nPicoHarp 300 TTTR Time Index Demo");
+ printf("\n~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+
+ memset(&map, 0, sizeof(map));
+ memset(&ix, 0, sizeof(ix));
+ if((argc!=2 && argc!=4) || strlen(argv[1])>1024)
+ {
+        printf("\nusage: tttrindex file [from_s to_s]\n");
+        return -1;
+ }
+ sprintf(idxname,"%s.idx",argv[1]);
+
+ if(ttmap_open(&map,argv[1])<0)
+ {
+        printf("\ncannot open input file %s\n",argv[1]);
+        goto ex;
+ }
+
+ if(ttindex_load(&ix,idxname)<0)
+ {
+        printf("\nbuilding %s ...",idxname);
+        tstart = tt_now_us();
+        unit = Mode==MODE_T2 ? 1.0 : (SyncRate>0 ? 1e12/SyncRate : 0.0);
+        if(ttindex_create(&w,idxname,Mode,map.coalesced,IndexRecords,unit>0 ? IndexPeriod*1e9/unit : 0.0,unit)<0)
+        {
+                printf("\ncannot create %s\n",idxname);
+                goto ex;
+        }
+        for(pos=0;pos<map.nrecords;pos+=n)
+        {
+                n = (int)(map.nrecords-pos < 1048576 ? map.nrecords-pos : 1048576);
+                ttindex_add(&w,map.rec+pos,n);
+                ttmap_release(&map,pos,n);
+        }
+        if(ttindex_finish(&w)<0 || ttindex_load(&ix,idxname)<0)
+        {
+                printf("\nindex write error\n");
+                goto ex;
+        }
+        printf(" %.3lf s",(tt_now_us()-tstart)/1e6);
+ }
+
+ unit = ix.hdr.unit_ps;
+ if(unit<=0 && SyncRate>0) //a T3 index built without the sync rate
+        unit = 1e12/SyncRate;
+ printf("\n%s: Mode %d, %lld records, %d index entries",
+        argv[1], ix.hdr.mode, ix.e[ix.n-1].record, ix.n);
+ if(unit>0)
+        printf(", last event at %.6lf s",ix.e[ix.n-1].lasttime*unit*1e-12);
+ else
+        printf(", last event at sync %llu",ix.e[ix.n-1].lasttime);
+ if(ix.e[ix.n-1].record!=map.nrecords)
+        printf("\nWARNING: the index covers %lld of %lld records",ix.e[ix.n-1].record,map.nrecords);
+
+ if(argc==4)
+ {
+        if(unit<=0)
+        {
+                printf("\nthe sync period is unknown, set SyncRate\n");
+                goto ex;
+        }
+        t0 = atof(argv[2]);
+        t1 = atof(argv[3]);
+        tstart = tt_now_us();
+        ttindex_count(&ix,&map,(unsigned long long)(t0*1e12/unit),(unsigned long long)(t1*1e12/unit),
+                      counts,&first,&end);
+        printf("\n\n%.6lf s to %.6lf s: records %lld to %lld, found in %.3lf ms",
+               t0, t1, first, end, (tt_now_us()-tstart)/1e3);
+        for(i=0;i<TTINDEX_CHANS;i++)
+                if(counts[i])
+                {
+                        if(i==TTINDEX_MARKERS)
+                                printf("\n  markers   %12llu",counts[i]);
+                        else
+                                printf("\n  channel %d %12llu",i,counts[i]);
+                }
+ }
+ printf("\n");
+
+ex:
+ ttindex_free(&ix);
+ ttmap_close(&map);
+ return 0;
+}
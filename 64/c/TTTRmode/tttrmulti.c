@@ -0,0 +1,496 @@
+/************************************************************************
+
+  PicoHarp 300    PHLIB.DLL  Multi-Device TTTR Mode Demo in C
+
+  Demo access to several PicoHarp 300 devices via PHLIB.DLL v 3.0.
+  The program performs simultaneous TTTR measurements on all devices
+  found (or on those with the serial numbers listed in UseSerials),
+  based on hardcoded settings. Each device gets its own reader thread,
+  optionally pinned to a CPU, and its own writer thread, and the event
+  data of each device is stored in a binary output file named after its
+  serial number (tttrmode_<serial>.out).
+
+  Note: PHLib v3.0 is not re-entrant, so by default all library calls
+  are serialized through one lock (see SerializeLib). The threads still
+  run concurrently everywhere else, i.e. while waiting, copying and
+  writing. With a library that may be called concurrently for different
+  devices, SerializeLib can be set to 0.
+
+  Note: This is a console application
+
+************************************************************************/
+
+#ifndef _WIN32
+#define _GNU_SOURCE   //for the CPU affinity calls on Linux
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#include <dos.h>
+#include <conio.h>
+#else
+#include <unistd.h>
+#define Sleep(msec) usleep((msec)*1000)
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "phdefin.h"
+#include "phlib.h"
+#include "errorcodes.h"
+#include "ttring.h"
+#include "ttpoll.h"
+
+
+//settings for all devices
+int Mode=MODE_T2; //set T2 or T3 here, observe suitable Syncdivider and Range!
+int Binning=0;   //you can change this (meaningless in T2 mode, important in T3 mode!)
+int Offset=0;  //normally no need to change this
+int Tacq=10000;        //you can change this, unit is millisec
+int SyncDivider = 1;  //you can change this, observe Mode! READ MANUAL!
+int CFDZeroCross0=10; //you can change this
+int CFDLevel0=50; //you can change this
+int CFDZeroCross1=10; //you can change this
+int CFDLevel1=150; //you can change this
+int blocksz = TTREADMAX; // in steps of 512
+int RingBlocks = 64; //you can change this, number of blocksz buffers between FiFo and disk per device
+char UseSerials[] = ""; //you can change this, e.g. "1012345,1012346", empty to use all devices
+int PinThreads = 1; //you can change this, 1 pins the reader of the n-th device to CPU n+1
+int SerializeLib = 1; //see note above
+int MaxSleep = 5000; //you can change this, longest wait between FiFo reads in microsec, 0 to poll without waiting
+int StatusPeriod = 100; //you can change this, interval of the status calls in idle times in millisec
+
+
+typedef struct
+{
+ int devidx;
+ char serial[8];
+ int cpu;
+ ttring ring;
+ FILE* fpout;
+ tt_thread reader;
+ tt_thread writer;
+ int threads;           //number of threads started for this device
+
+ volatile unsigned int initdone;
+ int initerror;         //PHLib error code of the initialization, 0 if ok
+
+ //results, written by the reader thread
+ double records;
+ ttpoll poll;           //read scheduling and call counts
+ double tstart, tstop;  //us
+ int overrun;
+ int error;
+} device;
+
+device Devices[MAXDEVNUM];
+int NDevices = 0;
+volatile unsigned int Go = 0;   //1 starts the measurements, 2 aborts
+tt_mutex LibLock;
+
+
+void liblock(void)
+{
+ if(SerializeLib)
+        tt_mutex_lock(&LibLock);
+}
+
+void libunlock(void)
+{
+ if(SerializeLib)
+        tt_mutex_unlock(&LibLock);
+}
+
+//all PHLib calls made by the threads go through this
+#define PHCALL(call) (liblock(), retcode = (call), libunlock(), retcode)
+
+
+int initdevice(device* d)
+{
+ int retcode;
+ int dev = d->devidx;
+
+ if(PHCALL(PH_Initialize(dev,Mode))<0) return retcode;
+ if(PHCALL(PH_Calibrate(dev))<0) return retcode;
+ if(PHCALL(PH_SetSyncDiv(dev,SyncDivider))<0) return retcode;
+ if(PHCALL(PH_SetInputCFD(dev,0,CFDLevel0,CFDZeroCross0))<0) return retcode;
+ if(PHCALL(PH_SetInputCFD(dev,1,CFDLevel1,CFDZeroCross1))<0) return retcode;
+ if(PHCALL(PH_SetBinning(dev,Binning))<0) return retcode;
+ if(PHCALL(PH_SetOffset(dev,Offset))<0) return retcode;
+ return 0;
+}
+
+
+TT_THREADFUNC(reader)
+{
+ device* d = (device*)arg;
+ int retcode, flags, nactual, ctcdone;
+ int fill = 0;
+ unsigned int* buffer = NULL;
+ double blockstart = 0;
+
+ if(d->cpu>=0)
+        tt_pin_self(d->cpu);
+
+ d->initerror = initdevice(d);
+ tt_store_release(&d->initdone, 1);
+ if(d->initerror<0)
+ {
+        ttring_close(&d->ring);
+        TT_THREADRETURN;
+ }
+
+ while(tt_load_acquire(&Go)==0)
+        tt_sleep_ms(1);
+ if(Go!=1)
+ {
+        ttring_close(&d->ring);
+        TT_THREADRETURN;
+ }
+
+ ttpoll_init(&d->poll,blocksz,Tacq,MaxSleep,StatusPeriod*1000.0);
+ d->tstart = tt_now_us();
+ if(PHCALL(PH_StartMeas(d->devidx,Tacq))<0)
+ {
+        d->error = retcode;
+        ttring_close(&d->ring);
+        TT_THREADRETURN;
+ }
+ ttpoll_start(&d->poll);
+
+ while(1)
+ {
+        if(ttpoll_wantflags(&d->poll))
+        {
+                if(PHCALL(PH_GetFlags(d->devidx,&flags))<0)
+                {
+                        d->error = retcode;
+                        break;
+                }
+                if(flags&FLAG_FIFOFULL)
+                {
+                        d->overrun = 1;
+                        break;
+                }
+        }
+
+        if(fill==0)
+        {
+                buffer = ttring_acquire(&d->ring);
+                if(buffer==NULL) //the writer failed
+                        break;
+                blockstart = tt_now_us();
+        }
+
+        ttpoll_wait(&d->poll); //sleeps outside the library lock
+        if(PHCALL(PH_ReadFiFo(d->devidx,buffer+fill,(blocksz-fill)&~511,&nactual))<0)
+        {
+                d->error = retcode;
+                break;
+        }
+        ttpoll_update(&d->poll,nactual,(blocksz-fill)&~511);
+
+        if(nactual)
+        {
+                fill += nactual;
+                d->records += nactual;
+                if(blocksz-fill < 512)
+                {
+                        ttring_commit(&d->ring,fill);
+                        fill = 0;
+                }
+        }
+        else
+        {
+                if(fill && tt_now_us()-blockstart > 100000.0)
+                {
+                        ttring_commit(&d->ring,fill);
+                        fill = 0;
+                }
+                if(ttpoll_wantctc(&d->poll))
+                {
+                        if(PHCALL(PH_CTCStatus(d->devidx,&ctcdone))<0)
+                        {
+                                d->error = retcode;
+                                break;
+                        }
+                        if(ctcdone)
+                                break;
+                }
+        }
+ }
+
+ d->tstop = tt_now_us();
+ (void)PHCALL(PH_StopMeas(d->devidx));
+ if(fill)
+        ttring_commit(&d->ring,fill);
+ ttring_close(&d->ring);
+ TT_THREADRETURN;
+}
+
+
+TT_THREADFUNC(writer)
+{
+ device* d = (device*)arg;
+ unsigned int* block;
+ int n;
+
+ while(!ttring_finished(&d->ring))
+ {
+        block = ttring_peek(&d->ring,&n);
+        if(block==NULL)
+        {
+                tt_sleep_ms(1);
+                continue;
+        }
+        if(fwrite(block,4,n,d->fpout)!=(unsigned)n)
+        {
+                ttring_fail(&d->ring);
+                break;
+        }
+        ttring_release(&d->ring);
+ }
+ TT_THREADRETURN;
+}
+
+
+//is the serial number in the comma separated list UseSerials? (empty list means yes)
+int wanted(char* serial)
+{
+ char* p = UseSerials;
+ size_t len = strlen(serial);
+
+ if(UseSerials[0]==0)
+        return 1;
+ while(p && *p)
+ {
+        if(strncmp(p,serial,len)==0 && (p[len]==',' || p[len]==0))
+                return 1;
+        p = strchr(p,',');
+        if(p) p++;
+ }
+ return 0;
+}
+
+
+int main(int argc, char* argv[])
+{
+ int i;
+ int retcode;
+ int ncpus;
+ int running;
+ int errors=0;
+ char LIB_Version[8];
+ char HW_Serial[8];
+ char Errorstring[40];
+ char filename[32];
+ double t0 = 0, tlast = 0, now, total, lasttotal, span;
+ device* d;
+
+
+ printf("\nPicoHarp 300 PHLib.DLL   Multi-Device TTTR Mode Demo");
+ printf("\n~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~");
+ PH_GetLibraryVersion(LIB_Version);
+ printf("\nPHLIB.DLL version is %s",LIB_Version);
+ if(strncmp(LIB_Version,LIB_VERSION,sizeof(LIB_VERSION))!=0)
+         printf("\nWarning: The application was built for version %s.",LIB_VERSION);
+
+ tt_mutex_init(&LibLock);
+ ncpus = tt_ncpus();
+
+ printf("\n\n");
+ printf("Mode             : %d\n",Mode);
+ printf("Binning          : %d\n",Binning);
+ printf("Offset           : %d\n",Offset);
+ printf("AcquisitionTime  : %d\n",Tacq);
+ printf("SyncDivider      : %d\n",SyncDivider);
+ printf("CFDZeroCross0    : %d\n",CFDZeroCross0);
+ printf("CFDLevel0        : %d\n",CFDLevel0);
+ printf("CFDZeroCross1    : %d\n",CFDZeroCross1);
+ printf("CFDLevel1        : %d\n",CFDLevel1);
+ printf("Serials          : %s\n",UseSerials[0] ? UseSerials : "all");
+
+
+ printf("\nSearching for PicoHarp devices...");
+ printf("\nDevidx     Status");
+
+ for(i=0;i<MAXDEVNUM;i++)
+ {
+	retcode = PH_OpenDevice(i, HW_Serial);
+	if(retcode==0)
+	{
+		if(wanted(HW_Serial))
+		{
+			printf("\n  %1d        S/N %s", i, HW_Serial);
+			d = &Devices[NDevices];
+			d->devidx = i;
+			strcpy(d->serial,HW_Serial);
+			d->cpu = PinThreads ? (NDevices+1)%ncpus : -1;
+			NDevices++;
+		}
+		else
+		{
+			printf("\n  %1d        S/N %s (not used)", i, HW_Serial);
+			PH_CloseDevice(i);
+		}
+	}
+	else
+	{
+		if(retcode==ERROR_DEVICE_OPEN_FAIL)
+			printf("\n  %1d        no device", i);
+		else
+		{
+			PH_GetErrorString(Errorstring, retcode);
+			printf("\n  %1d        %s", i,Errorstring);
+		}
+	}
+ }
+
+ if(NDevices<1)
+ {
+	printf("\nNo device available.");
+	goto ex;
+ }
+
+ for(i=0;i<NDevices;i++)
+ {
+        d = &Devices[i];
+        sprintf(filename,"tttrmode_%s.out",d->serial);
+        if((d->fpout=fopen(filename,"wb"))==NULL)
+        {
+                printf("\ncannot open output file %s\n",filename);
+                goto ex;
+        }
+        if(ttring_init(&d->ring,RingBlocks,blocksz)<0)
+        {
+                printf("\ncannot allocate ring buffer\n");
+                goto ex;
+        }
+ }
+
+ //the reader threads initialize their devices concurrently, then wait for Go
+ printf("\nInitializing %d device(s)...",NDevices);
+ for(i=0;i<NDevices;i++)
+ {
+        d = &Devices[i];
+        if(tt_thread_create(&d->writer,writer,d)<0)
+        {
+                printf("\ncannot start writer thread\n");
+                goto ex;
+        }
+        d->threads++;
+        if(tt_thread_create(&d->reader,reader,d)<0)
+        {
+                printf("\ncannot start reader thread\n");
+                goto ex;
+        }
+        d->threads++;
+ }
+
+ for(i=0;i<NDevices;i++)
+ {
+        d = &Devices[i];
+        while(!tt_load_acquire(&d->initdone))
+                tt_sleep_ms(1);
+        if(d->initerror<0)
+        {
+                PH_GetErrorString(Errorstring, d->initerror);
+                printf("\nDevice %1d S/N %s initialization error %d (%s)",d->devidx,d->serial,d->initerror,Errorstring);
+                errors++;
+        }
+ }
+ if(errors)
+ {
+        printf("\nAborted.\n");
+        goto ex;
+ }
+
+ printf("\nMeasuring for %1d milliseconds...",Tacq);
+ t0 = tlast = tt_now_us();
+ lasttotal = 0;
+ tt_timer_begin(); //1 ms sleeps in the read loops, see ttport.h
+ tt_store_release(&Go,1);
+
+ //aggregate progress once per second until all readers are done
+ do
+ {
+        tt_sleep_ms(100);
+        running = 0;
+        total = 0;
+        for(i=0;i<NDevices;i++)
+        {
+                total += Devices[i].records;
+                if(!Devices[i].ring.closed)
+                        running++;
+        }
+        now = tt_now_us();
+        if(now-tlast>=1e6 || !running)
+        {
+                printf("\n%6.1lf s  %12.0lf records  %8.3lf Mrec/s",(now-t0)*1e-6,total,(total-lasttotal)/(now-tlast));
+                tlast = now;
+                lasttotal = total;
+        }
+ }
+ while(running);
+
+ex:
+ if(Go==0)
+        tt_store_release(&Go,2);
+ for(i=0;i<NDevices;i++)
+ {
+        d = &Devices[i];
+        if(d->threads>1)
+                tt_thread_join(d->reader);
+        if(d->threads>0)
+        {
+                ttring_close(&d->ring);
+                tt_thread_join(d->writer);
+        }
+ }
+
+ if(Go==1)
+ {
+        tt_timer_end();
+        total = 0;
+        span = 0;
+        printf("\n\nDevice  S/N          Records    Mrec/s  ReadCalls  Calls/s  Overrun  RingHW  Stalls  Stall ms");
+        for(i=0;i<NDevices;i++)
+        {
+                d = &Devices[i];
+                printf("\n  %1d     %-7s %12.0lf %9.3lf %10.0lf %8.0lf  %-7s %3u/%-3u %6u %9.3lf",
+                        d->devidx, d->serial, d->records,
+                        d->tstop>d->tstart ? d->records/(d->tstop-d->tstart) : 0.0,
+                        d->poll.reads,
+                        d->tstop>d->tstart ? ttpoll_calls(&d->poll)/(d->tstop-d->tstart)*1e6 : 0.0,
+                        d->overrun ? "yes" : "no",
+                        d->ring.highwater, d->ring.nblocks, d->ring.stalls, d->ring.stalltime_us/1000.0);
+                if(d->ring.error)
+                        printf("  file write error");
+                else if(d->error)
+                        printf("  PHLib error %d",d->error);
+                total += d->records;
+                if(d->tstop-t0>span)
+                        span = d->tstop-t0;
+        }
+        if(span>0)
+                printf("\nAggregate: %1.0lf records in %1.3lf s = %1.3lf Mrec/s",total,span*1e-6,total/span);
+ }
+
+ for(i=0;i<NDevices;i++)
+ {
+        d = &Devices[i];
+        if(d->fpout) fclose(d->fpout);
+        ttring_free(&d->ring);
+ }
+
+ for(i=0;i<MAXDEVNUM;i++) //no harm to close all
+ {
+	PH_CloseDevice(i);
+ }
+ tt_mutex_destroy(&LibLock);
+
+ printf("\npress RETURN to exit");
+ getchar();
+ return 0;
+}
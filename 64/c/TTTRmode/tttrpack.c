@@ -0,0 +1,160 @@
+/************************************************************************
+
+  PicoHarp 300    TTTR Compression Demo in C
+
+  Converts raw record files (tttrmode.out) to the block-compressed
+  container of ttpack.h and back:
+
+        tttrpack tttrmode.out           writes tttrmode.out.ttz
+        tttrpack -x tttrmode.ttz        writes tttrmode.ttz.out
+
+  Coalesced records (see ttdecode.h) stay marked as such: a file named
+  *.ovc is packed with TTPACK_COALESCED in the mode, and such a container
+  is unpacked to *.ovc.
+
+  Unpacking checks every block and reports the decoding speed on its
+  own, i.e. without the time for writing the output.
+
+  Note: The raw file has no header, so Mode must match the measurement
+  when packing.
+
+  Note: This is a console application
+
+************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "phdefin.h"
+#include "ttport.h"
+#include "ttmap.h"
+#include "ttpack.h"
+
+
+int Mode = MODE_T2; //you can change this, MODE_T2 or MODE_T3, as in the measurement
+int BlockRecords = 131072; //you can change this, records per block
+int Threads = 0; //you can change this, compression threads, 0 for one per CPU
+int QueueBlocks = 32; //you can change this, blocks waiting for or in compression
+
+
+int packfile(const char* in, const char* out)
+{
+ ttmap map;
+ ttpack_writer w;
+ long long pos;
+ double tstart, t;
+ int n, ret = -1;
+
+ if(ttmap_open(&map,in)<0)
+ {
+        printf("\ncannot open input file %s\n",in);
+        return -1;
+ }
+ if(ttpack_create(&w,out,Mode|(map.coalesced ? TTPACK_COALESCED : 0),BlockRecords,Threads,QueueBlocks)<0)
+ {
+        printf("\ncannot open output file %s\n",out);
+        goto ex;
+ }
+ printf("\npacking %s to %s with %d threads ...",in,out,w.nworkers);
+ tstart = tt_now_us();
+ for(pos=0;pos<map.nrecords;pos+=n)
+ {
+        n = (int)(map.nrecords-pos < BlockRecords ? map.nrecords-pos : BlockRecords);
+        if(ttpack_write(&w,map.rec+pos,n)<0)
+                break;
+        ttmap_release(&map,pos,n);
+ }
+ if(ttpack_close(&w)<0)
+ {
+        printf("\nfile write error\n");
+        goto ex;
+ }
+ t = (tt_now_us()-tstart)/1e6;
+ printf("\n%lld records, %.1lf MB to %.1lf MB (%.1lf%%), %.3lf s, %.1lf Mrecords/s\n",
+        w.records, w.rawbytes/1e6, w.packedbytes/1e6, w.rawbytes>0 ? 100.0*w.packedbytes/w.rawbytes : 0.0,
+        t, t>0 ? w.records/t/1e6 : 0.0);
+ ret = 0;
+
+ex:
+ ttmap_close(&map);
+ return ret;
+}
+
+
+int unpackfile(const char* in)
+{
+ char out[1040];
+ ttpack_reader r;
+ FILE* fp = NULL;
+ unsigned int* rec = NULL;
+ double tstart, tdecode = 0, t;
+ int b, n, ret = -1;
+
+ if(ttpack_open(&r,in)<0)
+ {
+        printf("\ncannot open %s, or it is not a complete container\n",in);
+        return -1;
+ }
+ sprintf(out,"%s%s",in,r.hdr.mode & TTPACK_COALESCED ? TT_COALESCEDEXT : ".out");
+ if((fp = fopen(out,"wb"))==NULL)
+ {
+        printf("\ncannot open output file %s\n",out);
+        goto ex;
+ }
+ if((rec = (unsigned int*)malloc(r.hdr.blockrecords*sizeof(unsigned int)))==NULL)
+ {
+        printf("\nmemory allocation failed\n");
+        goto ex;
+ }
+ printf("\nunpacking %s (Mode %d, %d blocks) to %s ...",in,r.hdr.mode & ~TTPACK_COALESCED,r.nblocks,out);
+ tstart = tt_now_us();
+ for(b=0;b<r.nblocks;b++)
+ {
+        t = tt_now_us();
+        n = ttpack_read(&r,b,rec);
+        tdecode += tt_now_us()-t;
+        if(n<0)
+        {
+                printf("\nblock %d is corrupt\n",b);
+                goto ex;
+        }
+        if(fwrite(rec,4,n,fp)!=(size_t)n)
+        {
+                printf("\nfile write error\n");
+                goto ex;
+        }
+ }
+ t = (tt_now_us()-tstart)/1e6;
+ printf("\n%lld records, %.3lf s, reading and decoding alone %.3lf s (%.1lf MB/s of raw records)\n",
+        r.nrecords, t, tdecode/1e6, tdecode>0 ? r.nrecords*4.0/tdecode : 0.0);
+ ret = 0;
+
+ex:
+ if(fp)
+        fclose(fp);
+ free(rec);
+ ttpack_closereader(&r);
+ return ret;
+}
+
+
+int main(int argc, char* argv[])
+{
+ char name[1040];
+
+ printf("\nPicoHarp 300 TTTR Compression Demo");
+ printf("\n~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~\n");
+
+ if(argc==2 && strlen(argv[1])<1024)
+ {
+        sprintf(name,"%s.ttz",argv[1]);
+        return packfile(argv[1],name);
+ }
+ if(argc==3 && strcmp(argv[1],"-x")==0 && strlen(argv[2])<1024)
+ {
+        return unpackfile(argv[2]);
+ }
+ printf("\nusage: tttrpack file  or  tttrpack -x file.ttz\n");
+ return -1;
+}
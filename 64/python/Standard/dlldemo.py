@@ -7,6 +7,7 @@
 import time
 import ctypes as ct
 from ctypes import byref
+import sys
 
 # From phdefin.h
 LIB_VERSION = "3.0"
@@ -40,7 +41,11 @@ countRate0 = ct.c_int()
 countRate1 = ct.c_int()
 flags = ct.c_int()
 
-phlib = ct.CDLL("phlib64.dll")
+if sys.platform == "win32":
+    phlib = ct.CDLL("phlib64.dll")
+else:
+    # e.g. the PHLib stand-in from c/PHLibSim, found via LD_LIBRARY_PATH
+    phlib = ct.CDLL("libphlib.so")
 
 def closeDevices():
     for i in range(0, MAXDEVNUM):
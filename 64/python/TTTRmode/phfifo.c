@@ -0,0 +1,516 @@
+/************************************************************************
+
+  phfifo - native FiFo reader for the PicoHarp 300 Python TTTR demo
+
+  Reading the FiFo through ctypes is fine, but everything done with the
+  records in Python per element (e.g. turning them into a list) limits
+  the sustainable count rate far below what the hardware delivers. This
+  extension reads directly into buffers owned by Python, with the GIL
+  released, so that the records are never touched by the interpreter:
+
+  read(devidx, buf)  one PH_ReadFiFo into buf, which may be any writable
+                     contiguous buffer (numpy array, array.array,
+                     bytearray, ctypes array). Returns nactual or a
+                     negative PHLib error code, like the C function.
+
+  Reader(devidx, buffers, tacq, maxsleep=5000, statusperiod=100)
+                     a background thread that runs the whole acquisition
+                     loop (flags, FiFo reads, CTC status; polled as in
+                     ttpoll.h) and hands the filled buffers to
+                     Python through a queue. The buffers are lent to the
+                     reader: get() returns (buf, nrecords) of the next
+                     filled one, or None once the measurement is over,
+                     and release(buf) gives it back for refilling.
+                     start() is called after PH_StartMeas, stop() before
+                     PH_StopMeas. The attributes records, reads, calls,
+                     overrun, stalls and error describe the run.
+
+  PHLib is not re-entrant, so no other library calls must be made for
+  the device while a Reader is running.
+
+  Build with setup.py (python setup.py build_ext --inplace).
+
+************************************************************************/
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+
+#include "ttport.h"
+#include "ttpoll.h"
+#include "phdefin.h"
+#include "phlib.h"
+
+
+static int fifocount(Py_buffer* view)
+{
+ Py_ssize_t n = view->len / 4;
+
+ if(n > TTREADMAX)
+        n = TTREADMAX;
+ return (int)n & ~511;
+}
+
+
+static PyObject* phfifo_read(PyObject* self, PyObject* args)
+{
+ Py_buffer view;
+ int devidx, count, nactual = 0, retcode;
+
+ if(!PyArg_ParseTuple(args, "iw*", &devidx, &view))
+        return NULL;
+ count = fifocount(&view);
+ if(count<512)
+ {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_ValueError, "buffer must hold at least 512 records");
+        return NULL;
+ }
+ Py_BEGIN_ALLOW_THREADS
+ retcode = PH_ReadFiFo(devidx, (unsigned int*)view.buf, count, &nactual);
+ Py_END_ALLOW_THREADS
+ PyBuffer_Release(&view);
+ return PyLong_FromLong(retcode<0 ? retcode : nactual);
+}
+
+
+/****************************** Reader *********************************/
+
+typedef struct
+{
+ PyObject_HEAD
+ int devidx;
+ int tacq;
+ double maxsleep;
+ double statusperiod;
+
+ int nbuf;
+ PyObject** objs;               //the lent buffers
+ Py_buffer* views;              //held as long as the reader exists
+ int* capacity;                 //records, multiple of 512
+ int* filled;                   //records in each filled buffer
+ int* lent;                     //1 while Python has the buffer from get()
+
+ //buffer queues, guarded by lock
+ tt_mutex lock;
+ int haslock;
+ int* freeq;                    //stack of empty buffers
+ int nfree;
+ int* fullq;                    //ring of filled buffers in read order
+ int fullhead;
+ int nfull;
+
+ tt_thread thread;
+ int started;
+ int joined;
+ volatile unsigned int stop;
+ volatile unsigned int done;
+ ttpoll poll;
+
+ //results
+ double records;
+ double stalls;                 //times the thread had to wait for Python to release a buffer
+ int overrun;
+ int error;                     //PHLib error code, 0 if none
+} Reader;
+
+
+static int popfree(Reader* r)
+{
+ int i = -1;
+
+ tt_mutex_lock(&r->lock);
+ if(r->nfree)
+        i = r->freeq[--r->nfree];
+ tt_mutex_unlock(&r->lock);
+ return i;
+}
+
+static void pushfree(Reader* r, int i)
+{
+ tt_mutex_lock(&r->lock);
+ r->freeq[r->nfree++] = i;
+ tt_mutex_unlock(&r->lock);
+}
+
+static void pushfull(Reader* r, int i, int n)
+{
+ tt_mutex_lock(&r->lock);
+ r->filled[i] = n;
+ r->fullq[(r->fullhead + r->nfull) % r->nbuf] = i;
+ r->nfull++;
+ tt_mutex_unlock(&r->lock);
+}
+
+static int popfull(Reader* r)
+{
+ int i = -1;
+
+ tt_mutex_lock(&r->lock);
+ if(r->nfull)
+ {
+        i = r->fullq[r->fullhead];
+        r->fullhead = (r->fullhead + 1) % r->nbuf;
+        r->nfull--;
+ }
+ tt_mutex_unlock(&r->lock);
+ return i;
+}
+
+
+//the acquisition loop, same logic as the reader of c/TTTRmode/tttrmulti.c
+static TT_THREADFUNC(readerthread)
+{
+ Reader* r = (Reader*)arg;
+ int retcode, flags, nactual, ctcdone, count;
+ int buf = -1, fill = 0;
+ unsigned int* data = NULL;
+ double blockstart = 0;
+
+ ttpoll_start(&r->poll);
+ while(!tt_load_acquire(&r->stop))
+ {
+        if(ttpoll_wantflags(&r->poll))
+        {
+                if((retcode = PH_GetFlags(r->devidx,&flags))<0)
+                {
+                        r->error = retcode;
+                        break;
+                }
+                if(flags&FLAG_FIFOFULL)
+                {
+                        r->overrun = 1;
+                        break;
+                }
+        }
+
+        if(buf<0)
+        {
+                buf = popfree(r);
+                if(buf<0) //Python still holds all buffers
+                {
+                        r->stalls++;
+                        tt_sleep_ms(1);
+                        continue;
+                }
+                data = (unsigned int*)r->views[buf].buf;
+                blockstart = tt_now_us();
+        }
+
+        count = (r->capacity[buf]-fill) & ~511;
+        ttpoll_wait(&r->poll);
+        if((retcode = PH_ReadFiFo(r->devidx,data+fill,count,&nactual))<0)
+        {
+                r->error = retcode;
+                break;
+        }
+        ttpoll_update(&r->poll,nactual,count);
+
+        if(nactual)
+        {
+                fill += nactual;
+                r->records += nactual;
+                if(r->capacity[buf]-fill < 512)
+                {
+                        pushfull(r,buf,fill);
+                        buf = -1;
+                        fill = 0;
+                }
+        }
+        else
+        {
+                if(fill && tt_now_us()-blockstart > 100000.0)
+                {
+                        pushfull(r,buf,fill);
+                        buf = -1;
+                        fill = 0;
+                }
+                if(ttpoll_wantctc(&r->poll))
+                {
+                        if((retcode = PH_CTCStatus(r->devidx,&ctcdone))<0)
+                        {
+                                r->error = retcode;
+                                break;
+                        }
+                        if(ctcdone)
+                                break;
+                }
+        }
+ }
+
+ if(buf>=0)
+ {
+        if(fill)
+                pushfull(r,buf,fill);
+        else
+                pushfree(r,buf);
+ }
+ tt_store_release(&r->done, 1);
+ TT_THREADRETURN;
+}
+
+
+static void reader_join(Reader* r)
+{
+ if(r->started && !r->joined)
+ {
+        tt_store_release(&r->stop, 1);
+        Py_BEGIN_ALLOW_THREADS
+        tt_thread_join(r->thread);
+        Py_END_ALLOW_THREADS
+        r->joined = 1;
+ }
+}
+
+
+static void reader_dealloc(Reader* r)
+{
+ int i;
+
+ reader_join(r);
+ for(i=0;i<r->nbuf;i++)
+ {
+        PyBuffer_Release(&r->views[i]);
+        Py_DECREF(r->objs[i]);
+ }
+ if(r->haslock)
+        tt_mutex_destroy(&r->lock);
+ PyMem_Free(r->objs);
+ PyMem_Free(r->views);
+ PyMem_Free(r->capacity);
+ PyMem_Free(r->filled);
+ PyMem_Free(r->lent);
+ PyMem_Free(r->freeq);
+ PyMem_Free(r->fullq);
+ Py_TYPE(r)->tp_free((PyObject*)r);
+}
+
+
+static int reader_init(Reader* r, PyObject* args, PyObject* kwds)
+{
+ static char* kwlist[] = {"devidx", "buffers", "tacq", "maxsleep", "statusperiod", NULL};
+ PyObject* buffers;
+ PyObject* seq;
+ int n, i;
+
+ if(r->objs) //__init__ called twice
+ {
+        PyErr_SetString(PyExc_RuntimeError, "Reader is already initialized");
+        return -1;
+ }
+ r->maxsleep = 5000;
+ r->statusperiod = 100;
+ if(!PyArg_ParseTupleAndKeywords(args, kwds, "iOi|dd", kwlist, &r->devidx, &buffers,
+                                 &r->tacq, &r->maxsleep, &r->statusperiod))
+        return -1;
+
+ seq = PySequence_Fast(buffers, "buffers must be a sequence");
+ if(seq==NULL)
+        return -1;
+ n = (int)PySequence_Fast_GET_SIZE(seq);
+ if(n<1)
+ {
+        Py_DECREF(seq);
+        PyErr_SetString(PyExc_ValueError, "at least one buffer is needed");
+        return -1;
+ }
+
+ r->objs = PyMem_Calloc(n, sizeof(PyObject*));
+ r->views = PyMem_Calloc(n, sizeof(Py_buffer));
+ r->capacity = PyMem_Calloc(n, sizeof(int));
+ r->filled = PyMem_Calloc(n, sizeof(int));
+ r->lent = PyMem_Calloc(n, sizeof(int));
+ r->freeq = PyMem_Calloc(n, sizeof(int));
+ r->fullq = PyMem_Calloc(n, sizeof(int));
+ if(!r->objs || !r->views || !r->capacity || !r->filled || !r->lent || !r->freeq || !r->fullq)
+ {
+        Py_DECREF(seq);
+        PyErr_NoMemory();
+        return -1;
+ }
+ tt_mutex_init(&r->lock);
+ r->haslock = 1;
+
+ for(i=0;i<n;i++)
+ {
+        r->objs[i] = PySequence_Fast_GET_ITEM(seq, i);
+        if(PyObject_GetBuffer(r->objs[i], &r->views[i], PyBUF_WRITABLE|PyBUF_C_CONTIGUOUS)<0)
+                break;
+        Py_INCREF(r->objs[i]);
+        r->nbuf++;
+        r->capacity[i] = fifocount(&r->views[i]);
+        if(r->capacity[i]<512)
+        {
+                PyErr_SetString(PyExc_ValueError, "each buffer must hold at least 512 records");
+                break;
+        }
+        r->freeq[r->nfree++] = i;
+ }
+ Py_DECREF(seq);
+ if(r->nbuf<n || PyErr_Occurred())
+        return -1;
+
+ ttpoll_init(&r->poll, r->capacity[0], r->tacq, r->maxsleep, r->statusperiod*1000.0);
+ return 0;
+}
+
+
+static PyObject* reader_start(Reader* r, PyObject* unused)
+{
+ if(r->objs==NULL || r->started)
+ {
+        PyErr_SetString(PyExc_RuntimeError, "Reader can be started only once");
+        return NULL;
+ }
+ if(tt_thread_create(&r->thread, readerthread, r)<0)
+ {
+        PyErr_SetString(PyExc_RuntimeError, "cannot start the reader thread");
+        return NULL;
+ }
+ r->started = 1;
+ Py_RETURN_NONE;
+}
+
+
+static PyObject* reader_stop(Reader* r, PyObject* unused)
+{
+ reader_join(r);
+ Py_RETURN_NONE;
+}
+
+
+static PyObject* reader_get(Reader* r, PyObject* unused)
+{
+ int i = -1, done = 0, loops = 0;
+
+ if(!r->started)
+ {
+        PyErr_SetString(PyExc_RuntimeError, "Reader is not started");
+        return NULL;
+ }
+ while(1)
+ {
+        Py_BEGIN_ALLOW_THREADS
+        while((i = popfull(r))<0 && !(done = tt_load_acquire(&r->done)) && ++loops%100)
+                tt_sleep_ms(1);
+        Py_END_ALLOW_THREADS
+        if(i<0 && done) //the thread may have queued its last buffer right before it ended
+        {
+                i = popfull(r);
+                if(i<0)
+                        Py_RETURN_NONE;
+        }
+        if(i>=0)
+        {
+                r->lent[i] = 1;
+                return Py_BuildValue("(Oi)", r->objs[i], r->filled[i]);
+        }
+        if(PyErr_CheckSignals()<0) //e.g. Ctrl-C, every 100 ms
+                return NULL;
+ }
+}
+
+
+static PyObject* reader_release(Reader* r, PyObject* buf)
+{
+ int i;
+
+ for(i=0;i<r->nbuf;i++)
+        if(r->objs[i]==buf && r->lent[i])
+        {
+                r->lent[i] = 0;
+                pushfree(r,i);
+                Py_RETURN_NONE;
+        }
+ PyErr_SetString(PyExc_ValueError, "not a buffer of this Reader returned by get()");
+ return NULL;
+}
+
+
+static PyObject* reader_getreads(Reader* r, void* closure)
+{
+ return PyFloat_FromDouble(r->poll.reads);
+}
+
+static PyObject* reader_getcalls(Reader* r, void* closure)
+{
+ return PyFloat_FromDouble(ttpoll_calls(&r->poll));
+}
+
+
+static PyMethodDef reader_methods[] =
+{
+ {"start", (PyCFunction)reader_start, METH_NOARGS, "start the reader thread, after PH_StartMeas"},
+ {"stop", (PyCFunction)reader_stop, METH_NOARGS, "stop the reader thread and wait for it, before PH_StopMeas"},
+ {"get", (PyCFunction)reader_get, METH_NOARGS, "next filled buffer as (buf, nrecords), None at the end"},
+ {"release", (PyCFunction)reader_release, METH_O, "give a buffer back for refilling"},
+ {NULL}
+};
+
+static PyMemberDef reader_members[] =
+{
+ {"records", T_DOUBLE, offsetof(Reader, records), READONLY, "records read"},
+ {"stalls", T_DOUBLE, offsetof(Reader, stalls), READONLY, "waits for a free buffer"},
+ {"overrun", T_INT, offsetof(Reader, overrun), READONLY, "1 if the FiFo ran full"},
+ {"error", T_INT, offsetof(Reader, error), READONLY, "PHLib error code, 0 if none"},
+ {NULL}
+};
+
+static PyGetSetDef reader_getset[] =
+{
+ {"reads", (getter)reader_getreads, NULL, "PH_ReadFiFo calls", NULL},
+ {"calls", (getter)reader_getcalls, NULL, "all library calls to the device", NULL},
+ {NULL}
+};
+
+static PyTypeObject ReaderType =
+{
+ PyVarObject_HEAD_INIT(NULL, 0)
+ "phfifo.Reader",
+};
+
+
+static PyMethodDef phfifo_methods[] =
+{
+ {"read", phfifo_read, METH_VARARGS, "read(devidx, buf) -> nactual or negative error code"},
+ {NULL}
+};
+
+static struct PyModuleDef phfifo_module =
+{
+ PyModuleDef_HEAD_INIT,
+ "phfifo",
+ "Native FiFo reader for the PicoHarp 300 TTTR demo",
+ -1,
+ phfifo_methods
+};
+
+
+PyMODINIT_FUNC PyInit_phfifo(void)
+{
+ PyObject* m;
+
+ ReaderType.tp_basicsize = sizeof(Reader);
+ ReaderType.tp_flags = Py_TPFLAGS_DEFAULT;
+ ReaderType.tp_doc = "background FiFo reader filling lent buffers";
+ ReaderType.tp_new = PyType_GenericNew;
+ ReaderType.tp_init = (initproc)reader_init;
+ ReaderType.tp_dealloc = (destructor)reader_dealloc;
+ ReaderType.tp_methods = reader_methods;
+ ReaderType.tp_members = reader_members;
+ ReaderType.tp_getset = reader_getset;
+ if(PyType_Ready(&ReaderType)<0)
+        return NULL;
+
+ m = PyModule_Create(&phfifo_module);
+ if(m==NULL)
+        return NULL;
+ Py_INCREF(&ReaderType);
+ if(PyModule_AddObject(m, "Reader", (PyObject*)&ReaderType)<0)
+ {
+        Py_DECREF(&ReaderType);
+        Py_DECREF(m);
+        return NULL;
+ }
+ return m;
+}
@@ -0,0 +1,28 @@
+# Builds the phfifo extension used by tttrmode.py:
+#
+#   python setup.py build_ext --inplace
+#
+# ttpoll.c/h, ttport.h and the PHLib headers are copies of those in
+# c/TTTRmode. On Windows it links against phlib64.lib of the C demo,
+# elsewhere against libphlib.so of the PHLib stand-in in c/PHLibSim
+# (build that first).
+
+import sys
+from setuptools import setup, Extension
+
+if sys.platform == "win32":
+    libs = ["phlib64"]
+    libdirs = ["../../c/TTTRmode"]
+else:
+    libs = ["phlib"]
+    libdirs = ["../../c/PHLibSim"]
+
+phfifo = Extension("phfifo",
+                   sources=["phfifo.c", "ttpoll.c"],
+                   libraries=libs,
+                   library_dirs=libdirs)
+
+setup(name="phfifo",
+      version="1.0",
+      description="Native FiFo reader for the PicoHarp 300 TTTR demo",
+      ext_modules=[phfifo])
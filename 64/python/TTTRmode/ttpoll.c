@@ -0,0 +1,127 @@
+/************************************************************************
+
+  Adaptive polling for the TTTR read loop
+
+  See ttpoll.h.
+
+************************************************************************/
+
+#include <string.h>
+
+#include "ttport.h"
+#include "ttpoll.h"
+
+#define MINWAIT_US  50.0    //shorter waits are not worth a sleep
+#define RATEWEIGHT  0.3     //weight of the newest read in the rate estimate
+
+
+void ttpoll_init(ttpoll* p, int readmax, int tacq_ms, double maxsleep_us, double statusperiod_us)
+{
+ memset(p, 0, sizeof(ttpoll));
+ p->readmax = readmax;
+ p->tacq_us = tacq_ms * 1000.0;
+ p->maxsleep_us = maxsleep_us;
+ p->statusperiod_us = statusperiod_us;
+}
+
+
+void ttpoll_start(ttpoll* p)
+{
+ p->tstart = tt_now_us();
+ p->tlastread = p->tstart;
+ p->tlastflags = p->tstart;
+ p->tlastctc = p->tstart;
+ p->rate = 0;
+ p->wait_us = 0;
+ p->busy = 0;
+}
+
+
+void ttpoll_wait(ttpoll* p)
+{
+ double t;
+
+ if(p->wait_us < MINWAIT_US)
+        return;
+ t = tt_now_us();
+ tt_sleep_us((int)p->wait_us);
+ p->waits++;
+ p->waittime_us += tt_now_us() - t;
+}
+
+
+void ttpoll_update(ttpoll* p, int nactual, int count)
+{
+ double now = tt_now_us();
+ double dt = now - p->tlastread;
+ double remaining, wait;
+
+ p->tlastread = now;
+ p->reads++;
+ if(nactual==0)
+        p->emptyreads++;
+
+ if(dt>0)
+ {
+        if(p->reads==1)
+                p->rate = nactual / dt;
+        else
+                p->rate += RATEWEIGHT * (nactual / dt - p->rate);
+ }
+
+ p->busy = nactual >= count || nactual >= p->readmax/2;
+ if(p->busy)
+        wait = 0;
+ else if(p->rate > 0)
+        wait = (p->readmax/2) / p->rate;
+ else
+        wait = p->maxsleep_us;
+ if(wait > p->maxsleep_us)
+        wait = p->maxsleep_us;
+
+ //do not sleep past the end of the measurement, the empty read there ends the loop
+ remaining = p->tacq_us - (now - p->tstart);
+ if(remaining < wait)
+        wait = remaining > 0 ? remaining : 0;
+
+ p->wait_us = wait;
+}
+
+
+int ttpoll_wantflags(ttpoll* p)
+{
+ double now = tt_now_us();
+
+ if(!p->busy && now - p->tlastflags < p->statusperiod_us)
+        return 0;
+ p->tlastflags = now;
+ p->flagcalls++;
+ return 1;
+}
+
+
+int ttpoll_wantctc(ttpoll* p)
+{
+ double now = tt_now_us();
+
+ if(now - p->tstart < p->tacq_us - p->statusperiod_us
+    && now - p->tlastctc < p->statusperiod_us)
+        return 0;
+ p->tlastctc = now;
+ p->ctccalls++;
+ return 1;
+}
+
+
+double ttpoll_calls(ttpoll* p)
+{
+ return p->reads + p->flagcalls + p->ctccalls;
+}
+
+
+double ttpoll_callrate(ttpoll* p)
+{
+ double t = (tt_now_us() - p->tstart) / 1e6;
+
+ return t>0 ? ttpoll_calls(p) / t : 0;
+}
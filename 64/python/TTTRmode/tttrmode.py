@@ -9,6 +9,7 @@ import ctypes
 from ctypes import byref, POINTER
 import sys
 import struct
+import array
 
 # From phdefin.h
 LIB_VERSION = "3.0"
@@ -29,6 +30,8 @@ CFDZeroCross0 = 10 # you can change this (in mV)
 CFDLevel0 = 50 # you can change this (in mV)
 CFDZeroCross1 = 10 # you can change this (in mV)
 CFDLevel1 = 150 # you can change this (in mV)
+useNative = True # you can change this, reads via the phfifo extension if it is built (see setup.py)
+ringBlocks = 64 # you can change this, buffers of TTREADMAX records lent to the native reader
 
 # Variables to store information read from DLLs
 buffer = (ctypes.c_uint * TTREADMAX)()
@@ -48,7 +51,18 @@ ctcDone = ctypes.c_int()
 warnings = ctypes.c_int()
 warningstext = ctypes.create_string_buffer(b"", 16384)
 
-phlib = ctypes.CDLL("phlib64.dll")
+if sys.platform == "win32":
+    phlib = ctypes.CDLL("phlib64.dll")
+else:
+    # e.g. the PHLib stand-in from c/PHLibSim, found via LD_LIBRARY_PATH
+    phlib = ctypes.CDLL("libphlib.so")
+
+phfifo = None
+if useNative:
+    try:
+        import phfifo
+    except ImportError:
+        print("phfifo extension not built, reading through ctypes")
 
 def closeDevices():
     for i in range(0, MAXDEVNUM):
@@ -61,7 +75,7 @@ def stoptttr():
 
 def tryfunc(retcode, funcName, measRunning=False):
     if retcode < 0:
-        phlib.PH_GetErrorString(errorString, ct.c_int(retcode))
+        phlib.PH_GetErrorString(errorString, ctypes.c_int(retcode))
         print("PH_%s error %d (%s). Aborted." % (funcName, retcode,\
               errorString.value.decode("utf-8")))
         if measRunning:
@@ -158,6 +172,40 @@ progress = 0
 sys.stdout.write("\nProgress:%9u" % progress)
 sys.stdout.flush()
 
+if phfifo is not None:
+    # The native reader runs the acquisition loop on its own thread, with the
+    # GIL released, and hands over filled buffers. The records are written
+    # straight from these buffers and never converted to Python objects.
+    # numpy.empty(TTREADMAX, dtype=numpy.uint32) would work as a buffer too.
+    buffers = [array.array("I", bytes(4 * TTREADMAX)) for i in range(ringBlocks)]
+    reader = phfifo.Reader(dev[0], buffers, tacq)
+
+    tryfunc(phlib.PH_StartMeas(ctypes.c_int(dev[0]), ctypes.c_int(tacq)), "StartMeas")
+    reader.start()
+
+    while True:
+        block = reader.get()
+        if block is None:
+            break
+        buf, n = block
+        outputfile.write(memoryview(buf)[:n])
+        reader.release(buf)
+        progress += n
+        sys.stdout.write("\rProgress:%9u" % progress)
+        sys.stdout.flush()
+
+    reader.stop()
+    if reader.overrun:
+        print("\nFiFo Overrun!")
+    elif reader.error < 0:
+        tryfunc(reader.error, "ReadFiFo", measRunning=True)
+    else:
+        print("\nDone")
+    print("%d FiFo reads, %d library calls, waited %d times for a free buffer" %\
+          (reader.reads, reader.calls, reader.stalls))
+    outputfile.close()
+    stoptttr()
+
 tryfunc(phlib.PH_StartMeas(ctypes.c_int(dev[0]), ctypes.c_int(tacq)), "StartMeas")
 
 while True:
@@ -175,11 +223,10 @@ while True:
 
     if nactual.value > 0:
         # We could just iterate through our buffer with a for loop, however,
-        # this is slow and might cause a FIFO overrun. So instead, we shrinken
-        # the buffer to its appropriate length with array slicing, which gives
-        # us a python list. This list then needs to be converted back into
-        # a ctype array which can be written at once to the output file
-        outputfile.write((ctypes.c_uint*nactual.value)(*buffer[0:nactual.value]))
+        # this is slow and might cause a FIFO overrun. Slicing a memoryview
+        # of the ctypes array instead writes the records without copying
+        # them or turning them into Python ints
+        outputfile.write(memoryview(buffer)[:nactual.value])
         progress += nactual.value
         sys.stdout.write("\rProgress:%9u" % progress)
         sys.stdout.flush()